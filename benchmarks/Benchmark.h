@@ -0,0 +1,152 @@
+#pragma once
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 計算結果を使ったことにして最適化で計算が省かれないようにする
+ *
+ * @param value 計算結果
+ */
+template<typename T>
+inline void keep(const T& value)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile char sink[sizeof(T)];
+    std::memcpy(const_cast<char*>(sink), &value, sizeof(T));
+#endif
+}
+
+/**
+ * @brief 定数として畳み込まれないように値を隠す
+ *
+ * @param value 値
+ * @return T 同じ値
+ */
+template<typename T>
+inline T opaque(T value)
+{
+    volatile T v(value);
+    return v;
+}
+
+/**
+ * マイクロベンチマークを実行して結果を JSON で出力するクラス
+ */
+class Benchmark
+{
+    /**
+     * 計測結果
+     */
+    struct Result
+    {
+        /** 名前 */
+        std::string name;
+        /** 一回の計測で繰り返した回数 */
+        long long iterations;
+        /** 一回あたりの時間 (ナノ秒) の最小値 */
+        double ns;
+        /** 一回あたりの時間 (ナノ秒) の平均値 */
+        double mean;
+    };
+
+    /** 名前に含まれていなければ実行しない文字列 */
+    const std::string filter;
+
+    /** 一回の計測にかける最短の時間 (秒) */
+    const double minTime;
+
+    /** 計測を繰り返す回数 */
+    const int repetitions;
+
+    /** 計測結果 */
+    std::vector<Result> results;
+
+public:
+    /**
+     * @brief Construct a new Benchmark object
+     *
+     * @param filter 名前に含まれていなければ実行しない文字列 (空ならすべて実行する)
+     * @param minTime 一回の計測にかける最短の時間 (秒)
+     * @param repetitions 計測を繰り返す回数
+     */
+    Benchmark(std::string filter = "", double minTime = 0.1, int repetitions = 5) :
+        filter(filter), minTime(minTime), repetitions(repetitions)
+    {
+    }
+
+    /**
+     * @brief 関数を繰り返し実行して一回あたりの時間を求める
+     *
+     * @param name 名前
+     * @param f 計測する関数 (何回目の呼び出しかを引数に受け取る)
+     */
+    template<typename F>
+    void run(const std::string& name, F&& f)
+    {
+        if (!filter.empty() && name.find(filter) == std::string::npos)
+            return;
+
+        // 最短の時間を超えるまで繰り返す回数を増やす
+        long long iterations(1);
+        while (measure(f, iterations) < minTime && iterations < (1LL << 40))
+        {
+            iterations *= 2;
+        }
+
+        // 何度か計測して最小値と平均値を求める
+        double best(0.0), total(0.0);
+        for (int r = 0; r < repetitions; ++r)
+        {
+            const double ns(measure(f, iterations) * 1.0e9 / static_cast<double>(iterations));
+            best = r == 0 || ns < best ? ns : best;
+            total += ns;
+        }
+
+        results.push_back({name, iterations, best, total / repetitions});
+        std::cerr << name << ": " << best << " ns" << std::endl;
+    }
+
+    /**
+     * @brief 名前を明示して選ばれたか (既定では実行しない重い計測に使う)
+     *
+     * @param name 名前
+     * @return true filter が空でなく名前に含まれている
+     */
+    bool isSelected(const std::string& name) const
+    {
+        return !filter.empty() && name.find(filter) != std::string::npos;
+    }
+
+    /** 計測結果を JSON で出力する */
+    void print(std::ostream& os) const
+    {
+        os << "{\n  \"benchmarks\": [";
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r(results[i]);
+            os << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << r.name
+               << "\", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.ns
+               << ", \"mean_ns_per_op\": " << r.mean << "}";
+        }
+        os << "\n  ]\n}" << std::endl;
+    }
+
+private:
+    /** 関数を指定した回数実行した時間 (秒) を求める */
+    template<typename F>
+    static double measure(F& f, long long iterations)
+    {
+        const auto start(std::chrono::steady_clock::now());
+        for (long long i = 0; i < iterations; ++i)
+        {
+            f(i);
+        }
+        const auto end(std::chrono::steady_clock::now());
+        return std::chrono::duration<double>(end - start).count();
+    }
+};
@@ -0,0 +1,972 @@
+#include <GL/glew.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Benchmark.h"
+#include "Box.h"
+#include "FrameArena.h"
+#include "LevelOfDetail.h"
+#include "MaterialTable.h"
+#include "Matrix.h"
+#include "MatrixExpression.h"
+#include "Object.h"
+#include "OcclusionCuller.h"
+#include "Shader.h"
+#include "Simplifier.h"
+#include "SoftwareRenderer.h"
+#include "Sphere.h"
+#include "Transform.h"
+#include "Vector.h"
+#include "VertexWelder.h"
+
+/** operator new を呼び出した回数 */
+static std::atomic<unsigned long> heapAllocations(0);
+
+// 置き換えた operator new と delete の対応を GCC は見抜けず free() に警告を出す
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+/** 確保の回数を数えるために置き換えた operator new */
+void* operator new(std::size_t size)
+{
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* const p(std::malloc(size > 0 ? size : 1));
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+/** 計測に使う角度を回数から求める */
+static GLfloat angle(long long i)
+{
+    return static_cast<GLfloat>(i & 1023) * 0.001f;
+}
+
+/** コンパイル時に求めた行列 */
+constexpr Matrix constantLookAt(
+    Matrix::lookAt(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+constexpr Matrix constantRotate(Matrix::rotate(0.7f, 1.0f, 2.0f, 3.0f));
+constexpr Matrix constantPerspective(Matrix::perspective(1.0f, 1.333f, 1.0f, 10.0f));
+constexpr Matrix constantFrustum(Matrix::frustum(-1.0f, 1.0f, -0.75f, 0.75f, 1.0f, 10.0f));
+constexpr Matrix constantOrthogonal(Matrix::orthogonal(-2.0f, 2.0f, -1.5f, 1.5f, 1.0f, 10.0f));
+constexpr Matrix constantModel(Matrix::translate(1.0f, 2.0f, 3.0f) * Matrix::scale(2.0f, 2.0f, 2.0f)
+                               * constantRotate);
+constexpr Matrix constantInverse(constantModel.inverse());
+constexpr Vector constantPoint(constantLookAt * Vector {0.0f, 0.0f, 5.0f, 1.0f});
+
+static_assert(constantModel[12] == 1.0f && constantModel[13] == 2.0f && constantModel[14] == 3.0f,
+              "Matrix::translate should fold at compile time");
+constexpr Matrix constantChain(LazyMatrix::affine(constantLookAt)
+                               * LazyMatrix::translate(1.0f, 2.0f, 3.0f)
+                               * LazyMatrix::scale(2.0f, 2.0f, 2.0f) * constantRotate);
+
+static_assert(constantPerspective[11] == -1.0f && constantPerspective[15] == 0.0f,
+              "Matrix::perspective should fold at compile time");
+
+/** 二つの配列の要素が誤差の範囲で一致するか確かめる */
+static bool sameValues(
+    const char* kind, const char* name, const GLfloat* a, const GLfloat* b, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        if (std::fabs(a[i] - b[i]) > 1.0e-5f * (1.0f + std::fabs(b[i])))
+        {
+            std::cerr << kind << " mismatch in " << name << "[" << i << "]: " << a[i]
+                      << " != " << b[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief コンパイル時に求めた行列と実行時に求めた行列が一致するか確かめる
+ *
+ * @return true 全て一致した
+ * @return false 一致しないものがあった
+ */
+bool verifyConstexpr()
+{
+    const auto same = [](const char* name, const GLfloat* a, const GLfloat* b, int n) {
+        return sameValues("constexpr", name, a, b, n);
+    };
+
+    // opaque() で実行時に求めさせる
+    const Matrix lookAt(Matrix::lookAt(
+        opaque(3.0f), 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix rotate(Matrix::rotate(opaque(0.7f), 1.0f, 2.0f, 3.0f));
+    const Matrix perspective(Matrix::perspective(opaque(1.0f), 1.333f, 1.0f, 10.0f));
+    const Matrix frustum(Matrix::frustum(opaque(-1.0f), 1.0f, -0.75f, 0.75f, 1.0f, 10.0f));
+    const Matrix orthogonal(Matrix::orthogonal(opaque(-2.0f), 2.0f, -1.5f, 1.5f, 1.0f, 10.0f));
+    const Matrix model(Matrix::translate(opaque(1.0f), 2.0f, 3.0f)
+                       * Matrix::scale(2.0f, 2.0f, 2.0f) * rotate);
+    const Vector point(lookAt * Vector {0.0f, 0.0f, opaque(5.0f), 1.0f});
+
+    return same("lookAt", constantLookAt.data(), lookAt.data(), 16)
+           & same("rotate", constantRotate.data(), rotate.data(), 16)
+           & same("perspective", constantPerspective.data(), perspective.data(), 16)
+           & same("frustum", constantFrustum.data(), frustum.data(), 16)
+           & same("orthogonal", constantOrthogonal.data(), orthogonal.data(), 16)
+           & same("model", constantModel.data(), model.data(), 16)
+           & same("inverse", constantInverse.data(), model.inverse().data(), 16)
+           & same("point", constantPoint.data(), point.data(), 4);
+}
+
+/**
+ * @brief 式で遅延評価した積と Matrix の積が一致するか確かめる
+ *
+ * @return true 全て一致した
+ * @return false 一致しないものがあった
+ */
+bool verifyExpression()
+{
+    const auto same = [](const char* name, const Matrix& a, const Matrix& b) {
+        return sameValues("expression", name, a.data(), b.data(), 16);
+    };
+
+    const Matrix view(Matrix::lookAt(opaque(3.0f), 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix projection(Matrix::perspective(opaque(1.0f), 1.333f, 1.0f, 10.0f));
+    const Matrix r(Matrix::rotate(opaque(0.7f), 1.0f, 2.0f, 3.0f));
+    const Matrix t(Matrix::translate(opaque(1.0f), 2.0f, 3.0f));
+    const Matrix s(Matrix::scale(opaque(2.0f), 0.5f, 3.0f));
+    const Transform model(Transform::translate(1.0f, 2.0f, 3.0f)
+                          * Transform::rotate(opaque(0.7f), 1.0f, 2.0f, 3.0f)
+                          * Transform::scale(2.0f, 0.5f, 3.0f));
+
+    const Matrix chain(LazyMatrix::affine(view) * LazyMatrix::translate(opaque(1.0f), 2.0f, 3.0f)
+                       * LazyMatrix::rotate(0.7f, 1.0f, 2.0f, 3.0f)
+                       * LazyMatrix::scale(2.0f, 0.5f, 3.0f));
+    const Matrix projected(projection * LazyMatrix::affine(view) * LazyMatrix::transform(model)
+                           * LazyMatrix::translate(0.0f, 0.0f, 3.0f));
+    const Matrix general(LazyMatrix::general(projection) * LazyMatrix::general(view)
+                         * LazyMatrix::general(t) * LazyMatrix::general(r));
+    const Matrix scaled(LazyMatrix::scale(opaque(2.0f), 0.5f, 3.0f) * projection
+                        * LazyMatrix::rotate(0.7f, 1.0f, 2.0f, 3.0f));
+
+    return same("chain", chain, view * t * r * s)
+           & same("projected",
+                  projected,
+                  projection * view * model.getMatrix() * Matrix::translate(0.0f, 0.0f, 3.0f))
+           & same("general", general, projection * view * t * r)
+           & same("scaled", scaled, s * projection * r)
+           & same("constexpr",
+                  constantChain,
+                  constantLookAt * Matrix::translate(1.0f, 2.0f, 3.0f)
+                      * Matrix::scale(2.0f, 2.0f, 2.0f) * constantRotate);
+}
+
+/**
+ * @brief 遮蔽の判定が単純な配置で正しいか確かめる
+ *
+ * @return true 全て正しい
+ * @return false 正しくないものがあった
+ */
+bool verifyOcclusion()
+{
+    std::vector<Object::Vertex> vertex, sphereVertex;
+    std::vector<GLuint> index, sphereIndex;
+    createBox(vertex, index);
+    createSphere(32, 16, sphereVertex, sphereIndex);
+
+    // 遮蔽物を描いた深度バッファを作る
+    const auto occlude = [](OcclusionCuller& culler,
+                            const Matrix& mvp,
+                            const std::vector<Object::Vertex>& v,
+                            const std::vector<GLuint>& i) {
+        culler.addOccluder(mvp,
+                           static_cast<GLsizei>(v.size()),
+                           v.data(),
+                           static_cast<GLsizei>(i.size()),
+                           i.data());
+        culler.rasterize();
+    };
+
+    // 原点から -z 方向を見て、z = -10 に大きな壁を置く
+    const Matrix projection(Matrix::perspective(1.0f, 2.0f, 1.0f, 100.0f));
+    const Matrix wall(Matrix::translate(0.0f, 0.0f, -10.0f) * Matrix::scale(5.0f, 5.0f, 0.5f));
+    OcclusionCuller culler(256, 128, 2);
+    occlude(culler, projection * wall, vertex, index);
+
+    // z = -5 の球の後ろに同じ大きさの球を置く
+    const Matrix front(Matrix::translate(0.0f, 0.0f, -5.0f));
+    const Matrix back(Matrix::translate(0.0f, 0.0f, -15.0f));
+    OcclusionCuller spheres(256, 128, 2);
+    occlude(spheres, projection * front, sphereVertex, sphereIndex);
+    occlude(spheres, projection * back, sphereVertex, sphereIndex);
+
+    // 近くの面より手前にある壁と、ガードバンドからはみ出す大きな壁は遮蔽物として描かない
+    const Matrix close(Matrix::translate(0.0f, 0.0f, -0.5f) * Matrix::scale(5.0f, 5.0f, 0.1f));
+    const Matrix huge(Matrix::translate(0.0f, 0.0f, -10.0f) * Matrix::scale(1.0e6f, 1.0e6f, 0.5f));
+    OcclusionCuller nearWall(256, 128, 2), hugeWall(256, 128, 2);
+    occlude(nearWall, projection * close, vertex, index);
+    occlude(hugeWall, projection * huge, vertex, index);
+
+    const GLfloat min[] = {-1.0f, -1.0f, -1.0f}, max[] = {1.0f, 1.0f, 1.0f};
+    const auto visible = [&](GLfloat x, GLfloat y, GLfloat z) {
+        return culler.isVisible(projection * Matrix::translate(x, y, z), min, max);
+    };
+    const Matrix behind(projection * Matrix::translate(0.0f, 0.0f, -20.0f));
+
+    const struct
+    {
+        const char* name;
+        bool result, expected;
+    } cases[] = {{"behind", visible(0.0f, 0.0f, -20.0f), false},
+                 {"in front", visible(0.0f, 0.0f, -5.0f), true},
+                 {"beside", visible(12.0f, 0.0f, -20.0f), true},
+                 {"partly behind", visible(10.0f, 0.0f, -20.0f), true},
+                 {"off screen", visible(0.0f, 0.0f, 20.0f), true},
+                 {"outside", visible(100.0f, 0.0f, -20.0f), false},
+                 {"wall", culler.isVisible(projection * wall, min, max), true},
+                 {"front sphere", spheres.isVisible(projection * front, min, max), true},
+                 {"back sphere", spheres.isVisible(projection * back, min, max), false},
+                 {"near wall", nearWall.isVisible(behind, min, max), true},
+                 {"huge wall", hugeWall.isVisible(behind, min, max), true}};
+
+    bool ok(true);
+    for (const auto& c : cases)
+    {
+        if (c.result != c.expected)
+        {
+            std::cerr << "occlusion mismatch in " << c.name << ": " << c.result
+                      << " != " << c.expected << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/**
+ * @brief 定常状態のフレームでヒープから確保しないことを確かめる
+ *
+ * 動く球を CPU で描き、箱を遮蔽物にする一連のフレームを二度繰り返し、
+ * 二度目には operator new もアリーナのヒープからの確保も起きないことを確かめる。
+ *
+ * @return true ヒープから確保しなかった
+ * @return false ヒープから確保したか、アリーナの確保が正しくない
+ */
+bool verifyFrameArena()
+{
+    // アリーナのアライメントとまとめなおし
+    FrameArena arena(256);
+    bool ok(true);
+    for (int frame = 0; frame < 2; ++frame)
+    {
+        for (std::size_t size = 1; size <= 4096; size *= 2)
+        {
+            const std::size_t alignment(std::min(size, static_cast<std::size_t>(64)));
+            if (reinterpret_cast<std::uintptr_t>(arena.allocate(size, alignment)) % alignment)
+                ok = false;
+        }
+        if (frame == 1 && arena.getFrameMallocs() != 0)
+            ok = false;
+        arena.reset();
+    }
+    if (!ok)
+    {
+        std::cerr << "frame arena: misaligned or reallocated in the second frame" << std::endl;
+        return false;
+    }
+
+    std::vector<Object::Vertex> sphereVertex, boxVertex;
+    std::vector<GLuint> sphereIndex, boxIndex;
+    createSphere(32, 16, sphereVertex, sphereIndex);
+    createBox(boxVertex, boxIndex);
+    const SoftwareRenderer::Mesh mesh = {static_cast<GLsizei>(sphereVertex.size()),
+                                         sphereVertex.data(),
+                                         static_cast<GLsizei>(sphereIndex.size()),
+                                         sphereIndex.data(),
+                                         NULL};
+    static constexpr Material color[] = {
+        {0.6f, 0.6f, 0.2f, 0.6f, 0.6f, 0.2f, 0.3f, 0.3f, 0.3f, 30.0f}};
+    static constexpr GLfloat light[] = {1.0f, 1.0f, 1.0f};
+    const Vector position[] = {Vector {0.0f, 0.0f, 5.0f, 1.0f}};
+    const Matrix projection(Matrix::perspective(0.8f, 4.0f / 3.0f, 1.0f, 30.0f));
+
+    SoftwareRenderer renderer(320, 240, 2);
+    renderer.setMaterials(color, 1);
+    renderer.setLights(1, light, light, light);
+    OcclusionCuller culler(128, 96, 2);
+
+    // 物体の数と位置がフレームごとに変わる場面
+    const auto frames = [&]() {
+        for (int frame = 0; frame < 32; ++frame)
+        {
+            const GLfloat t(static_cast<GLfloat>(frame) * 0.2f);
+            culler.clear();
+            renderer.begin(projection, position);
+            for (int k = 0; k <= frame % 8; ++k)
+            {
+                const Matrix modelView(Matrix::translate(std::sin(t + k) * 3.0f,
+                                                         std::cos(t * 0.7f + k) * 2.0f,
+                                                         -8.0f - static_cast<GLfloat>(k)));
+                GLfloat normalMatrix[9];
+                modelView.getNormalMatrix(normalMatrix);
+                renderer.draw(mesh, 0, 0, modelView, normalMatrix);
+                culler.addOccluder(projection * modelView,
+                                   static_cast<GLsizei>(boxVertex.size()),
+                                   boxVertex.data(),
+                                   static_cast<GLsizei>(boxIndex.size()),
+                                   boxIndex.data());
+            }
+            renderer.finish();
+            culler.rasterize();
+            FrameArena::local().reset();
+        }
+    };
+
+    // 一度目で容量が揃うので、同じフレームを繰り返すともう確保しない
+    frames();
+    const unsigned long news(heapAllocations.load()), mallocs(FrameArena::getTotalMallocs());
+    frames();
+    const unsigned long steadyNews(heapAllocations.load() - news);
+    const unsigned long steadyMallocs(FrameArena::getTotalMallocs() - mallocs);
+    std::cerr << "frame arena: " << steadyNews << " operator new and " << steadyMallocs
+              << " arena mallocs in 32 steady frames, local peak " << FrameArena::local().getPeak()
+              << "B" << std::endl;
+    return steadyNews == 0 && steadyMallocs == 0;
+}
+
+/** 行列の計算のベンチマーク */
+void benchmarkMatrix(Benchmark& bench)
+{
+    const Matrix a(Matrix::rotate(opaque(0.5f), 0.0f, 1.0f, 0.0f));
+    const Matrix b(Matrix::translate(opaque(1.0f), 2.0f, 3.0f));
+
+    bench.run("matrix/multiply", [&](long long i) {
+        Matrix m(a);
+        m[12] = angle(i);
+        keep(m * b);
+    });
+
+    bench.run("matrix/rotate", [&](long long i) {
+        keep(Matrix::rotate(angle(i), 0.0f, 1.0f, 0.0f));
+    });
+
+    bench.run("matrix/translate", [&](long long i) {
+        keep(Matrix::translate(angle(i), 0.0f, 0.0f));
+    });
+
+    bench.run("matrix/lookAt", [&](long long i) {
+        keep(Matrix::lookAt(3.0f, 4.0f, angle(i) + 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    });
+
+    // コンパイル時に求めた行列は読み出すだけ
+    bench.run("matrix/lookAt_constexpr", [&](long long) {
+        Matrix m(constantLookAt);
+        keep(m);
+    });
+
+    bench.run("matrix/perspective", [&](long long i) {
+        keep(Matrix::perspective(angle(i) + 1.0f, 1.333f, 1.0f, 10.0f));
+    });
+
+    bench.run("matrix/getNormalMatrix", [&](long long i) {
+        Matrix m(a);
+        m[12] = angle(i);
+        GLfloat normalMatrix[9];
+        m.getNormalMatrix(normalMatrix);
+        keep(normalMatrix);
+    });
+
+    // main() で毎フレーム行っている一つの物体分の計算
+    bench.run("matrix/frame_model_view", [&](long long i) {
+        const Matrix r(Matrix::rotate(angle(i), 0.0f, 1.0f, 0.0f));
+        const Matrix model(Matrix::translate(0.1f, 0.2f, 0.0f) * r);
+        const Matrix view(Matrix::lookAt(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        const Matrix modelView(view * model);
+        GLfloat normalMatrix[9];
+        modelView.getNormalMatrix(normalMatrix);
+        keep(modelView);
+        keep(normalMatrix);
+    });
+}
+
+/** 回転・平行移動・拡大縮小による変換と逆行列のベンチマーク */
+void benchmarkTransform(Benchmark& bench)
+{
+    const Matrix m(Matrix::translate(1.0f, 2.0f, 3.0f) * Matrix::rotate(0.7f, 1.0f, 2.0f, 3.0f));
+    const Transform t(Transform::translate(1.0f, 2.0f, 3.0f)
+                      * Transform::rotate(0.7f, 1.0f, 2.0f, 3.0f));
+
+    bench.run("transform/compose", [&](long long i) {
+        keep(Transform::translate(angle(i), 0.0f, 0.0f) * t);
+    });
+
+    bench.run("transform/getMatrix", [&](long long i) {
+        Transform u(Transform::translate(angle(i), 0.0f, 0.0f));
+        keep(u.getMatrix());
+    });
+
+    bench.run("transform/getNormalMatrix", [&](long long i) {
+        Transform u(Transform::rotate(angle(i), 0.0f, 1.0f, 0.0f));
+        GLfloat normalMatrix[9];
+        u.getNormalMatrix(normalMatrix);
+        keep(normalMatrix);
+    });
+
+    bench.run("matrix/inverse_affine", [&](long long i) {
+        Matrix a(m);
+        a[12] = angle(i);
+        keep(a.inverse());
+    });
+
+    const Matrix p(Matrix::perspective(1.0f, 1.333f, 1.0f, 10.0f) * m);
+    bench.run("matrix/inverse_general", [&](long long i) {
+        Matrix a(p);
+        a[12] = angle(i);
+        keep(a.inverse());
+    });
+
+    bench.run("matrix/rigidInverse", [&](long long i) {
+        Matrix a(m);
+        a[12] = angle(i);
+        keep(a.rigidInverse());
+    });
+
+    // 千個の物体の法線ベクトルの変換行列
+    std::vector<Matrix> matrices(1000, m);
+    std::vector<GLfloat> normals(matrices.size() * 9);
+    bench.run("matrix/getNormalMatrix_1000", [&](long long i) {
+        matrices[i % matrices.size()][12] = angle(i);
+        for (std::size_t k = 0; k < matrices.size(); ++k)
+        {
+            matrices[k].getNormalMatrix(&normals[k * 9]);
+        }
+        keep(normals.data());
+    });
+
+    bench.run("matrix/getNormalMatrices_1000", [&](long long i) {
+        matrices[i % matrices.size()][12] = angle(i);
+        Matrix::getNormalMatrices(matrices.data(), matrices.size(), normals.data());
+        keep(normals.data());
+    });
+}
+
+/** 遅延評価した行列の積と Matrix の積を比べるベンチマーク */
+void benchmarkExpression(Benchmark& bench)
+{
+    const Matrix view(Matrix::lookAt(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix projection(Matrix::perspective(1.0f, 1.333f, 1.0f, 10.0f));
+    const Matrix a(Matrix::rotate(opaque(0.5f), 0.0f, 1.0f, 0.0f));
+    const Matrix b(Matrix::translate(opaque(1.0f), 2.0f, 3.0f));
+
+    // main() のモデルビュー変換行列 (view * translate * rotate)
+    bench.run("expression/model_view_eager", [&](long long i) {
+        keep(view * Matrix::translate(angle(i), 0.2f, 0.0f)
+             * Matrix::rotate(0.3f, 0.0f, 1.0f, 0.0f));
+    });
+
+    bench.run("expression/model_view_lazy", [&](long long i) {
+        const Matrix m(LazyMatrix::affine(view) * LazyMatrix::translate(angle(i), 0.2f, 0.0f)
+                       * LazyMatrix::rotate(0.3f, 0.0f, 1.0f, 0.0f));
+        keep(m);
+    });
+
+    // 既にあるモデルビュー変換行列に平行移動を掛ける
+    bench.run("expression/translate_eager", [&](long long i) {
+        Matrix m(a);
+        m[12] = angle(i);
+        keep(m * Matrix::translate(0.0f, 0.0f, 3.0f));
+    });
+
+    bench.run("expression/translate_lazy", [&](long long i) {
+        Matrix m(a);
+        m[12] = angle(i);
+        const Matrix n(LazyMatrix::affine(m) * LazyMatrix::translate(0.0f, 0.0f, 3.0f));
+        keep(n);
+    });
+
+    // 投影まで含めた五つの変換の連鎖
+    bench.run("expression/chain5_eager", [&](long long i) {
+        keep(projection * view * Matrix::translate(angle(i), 0.2f, 0.0f)
+             * Matrix::rotate(angle(i), 0.0f, 1.0f, 0.0f) * Matrix::scale(2.0f, 2.0f, 2.0f));
+    });
+
+    bench.run("expression/chain5_lazy", [&](long long i) {
+        const Matrix m(projection * LazyMatrix::affine(view)
+                       * LazyMatrix::translate(angle(i), 0.2f, 0.0f)
+                       * LazyMatrix::rotate(angle(i), 0.0f, 1.0f, 0.0f)
+                       * LazyMatrix::scale(2.0f, 2.0f, 2.0f));
+        keep(m);
+    });
+
+    // 構造のわからない行列だけの連鎖 (一時オブジェクトを作らない効果だけ)
+    bench.run("expression/general4_eager", [&](long long i) {
+        Matrix m(a);
+        m[12] = angle(i);
+        keep(projection * view * m * b);
+    });
+
+    bench.run("expression/general4_lazy", [&](long long i) {
+        Matrix m(a);
+        m[12] = angle(i);
+        const Matrix n(LazyMatrix::general(projection) * LazyMatrix::general(view)
+                       * LazyMatrix::general(m) * LazyMatrix::general(b));
+        keep(n);
+    });
+}
+
+/** 詳細度の選択のベンチマーク */
+void benchmarkLod(Benchmark& bench)
+{
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    LevelOfDetail lod;
+    createSphereLod(64, 32, 4, vertex, index, lod);
+
+    // 奥に向かって一列に並べた千個の球
+    const Matrix view(Matrix::lookAt(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix projection(Matrix::perspective(1.0f, 1.333f, 1.0f, 1000.0f));
+    std::vector<Matrix> modelView(1000);
+    for (std::size_t k = 0; k < modelView.size(); ++k)
+    {
+        modelView[k] = view * Matrix::translate(0.0f, 0.0f, -static_cast<GLfloat>(k));
+    }
+    std::vector<GLsizei> levels(modelView.size(), 0);
+
+    bench.run("lod/select_1000", [&](long long i) {
+        const GLsizei height(480 + static_cast<GLsizei>(i & 1));
+        for (std::size_t k = 0; k < modelView.size(); ++k)
+        {
+            levels[k] = lod.select(modelView[k], projection, height, levels[k]);
+        }
+        keep(levels.data());
+    });
+}
+
+/** 辺の縮約による三角形の削減のベンチマーク */
+void benchmarkSimplifier(Benchmark& bench)
+{
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    createSphere(256, 128, vertex, index);
+
+    // 読み込みのときに一つの詳細度を作る
+    std::vector<GLuint> result;
+    bench.run("simplifier/sphere_256x128_quarter", [&](long long) {
+        Simplifier simplifier(vertex, index);
+        simplifier.simplifyRatio(0.25);
+        simplifier.getIndex(result);
+        keep(result.data());
+    });
+
+    // 三角形の数を半分ずつにした四つの詳細度
+    bench.run("simplifier/sphere_256x128_lod4", [&](long long) {
+        LevelOfDetail lod;
+        createSimplifiedLod(vertex, index, 4, 0.5, result, lod);
+        keep(result.data());
+    });
+
+    // 四百万個の三角形の図形 (頂点ごとの三角形の一覧と候補の heap の大きさが効く)
+    // 一回に十数秒かかるので --filter で名前を指定したときだけ図形を作って計測する
+    const std::string large("simplifier/sphere_2048x1024_quarter");
+    if (bench.isSelected(large))
+    {
+        createSphere(2048, 1024, vertex, index);
+        bench.run(large, [&](long long) {
+            Simplifier simplifier(vertex, index);
+            simplifier.simplifyRatio(0.25);
+            simplifier.getIndex(result);
+            keep(result.data());
+        });
+    }
+}
+
+/** 重複する頂点をまとめるベンチマーク */
+void benchmarkWelder(Benchmark& bench)
+{
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    createSphere(256, 128, vertex, index);
+    const GLsizei vertexcount(static_cast<GLsizei>(vertex.size()));
+    const GLsizei indexcount(static_cast<GLsizei>(index.size()));
+
+    // 頂点の数がどれだけ減るか
+    const VertexWelder exact(vertexcount, vertex.data(), indexcount, index.data());
+    const VertexWelder quantized(vertexcount, vertex.data(), indexcount, index.data(), 1.0e-5f);
+    std::cerr << "welder/sphere_256x128: " << vertexcount << " -> " << exact.getVertexCount()
+              << " vertices (exact), " << quantized.getVertexCount() << " vertices (1e-5), "
+              << indexcount << " -> " << quantized.getIndexCount() << " indices" << std::endl;
+
+    // 頂点の順に三角形を並べた立方体
+    std::vector<Object::Vertex> cube;
+    for (int face = 0; face < 6; ++face)
+    {
+        const int axis(face / 2);
+        const GLfloat sign(face % 2 == 0 ? 1.0f : -1.0f);
+        const GLfloat corner[][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, -1}, {1, 1}, {-1, 1}};
+        for (const GLfloat* c : corner)
+        {
+            Object::Vertex v {};
+            v.position[axis]           = sign;
+            v.position[(axis + 1) % 3] = c[0];
+            v.position[(axis + 2) % 3] = c[1];
+            v.normal[axis]             = sign;
+            cube.push_back(v);
+        }
+    }
+    const VertexWelder welded(static_cast<GLsizei>(cube.size()), cube.data());
+    std::cerr << "welder/cube: " << cube.size() << " -> " << welded.getVertexCount()
+              << " vertices" << std::endl;
+
+    bench.run("welder/sphere_256x128_exact", [&](long long) {
+        const VertexWelder w(vertexcount, vertex.data(), indexcount, index.data());
+        keep(w.getVertexCount());
+    });
+
+    bench.run("welder/sphere_256x128_epsilon", [&](long long) {
+        const VertexWelder w(vertexcount, vertex.data(), indexcount, index.data(), 1.0e-5f);
+        keep(w.getVertexCount());
+    });
+}
+
+/** 街区を模した場面での遮蔽の判定のベンチマーク */
+void benchmarkOcclusion(Benchmark& bench)
+{
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    createBox(vertex, index);
+    const GLsizei vertexcount(static_cast<GLsizei>(vertex.size()));
+    const GLsizei indexcount(static_cast<GLsizei>(index.size()));
+
+    // 32x32 の街区に高さの異なる建物を並べ、通りの間に小物を置く
+    const int blocks(32);
+    const GLfloat spacing(10.0f);
+    std::vector<Matrix> buildings, props;
+    unsigned int seed(1);
+    const auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<GLfloat>(seed >> 8) / static_cast<GLfloat>(1 << 24);
+    };
+    for (int j = 0; j < blocks; ++j)
+    {
+        for (int i = 0; i < blocks; ++i)
+        {
+            const GLfloat x(i * spacing), z(-j * spacing), h(5.0f + random() * 30.0f);
+            buildings.push_back(Matrix::translate(x, h, z) * Matrix::scale(3.5f, h, 3.5f));
+            for (int k = 0; k < 8; ++k)
+            {
+                const GLfloat px(x + 5.0f + (random() - 0.5f) * 2.0f);
+                const GLfloat pz(z + (random() - 0.5f) * spacing);
+                props.push_back(Matrix::translate(px, 0.5f, pz) * Matrix::scale(0.5f, 0.5f, 0.5f));
+            }
+        }
+    }
+
+    // 通りの上で街の奥を見る
+    const Matrix view(Matrix::lookAt(
+        spacing * 15.5f, 2.0f, 5.0f, spacing * 15.0f, 4.0f, -100.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix projection(Matrix::perspective(1.0f, 16.0f / 9.0f, 0.5f, 1000.0f));
+    const Matrix viewProjection(projection * view);
+    std::vector<Matrix> mvp;
+    for (const Matrix& m : buildings)
+    {
+        mvp.push_back(viewProjection * m);
+    }
+    for (const Matrix& m : props)
+    {
+        mvp.push_back(viewProjection * m);
+    }
+
+    const GLfloat min[] = {-1.0f, -1.0f, -1.0f}, max[] = {1.0f, 1.0f, 1.0f};
+    const auto occlude = [&](OcclusionCuller& culler) {
+        culler.clear();
+        for (std::size_t k = 0; k < buildings.size(); ++k)
+        {
+            culler.addOccluder(mvp[k], vertexcount, vertex.data(), indexcount, index.data());
+        }
+        culler.rasterize();
+    };
+
+    // 見えないと判定した物体の割合
+    {
+        OcclusionCuller culler(256, 144, 1);
+        occlude(culler);
+        std::size_t visible(0);
+        for (const Matrix& m : mvp)
+        {
+            visible += culler.isVisible(m, min, max);
+        }
+        std::cerr << "occlusion/city: " << culler.getOccluderTriangles() << " occluder triangles, "
+                  << mvp.size() << " objects, " << visible << " visible ("
+                  << 100.0 * (mvp.size() - visible) / mvp.size() << "% culled)" << std::endl;
+    }
+
+    for (unsigned int threads : {1u, 2u, 4u})
+    {
+        OcclusionCuller culler(256, 144, threads);
+        bench.run("occlusion/city_rasterize_" + std::to_string(threads) + "t", [&](long long) {
+            occlude(culler);
+            keep(culler.getDepth());
+        });
+    }
+
+    OcclusionCuller culler(256, 144, 1);
+    occlude(culler);
+    bench.run("occlusion/city_test_" + std::to_string(mvp.size()), [&](long long) {
+        std::size_t visible(0);
+        for (const Matrix& m : mvp)
+        {
+            visible += culler.isVisible(m, min, max);
+        }
+        keep(visible);
+    });
+}
+
+/** CPU で球を並べた場面を描くベンチマーク (スレッドの数ごと) */
+void benchmarkSoftware(Benchmark& bench)
+{
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    createSphere(64, 32, vertex, index);
+    const SoftwareRenderer::Mesh mesh = {static_cast<GLsizei>(vertex.size()),
+                                         vertex.data(),
+                                         static_cast<GLsizei>(index.size()),
+                                         index.data(),
+                                         NULL};
+    static constexpr Material color[] = {
+        {0.6f, 0.6f, 0.2f, 0.6f, 0.6f, 0.2f, 0.3f, 0.3f, 0.3f, 30.0f},
+        {0.1f, 0.1f, 0.5f, 0.1f, 0.1f, 0.5f, 0.4f, 0.4f, 0.4f, 60.0f}};
+    static constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
+    static constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+    static constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+
+    // 5x5 に並べた球を斜め上から見る
+    const Matrix view(Matrix::lookAt(3.0f, 6.0f, 9.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+    const Matrix projection(Matrix::perspective(0.8f, 4.0f / 3.0f, 1.0f, 30.0f));
+    const Vector lights[] = {view * Vector {0.0f, 0.0f, 5.0f, 1.0f},
+                             view * Vector {8.0f, 0.0f, 0.0f, 1.0f}};
+    std::vector<Matrix> modelView;
+    for (int j = -2; j <= 2; ++j)
+    {
+        for (int i = -2; i <= 2; ++i)
+        {
+            modelView.push_back(view * Matrix::translate(i * 1.6f, 0.0f, j * 1.6f));
+        }
+    }
+    GLfloat normalMatrix[9];
+    view.getNormalMatrix(normalMatrix);
+
+    const unsigned int cores(std::max(std::thread::hardware_concurrency(), 1u));
+    std::vector<unsigned int> counts = {1u, 2u, 4u};
+    if (std::find(counts.begin(), counts.end(), cores) == counts.end())
+        counts.push_back(cores);
+    for (unsigned int threads : counts)
+    {
+        SoftwareRenderer renderer(640, 480, threads);
+        renderer.setClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+        renderer.setMaterials(color, 2);
+        renderer.setLights(2, Lamb, Ldiff, Lspec);
+        bench.run("software/spheres_640x480_" + std::to_string(threads) + "t", [&](long long) {
+            renderer.begin(projection, lights);
+            for (std::size_t k = 0; k < modelView.size(); ++k)
+            {
+                renderer.draw(mesh, 0, k & 1, modelView[k], normalMatrix);
+            }
+            renderer.finish();
+            FrameArena::local().reset();
+            keep(renderer.getPixels());
+        });
+    }
+}
+
+/** 材質の表に重複を含む材質を追加するベンチマーク */
+void benchmarkMaterial(Benchmark& bench)
+{
+    // 10000 回の追加のうち異なる材質は 1000 種類
+    std::vector<Material> source;
+    for (int i = 0; i < 10000; ++i)
+    {
+        const GLfloat v(static_cast<GLfloat>(i % 1000) / 1000.0f);
+        source.push_back({v, v, v, 0.5f, v, 0.5f, 0.3f, 0.3f, 0.3f, 10.0f + v});
+    }
+
+    {
+        MaterialTable table(source.data(), static_cast<unsigned int>(source.size()));
+
+        // 材質ごとにアラインメント (多くの環境で 256 バイト) に揃えた場合と比べる
+        std::cerr << "material/table: " << source.size() << " added, " << table.size()
+                  << " unique (" << table.getDuplicates() << " duplicates), "
+                  << table.getBytes() << " bytes packed vs " << source.size() * 256
+                  << " bytes at 256-byte alignment" << std::endl;
+    }
+
+    bench.run("material/add_10000", [&](long long) {
+        MaterialTable table;
+        unsigned int sum(0);
+        for (const Material& m : source)
+        {
+            sum += table.add(m);
+        }
+        keep(sum);
+    });
+}
+
+/** ベクトルの変換のベンチマーク */
+void benchmarkVector(Benchmark& bench)
+{
+    const Matrix view(Matrix::lookAt(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+
+    bench.run("vector/transform", [&](long long i) {
+        const Vector v = {angle(i), 0.0f, 5.0f, 1.0f};
+        keep(view * v);
+    });
+
+    std::vector<Vector> points(1024);
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        points[i] = {static_cast<GLfloat>(i), 1.0f, 2.0f, 1.0f};
+    }
+    std::vector<Vector> transformed(points.size());
+    bench.run("vector/transform_1024", [&](long long i) {
+        for (std::size_t j = 0; j < points.size(); ++j)
+        {
+            transformed[j] = view * points[j];
+        }
+        keep(transformed[i & 1023]);
+    });
+}
+
+/** 球の頂点属性とインデックスの作成のベンチマーク */
+void benchmarkSphere(Benchmark& bench)
+{
+    static constexpr int divisions[][2] = {{16, 8}, {32, 16}, {64, 32}, {128, 64}, {256, 128}};
+
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    for (const auto& d : divisions)
+    {
+        const std::string name(
+            "sphere/" + std::to_string(d[0]) + "x" + std::to_string(d[1]));
+
+        // 新しい配列に作成する
+        bench.run(name, [&](long long) {
+            std::vector<Object::Vertex> v;
+            std::vector<GLuint> k;
+            createSphere(d[0], d[1], v, k);
+            keep(v.data());
+            keep(k.data());
+        });
+
+        // 確保済みの配列を使い回す
+        bench.run(name + "_reuse", [&](long long) {
+            createSphere(d[0], d[1], vertex, index);
+            keep(vertex.data());
+            keep(index.data());
+        });
+    }
+}
+
+/** シェーダのソースファイルの読み込みのベンチマーク */
+void benchmarkShader(Benchmark& bench, const std::string& resources)
+{
+    for (const char* file : {"point.vert", "point.frag"})
+    {
+        const std::string name(resources + "/" + file);
+        std::string source;
+        if (!readShaderSource(name, source))
+            continue;
+
+        bench.run(std::string("shader/readShaderSource/") + file, [&](long long) {
+            std::string result;
+            readShaderSource(name, result);
+            keep(result.data());
+        });
+    }
+}
+
+/**
+ * OpenGL のコンテキストを使わない計算のマイクロベンチマーク
+ *
+ * usage: benchmarks [--filter <name>] [--out <file.json>] [--min-time <seconds>]
+ *                   [--resources <dir>]
+ */
+int main(int argc, char* argv[])
+{
+    std::string filter, out, resources("resources");
+    double minTime(0.1);
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        if (arg == "--filter" && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (arg == "--out" && i + 1 < argc)
+        {
+            out = argv[++i];
+        }
+        else if (arg == "--min-time" && i + 1 < argc)
+        {
+            minTime = std::atof(argv[++i]);
+        }
+        else if (arg == "--resources" && i + 1 < argc)
+        {
+            resources = argv[++i];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter <name>] [--out <file.json>] [--min-time <seconds>]"
+                         " [--resources <dir>]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // コンパイル時と実行時、遅延評価と Matrix の積で結果が変わらないこと、
+    // 定常状態のフレームでヒープから確保しないことを確かめてから計測する
+    if (!verifyConstexpr() || !verifyExpression() || !verifyOcclusion() || !verifyFrameArena())
+        return 1;
+
+    Benchmark bench(filter, minTime);
+    benchmarkMatrix(bench);
+    benchmarkTransform(bench);
+    benchmarkExpression(bench);
+    benchmarkLod(bench);
+    benchmarkSimplifier(bench);
+    benchmarkWelder(bench);
+    benchmarkOcclusion(bench);
+    benchmarkSoftware(bench);
+    benchmarkMaterial(bench);
+    benchmarkVector(bench);
+    benchmarkSphere(bench);
+    benchmarkShader(bench, resources);
+
+    if (out.empty())
+    {
+        bench.print(std::cout);
+    }
+    else
+    {
+        std::ofstream file(out);
+        bench.print(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "Shader.h"
+#include "Shape.h"
+#include "SolidShapeIndex.h"
+#include "SolidShapeStrip.h"
+#include "Sphere.h"
+#include "Window.h"
+
+/** 頂点を変換するだけのバーテックスシェーダ */
+static const char* const vsrc =
+    "#version 150 core\n"
+    "in vec4 position;\n"
+    "in vec3 normal;\n"
+    "void main() { gl_Position = vec4(position.xyz * 0.9, 1.0); }\n";
+
+/** 単色で塗りつぶすフラグメントシェーダ */
+static const char* const fsrc =
+    "#version 150 core\n"
+    "out vec4 fragment;\n"
+    "void main() { fragment = vec4(1.0); }\n";
+
+/**
+ * @brief 図形を繰り返し描画して一回あたりの時間を求める
+ *
+ * @param shape 図形
+ * @param draws 描画する回数
+ * @return double 一回あたりの時間 (ミリ秒)
+ */
+double measure(const Shape& shape, int draws)
+{
+    // 最初の描画でドライバの準備を済ませておく
+    shape.draw();
+    glFinish();
+
+    const double start(glfwGetTime());
+    for (int i = 0; i < draws; ++i)
+    {
+        shape.draw();
+    }
+    glFinish();
+    return (glfwGetTime() - start) * 1000.0 / draws;
+}
+
+/**
+ * 同じ球を三角形とプリミティブの再開で区切った三角形ストリップで描画して比べる
+ *
+ * usage: DrawBenchmark [slices] [draws]
+ */
+int main(int argc, char* argv[])
+{
+    const int slices(argc > 1 ? std::max(std::atoi(argv[1]), 4) : 256);
+    const int draws(argc > 2 ? std::max(std::atoi(argv[2]), 1) : 200);
+
+    if (glfwInit() == GL_FALSE)
+    {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+
+    atexit(glfwTerminate);
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+    Window window(64, 64, "DrawBenchmark");
+
+    // 垂直同期を待たない
+    glfwSwapInterval(0);
+
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+    const GLuint program(createProgram(vsrc, fsrc));
+    if (program == 0)
+        return 1;
+    glUseProgram(program);
+
+    // 継ぎ目の頂点をまとめた球
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    createSphere(slices, slices / 2, vertex, index);
+    const VertexWelder welded(static_cast<GLsizei>(vertex.size()),
+                              vertex.data(),
+                              static_cast<GLsizei>(index.size()),
+                              index.data(),
+                              1.0e-5f);
+    const Stripifier strips(welded.getIndexCount(), welded.getIndex());
+
+    const SolidShapeIndex triangles(3, welded);
+    const SolidShapeStrip strip(3, welded.getVertexCount(), welded.getVertex(), strips);
+
+    const double trianglesTime(measure(triangles, draws));
+    const double stripTime(measure(strip, draws));
+
+    const GLsizei before(welded.getIndexCount()), after(strips.getIndexCount());
+    std::cout << "sphere " << slices << "x" << slices / 2 << ": " << before / 3 << " triangles, "
+              << welded.getVertexCount() << " vertices" << std::endl;
+    std::cout << "indices: triangles " << before << ", strips " << after << " ("
+              << strips.getStrips() << " strips), " << 100.0 * after / before << "%"
+              << std::endl;
+    std::cout << "draw time: triangles " << trianglesTime << " ms, strips " << stripTime
+              << " ms" << std::endl;
+
+    deleteProgram(program);
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "InputEvent.h"
+#include "RingBuffer.h"
+
+/** Window と同じ大きさの入力イベントのキュー */
+using EventQueue = RingBuffer<InputEvent, 1024>;
+
+/** 計測結果 */
+struct Result
+{
+    /** 書き込んだイベントの数 */
+    long long pushed;
+    /** 読み出したイベントの数 */
+    long long received;
+    /** 満杯で書き込めなかったイベントの数 */
+    long long dropped;
+    /** 順番が入れ替わったイベントの数 */
+    long long disordered;
+    /** 経過時間 */
+    double elapsed;
+};
+
+/**
+ * @brief 一つのスレッドがイベントを書き込み、別のスレッドが読み出す
+ *
+ * @param count 書き込むイベントの数
+ * @param rate 一秒あたりに書き込むイベントの数 (0 なら制限しない)
+ * @param drain 読み出す間隔 (0 なら待たずに読み出し続ける)
+ * @param retry 満杯なら空くまで待つ (false なら GLFW のコールバックと同じく捨てる)
+ */
+Result run(long long count, double rate, double drain, bool retry)
+{
+    EventQueue* const queue(new EventQueue);
+    std::atomic<bool> done(false);
+    Result result {0, 0, 0, 0, 0.0};
+
+    // シミュレーションのスレッドの代わりにイベントを読み出す
+    std::thread consumer([&]() {
+        long long expected(0);
+        InputEvent event;
+        for (;;)
+        {
+            const bool finished(done.load(std::memory_order_acquire));
+            while (queue->pop(event))
+            {
+                const long long sequence(event.key);
+                if (sequence < expected)
+                    ++result.disordered;
+                expected = sequence + 1;
+                ++result.received;
+            }
+            if (finished)
+                break;
+            if (drain > 0.0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(drain));
+            else
+                std::this_thread::yield();
+        }
+    });
+
+    const auto start(std::chrono::steady_clock::now());
+    for (long long i = 0; i < count; ++i)
+    {
+        if (rate > 0.0)
+        {
+            const auto due(start + std::chrono::duration<double>(static_cast<double>(i) / rate));
+            while (std::chrono::steady_clock::now() < due)
+            {
+            }
+        }
+        const InputEvent event {
+            InputEvent::Type::CursorPos, static_cast<int>(i), 0, 0.0, 0.0, 0.0};
+        while (!queue->push(event) && retry)
+        {
+            std::this_thread::yield();
+        }
+        ++result.pushed;
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    const auto end(std::chrono::steady_clock::now());
+    result.elapsed = std::chrono::duration<double>(end - start).count();
+    result.dropped = retry ? 0 : static_cast<long long>(queue->getDropped());
+    delete queue;
+
+    return result;
+}
+
+/** 計測結果を出力する */
+void print(const char* name, const Result& r)
+{
+    // 満杯で捨てたもの以外に失われたイベントがないか
+    const long long lost(r.pushed - r.dropped - r.received);
+    std::cout << name << ": " << r.received / r.elapsed / 1.0e6 << " M events/s, pushed "
+              << r.pushed << ", received " << r.received << ", dropped " << r.dropped
+              << ", lost " << lost << ", out of order " << r.disordered << std::endl;
+}
+
+/**
+ * 入力イベントのキューの処理能力と、イベントが失われないことを確かめる
+ *
+ * usage: InputBenchmark [events]
+ */
+int main(int argc, char* argv[])
+{
+    const long long count(argc > 1 ? std::atoll(argv[1]) : 10000000);
+
+    // 読み出す側が待たずに処理するときの最大の処理能力
+    print("saturated", run(count, 0.0, 0.0, true));
+
+    // 8kHz のマウスを四つ同時に動かしたくらいの入力を 60Hz の更新で読み出す
+    print("32kHz input, 60Hz drain", run(32000, 32000.0, 1.0 / 60.0, false));
+
+    return 0;
+}
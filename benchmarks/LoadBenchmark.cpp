@@ -0,0 +1,229 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "AssetLoader.h"
+#include "FrameStats.h"
+#include "Shader.h"
+#include "SolidShapeIndex.h"
+#include "Sphere.h"
+#include "Window.h"
+
+/** フレームバッファの大きさ */
+constexpr GLsizei size(128);
+
+/** 頂点を変換するだけのバーテックスシェーダ */
+static const char* const vsrc =
+    "#version 150 core\n"
+    "in vec4 position;\n"
+    "in vec3 normal;\n"
+    "void main() { gl_Position = vec4(position.xyz * 0.9, 1.0); }\n";
+
+/** 単色で塗りつぶすフラグメントシェーダ */
+static const char* const fsrc =
+    "#version 150 core\n"
+    "out vec4 fragment;\n"
+    "void main() { fragment = vec4(1.0); }\n";
+
+/**
+ * @brief 球の図形を作る (呼び出したスレッドのコンテキストに転送する)
+ *
+ * @param slices 経度方向の分割数
+ * @return std::shared_ptr<const Shape>
+ */
+std::shared_ptr<const Shape> createSphereShape(int slices)
+{
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    createSphere(slices, slices / 2, vertex, index);
+    const VertexWelder welded(static_cast<GLsizei>(vertex.size()),
+                              vertex.data(),
+                              static_cast<GLsizei>(index.size()),
+                              index.data(),
+                              1.0e-5f);
+    return std::make_shared<const SolidShapeIndex>(3, welded);
+}
+
+/**
+ * @brief 一フレームを描画して完了まで待つ
+ *
+ * @param base 常に描画する図形
+ * @param assets 読み込みを終えた図形
+ */
+void drawFrame(const Shape& base, const std::vector<std::shared_ptr<const Shape>>& assets)
+{
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    base.draw();
+    for (const std::shared_ptr<const Shape>& shape : assets)
+    {
+        shape->draw();
+    }
+    glFinish();
+}
+
+/**
+ * @brief 図形だけを描いて塗られた画素を数える
+ *
+ * @param shape 図形
+ * @return int 塗られた画素の数
+ */
+int countPixels(const Shape& shape)
+{
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    shape.draw();
+    std::vector<unsigned char> pixels(size * size * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    int count(0);
+    for (std::size_t i = 0; i < pixels.size(); i += 4)
+    {
+        if (pixels[i] != 0)
+            ++count;
+    }
+    return count;
+}
+
+/**
+ * 細かい球を描画のループの中で作る場合と、共有したコンテキストを持つスレッドで作る場合の
+ * フレーム時間を比べ、別のスレッドで作った図形が描画のコンテキストで描けることを確かめる
+ *
+ * usage: LoadBenchmark [assets] [slices]
+ */
+int main(int argc, char* argv[])
+{
+    const int count(argc > 1 ? std::max(std::atoi(argv[1]), 1) : 8);
+    const int slices(argc > 2 ? std::max(std::atoi(argv[2]), 4) : 512);
+
+    if (glfwInit() == GL_FALSE)
+    {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+
+    atexit(glfwTerminate);
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+    Window window(64, 64, "LoadBenchmark");
+    glfwSwapInterval(0);
+
+    // ウィンドウの大きさによらずフレームバッファオブジェクトに描く
+    GLuint fbo, renderbuffers[2];
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    glViewport(0, 0, size, size);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+    const GLuint program(createProgram(vsrc, fsrc));
+    if (program == 0)
+        return 1;
+    glUseProgram(program);
+
+    const std::shared_ptr<const Shape> base(createSphereShape(32));
+
+    // 描画のループの中で作る (一定のフレームごとに一つ)
+    FrameStats blocking("blocking", 4096);
+    {
+        std::vector<std::shared_ptr<const Shape>> assets;
+        for (int frame = 0; static_cast<int>(assets.size()) < count; ++frame)
+        {
+            const double start(glfwGetTime());
+            if (frame % 4 == 0)
+                assets.push_back(createSphereShape(slices));
+            drawFrame(*base, assets);
+            blocking.add(glfwGetTime() - start);
+        }
+    }
+
+    // 共有したコンテキストを持つスレッドで作る
+    FrameStats background("background", 4096);
+    int failures(0);
+    {
+        AssetLoader loader(window.createSharedContext());
+        if (!loader)
+        {
+            std::cerr << "Can't create a shared context" << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            loader.load("sphere", [slices]() { return createSphereShape(slices); });
+        }
+
+        std::vector<std::shared_ptr<const Shape>> assets;
+        unsigned long previous(0);
+        double loading(0.0);
+        while (previous < static_cast<unsigned long>(count))
+        {
+            const double start(glfwGetTime());
+            AssetLoader::Asset asset;
+            while (loader.poll(asset))
+            {
+                // 依頼した順に届く
+                if (!asset.shape || asset.ticket != previous + 1)
+                {
+                    std::cerr << "FAIL: asset " << asset.ticket << " after " << previous
+                              << (asset.shape ? "" : " has no shape") << std::endl;
+                    ++failures;
+                }
+                previous = asset.ticket;
+                loading += asset.seconds;
+                if (asset.shape)
+                    assets.push_back(asset.shape);
+            }
+            drawFrame(*base, assets);
+            background.add(glfwGetTime() - start);
+        }
+        std::cout << "loader thread: " << loading * 1000.0 / count << " ms per sphere"
+                  << std::endl;
+
+        // 別のスレッドで転送した図形もこのコンテキストで同じように描ける
+        const int expected(countPixels(*base));
+        for (const std::shared_ptr<const Shape>& shape : assets)
+        {
+            const int pixels(countPixels(*shape));
+            if (expected == 0 || std::abs(pixels - expected) > expected / 100)
+            {
+                std::cerr << "FAIL: loaded sphere covers " << pixels << " pixels, expected "
+                          << expected << std::endl;
+                ++failures;
+            }
+        }
+        if (loader.getPending() != 0)
+        {
+            std::cerr << "FAIL: " << loader.getPending() << " requests pending" << std::endl;
+            ++failures;
+        }
+
+        // 受け取った図形はこのコンテキストで破棄する
+        assets.clear();
+    }
+
+    std::cout << count << " spheres " << slices << "x" << slices / 2 << std::endl;
+    blocking.print();
+    background.print();
+    std::cout << "verify: " << (failures == 0 ? "ok" : "failed") << std::endl;
+
+    deleteProgram(program);
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &fbo);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Image.h"
+#include "Matrix.h"
+#include "ParticleSystem.h"
+#include "Window.h"
+
+/** 画像の大きさ */
+constexpr int width(640), height(480);
+
+/** 時間刻み */
+constexpr GLfloat dt(1.0f / 60.0f);
+
+/** 寿命の残っている粒子の数を数える */
+std::size_t countAlive(const std::vector<ParticleSystem::Particle>& particles)
+{
+    return std::count_if(particles.begin(),
+                         particles.end(),
+                         [](const ParticleSystem::Particle& p) { return p.position[3] > 0.0f; });
+}
+
+/**
+ * @brief 乱数を使わない放出で、GPU で進めた粒子を CPU で進めたものと比べる
+ *
+ * @return int 失敗した確認の数
+ */
+int verify()
+{
+    ParticleSystem particles(4096);
+    if (!particles)
+        return 1;
+    particles.setGravity(0.0f, -9.8f, 0.0f);
+    particles.setGround(-1.0f, 0.5f);
+
+    // 同じ初速度の粒子を 1000 個放出して 90 回進める
+    ParticleSystem::Emitter emitter = {
+        {0.0f, 0.0f, 0.0f}, {1.0f, 4.0f, 0.5f}, 0.0f, 0.0f, 2.0f, 0.0f};
+    particles.burst(emitter, 1000);
+    particles.update(dt);
+    const int steps(90);
+    for (int i = 0; i < steps; ++i)
+    {
+        particles.update(dt);
+    }
+
+    // 同じ順序で CPU で進める
+    GLfloat p[4] = {0.0f, 0.0f, 0.0f, 2.0f}, v[3] = {1.0f, 4.0f, 0.5f};
+    for (int i = 0; i < steps; ++i)
+    {
+        v[1] += -9.8f * dt;
+        for (int k = 0; k < 3; ++k)
+        {
+            p[k] += v[k] * dt;
+        }
+        p[3] -= dt;
+        if (p[1] < -1.0f && v[1] < 0.0f)
+        {
+            p[1] = -1.0f;
+            v[1] = -v[1] * 0.5f;
+        }
+    }
+
+    int failures(0);
+    std::vector<ParticleSystem::Particle> result;
+    particles.read(result);
+    if (countAlive(result) != 1000)
+    {
+        std::cerr << "FAIL: " << countAlive(result) << " particles alive, expected 1000"
+                  << std::endl;
+        ++failures;
+    }
+    GLfloat error(0.0f);
+    for (int i = 0; i < 1000; ++i)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            error = std::max(error, std::abs(result[i].position[k] - p[k]));
+        }
+    }
+    if (!(error < 1.0e-3f))
+    {
+        std::cerr << "FAIL: particle position differs from the CPU by " << error << std::endl;
+        ++failures;
+    }
+
+    // 寿命が尽きれば全て消える
+    for (int i = 0; i < 40; ++i)
+    {
+        particles.update(dt);
+    }
+    particles.read(result);
+    if (countAlive(result) != 0)
+    {
+        std::cerr << "FAIL: " << countAlive(result) << " particles alive after their life"
+                  << std::endl;
+        ++failures;
+    }
+
+    // 環状の並びの終わりをまたいで放出しても数は変わらず、乱数で速度がばらつく
+    emitter.spread = 1.0f;
+    particles.burst(emitter, 3000);
+    particles.burst(emitter, 3000);
+    particles.update(dt);
+    particles.read(result);
+    GLfloat low(result[0].velocity[0]), high(low);
+    for (const ParticleSystem::Particle& q : result)
+    {
+        low  = std::min(low, q.velocity[0]);
+        high = std::max(high, q.velocity[0]);
+    }
+    if (countAlive(result) != 4096 || particles.getEmitted() != 7000 || !(high - low > 1.5f))
+    {
+        std::cerr << "FAIL: wrapped emission: alive " << countAlive(result) << ", emitted "
+                  << particles.getEmitted() << ", velocity range " << high - low << std::endl;
+        ++failures;
+    }
+
+    std::cout << "verify: " << (failures == 0 ? "ok" : "failed") << std::endl;
+    return failures;
+}
+
+/**
+ * 粒子を GPU だけで進めて描画する時間を計る
+ *
+ * usage: ParticleBenchmark [particles] [frames] [prefix]
+ *   prefix を指定すると最後のフレームを prefix.png に書き出す
+ */
+int main(int argc, char* argv[])
+{
+    const GLsizei count(argc > 1 ? std::max(std::atoi(argv[1]), 1) : 1000000);
+    const int frames(argc > 2 ? std::max(std::atoi(argv[2]), 1) : 60);
+    const std::string prefix(argc > 3 ? argv[3] : "");
+
+    if (glfwInit() == GL_FALSE)
+    {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+
+    atexit(glfwTerminate);
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+    Window window(64, 64, "ParticleBenchmark");
+    glfwSwapInterval(0);
+
+    const int failures(verify());
+
+    // ウィンドウの大きさによらずフレームバッファオブジェクトに描く
+    GLuint fbo, renderbuffers[2];
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glEnable(GL_DEPTH_TEST);
+
+    // 寿命の間に全ての粒子を使い切る噴水
+    ParticleSystem particles(count);
+    if (!particles)
+        return 1;
+    particles.setGround(-1.0f, 0.4f);
+    ParticleSystem::Emitter fountain = {
+        {0.0f, -1.0f, 0.0f}, {0.0f, 5.0f, 0.0f}, 1.5f, count / 2.0f, 2.0f, 0.0f};
+
+    const Matrix projection(Matrix::perspective(0.8f, 4.0f / 3.0f, 1.0f, 30.0f));
+    const Matrix view(Matrix::lookAt(0.0f, 2.0f, 9.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+
+    // 全ての粒子が放出されるまで進めておく
+    for (int i = 0; i < 150; ++i)
+    {
+        particles.emit(fountain, dt);
+        particles.update(dt);
+    }
+    glFinish();
+
+    double update(0.0), draw(0.0);
+    for (int i = 0; i < frames; ++i)
+    {
+        const double t0(glfwGetTime());
+        particles.emit(fountain, dt);
+        particles.update(dt);
+        glFinish();
+        const double t1(glfwGetTime());
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        particles.draw(projection, view, height, 0.03f);
+        glFinish();
+        const double t2(glfwGetTime());
+        update += t1 - t0;
+        draw += t2 - t1;
+    }
+
+    std::vector<ParticleSystem::Particle> result;
+    particles.read(result);
+    std::cout << count << " particles, " << countAlive(result) << " alive, " << width << "x"
+              << height << std::endl;
+    std::cout << "update: " << update * 1000.0 / frames << " ms, draw: "
+              << draw * 1000.0 / frames << " ms" << std::endl;
+
+    if (!prefix.empty())
+    {
+        std::vector<unsigned char> pixels(width * height * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        Image::writePng(prefix + ".png", width, height, pixels.data());
+    }
+
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &fbo);
+
+    return failures == 0 ? 0 : 1;
+}
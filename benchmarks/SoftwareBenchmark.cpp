@@ -0,0 +1,277 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameArena.h"
+#include "Material.h"
+#include "MaterialTable.h"
+#include "Matrix.h"
+#include "Shader.h"
+#include "SoftwareRenderer.h"
+#include "SolidShapeIndex.h"
+#include "Sphere.h"
+#include "Vector.h"
+#include "VertexWelder.h"
+#include "Window.h"
+
+/** 画像の大きさ */
+constexpr int width(640), height(480);
+
+/** 光源の数 */
+constexpr int Lcount = 2;
+
+/** ビュー変換行列 */
+constexpr Matrix view(Matrix::lookAt(3.0f, 6.0f, 9.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+
+/** 視点座標系における光源の位置 */
+constexpr Vector Lpos[] = {view * Vector {0.0f, 0.0f, 5.0f, 1.0f},
+                           view * Vector {8.0f, 0.0f, 0.0f, 1.0f}};
+
+/** 光源の環境光成分 */
+constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
+
+/** 光源の拡散反射光成分 */
+constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+
+/** 光源の鏡面反射光成分 */
+constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+
+/** 材質 */
+constexpr Material color[] = {{0.6f, 0.6f, 0.2f, 0.6f, 0.6f, 0.2f, 0.3f, 0.3f, 0.3f, 30.0f},
+                              {0.1f, 0.1f, 0.5f, 0.1f, 0.1f, 0.5f, 0.4f, 0.4f, 0.4f, 60.0f}};
+
+/**
+ * 一つの球の描画
+ */
+struct Instance
+{
+    /** モデルビュー変換行列 */
+    Matrix modelView;
+    /** 法線ベクトルの変換行列 */
+    GLfloat normalMatrix[9];
+    /** 材質の番号 */
+    unsigned int material;
+};
+
+/**
+ * @brief 格子状に並べて少しずつ重ねた球の描画を作る
+ *
+ * @return std::vector<Instance>
+ */
+std::vector<Instance> createScene()
+{
+    std::vector<Instance> scene;
+    for (int j = -2; j <= 2; ++j)
+    {
+        for (int i = -2; i <= 2; ++i)
+        {
+            Instance instance;
+            instance.modelView = view * Matrix::translate(i * 1.6f, 0.0f, j * 1.6f)
+                                 * Matrix::rotate(0.3f * i, 0.0f, 1.0f, 0.0f);
+            instance.modelView.getNormalMatrix(instance.normalMatrix);
+            instance.material = (i + j) & 1;
+            scene.push_back(instance);
+        }
+    }
+    return scene;
+}
+
+/**
+ * @brief 二つの RGBA の画像を比べる
+ *
+ * @param a 一つ目の画像
+ * @param b 二つ目の画像
+ * @param tolerance 一致とみなす各成分の差の上限
+ * @return double 一致しなかった画素の割合
+ */
+double compare(const unsigned char* a, const unsigned char* b, int tolerance)
+{
+    int maximum(0), mismatched(0);
+    double sum(0.0);
+    for (int i = 0; i < width * height; ++i)
+    {
+        int d(0);
+        for (int k = 0; k < 3; ++k)
+        {
+            d = std::max(d, std::abs(a[i * 4 + k] - b[i * 4 + k]));
+        }
+        maximum = std::max(maximum, d);
+        mismatched += d > tolerance;
+        sum += d;
+    }
+    const double ratio(static_cast<double>(mismatched) / (width * height));
+    std::cout << "difference: max " << maximum << ", mean " << sum / (width * height)
+              << ", pixels over " << tolerance << ": " << mismatched << " (" << ratio * 100.0
+              << "%)" << std::endl;
+    return ratio;
+}
+
+/**
+ * 同じ場面を OpenGL と SoftwareRenderer で描いて画像と描画時間を比べる
+ *
+ * usage: SoftwareBenchmark [frames] [prefix]
+ *   prefix を指定すると prefix-gl.png と prefix-software.png を書き出す
+ */
+int main(int argc, char* argv[])
+{
+    const int frames(argc > 1 ? std::max(std::atoi(argv[1]), 1) : 20);
+    const std::string prefix(argc > 2 ? argv[2] : "");
+
+    if (glfwInit() == GL_FALSE)
+    {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+
+    atexit(glfwTerminate);
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+    Window window(64, 64, "SoftwareBenchmark");
+    glfwSwapInterval(0);
+
+    // ウィンドウの大きさによらずフレームバッファオブジェクトに描く
+    GLuint fbo, renderbuffers[2];
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(
+        GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    glViewport(0, 0, width, height);
+
+    glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    glFrontFace(GL_CCW);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
+    glClearDepth(1.0);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_DEPTH_TEST);
+
+    const GLuint program(loadProgram("resources/point.vert", "resources/point.frag"));
+    if (program == 0)
+        return 1;
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Material"), 0);
+    const GLint projectionLocation(glGetUniformLocation(program, "projection"));
+    const GLint modelViewLocation(glGetUniformLocation(program, "modelView"));
+    const GLint normalMatrixLocation(glGetUniformLocation(program, "normalMatrix"));
+
+    // 継ぎ目の頂点をまとめた球
+    std::vector<Object::Vertex> vertex;
+    std::vector<GLuint> index;
+    createSphere(64, 32, vertex, index);
+    const VertexWelder welded(static_cast<GLsizei>(vertex.size()),
+                              vertex.data(),
+                              static_cast<GLsizei>(index.size()),
+                              index.data(),
+                              1.0e-5f);
+    const SolidShapeIndex shape(3, welded);
+    MaterialTable material(color, 2);
+
+    const Matrix projection(Matrix::perspective(0.8f, 4.0f / 3.0f, 1.0f, 30.0f));
+    const std::vector<Instance> scene(createScene());
+
+    // OpenGL で描く
+    glUseProgram(program);
+    glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, projection.data());
+    glUniform1i(glGetUniformLocation(program, "Lcount"), Lcount);
+    glUniform4fv(glGetUniformLocation(program, "Lpos"), Lcount, Lpos[0].data());
+    glUniform3fv(glGetUniformLocation(program, "Lamb"), Lcount, Lamb);
+    glUniform3fv(glGetUniformLocation(program, "Ldiff"), Lcount, Ldiff);
+    glUniform3fv(glGetUniformLocation(program, "Lspec"), Lcount, Lspec);
+    const GLint materialIndexLocation(glGetUniformLocation(program, "materialIndex"));
+    const auto drawGl = [&]() {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        material.bind(0);
+        for (const Instance& instance : scene)
+        {
+            glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE, instance.modelView.data());
+            glUniformMatrix3fv(normalMatrixLocation, 1, GL_FALSE, instance.normalMatrix);
+            glUniform1i(materialIndexLocation, static_cast<GLint>(instance.material));
+            shape.draw();
+        }
+    };
+    drawGl();
+    std::vector<unsigned char> gl(width * height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, gl.data());
+
+    double start(glfwGetTime());
+    for (int i = 0; i < frames; ++i)
+    {
+        drawGl();
+    }
+    glFinish();
+    const double glTime((glfwGetTime() - start) * 1000.0 / frames);
+
+    // 同じ場面を CPU で描く
+    const SoftwareRenderer::Mesh mesh = {welded.getVertexCount(),
+                                         welded.getVertex(),
+                                         welded.getIndexCount(),
+                                         welded.getIndex(),
+                                         NULL};
+    const auto drawSoftware = [&](SoftwareRenderer& renderer) {
+        renderer.begin(projection, Lpos);
+        for (const Instance& instance : scene)
+        {
+            renderer.draw(mesh, 0, instance.material, instance.modelView, instance.normalMatrix);
+        }
+        renderer.finish();
+        FrameArena::local().reset();
+    };
+
+    SoftwareRenderer reference(width, height);
+    reference.setClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    reference.setMaterials(color, 2);
+    reference.setLights(Lcount, Lamb, Ldiff, Lspec);
+    drawSoftware(reference);
+
+    std::cout << scene.size() << " spheres, " << welded.getIndexCount() / 3
+              << " triangles each, " << width << "x" << height << std::endl;
+    const double ratio(compare(gl.data(), reference.getPixels(), 8));
+    if (!prefix.empty())
+    {
+        Image::writePng(prefix + "-gl.png", width, height, gl.data());
+        reference.write(prefix + "-software.png");
+    }
+
+    // スレッドの数を変えて描画時間を計る
+    std::cout << "OpenGL: " << glTime << " ms" << std::endl;
+    const unsigned int cores(std::max(std::thread::hardware_concurrency(), 1u));
+    for (unsigned int threads = 1; threads <= cores; threads *= 2)
+    {
+        SoftwareRenderer renderer(width, height, threads);
+        renderer.setClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+        renderer.setMaterials(color, 2);
+        renderer.setLights(Lcount, Lamb, Ldiff, Lspec);
+        drawSoftware(renderer);
+
+        start = glfwGetTime();
+        for (int i = 0; i < frames; ++i)
+        {
+            drawSoftware(renderer);
+        }
+        std::cout << "software " << threads << " threads: "
+                  << (glfwGetTime() - start) * 1000.0 / frames << " ms" << std::endl;
+    }
+
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &fbo);
+    deleteProgram(program);
+
+    // 輪郭の画素の扱いの違いを除けばほぼ一致するはず
+    return ratio < 0.01 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "Object.h"
+#include "Window.h"
+
+/** 頂点属性を読み出すだけのバーテックスシェーダ */
+static const char* const vsrc =
+    "#version 150 core\n"
+    "in vec4 position;\n"
+    "in vec3 normal;\n"
+    "void main() { gl_Position = position + vec4(normal, 0.0); }\n";
+
+/**
+ * @brief 頂点属性を読み出すだけのプログラムオブジェクトを作成する
+ *
+ * @return GLuint
+ */
+GLuint createStreamProgram()
+{
+    const GLuint program(glCreateProgram());
+    const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
+    glShaderSource(vobj, 1, &vsrc, NULL);
+    glCompileShader(vobj);
+    glAttachShader(program, vobj);
+    glDeleteShader(vobj);
+    glBindAttribLocation(program, 0, "position");
+    glBindAttribLocation(program, 1, "normal");
+    glLinkProgram(program);
+    return program;
+}
+
+/**
+ * 毎フレーム N MB の頂点属性を Object に書き込んで描画し、転送速度を求める
+ *
+ * usage: StreamBenchmark [MB/frame] [frames] [regions]
+ */
+int main(int argc, char* argv[])
+{
+    const double megabytes(argc > 1 ? std::atof(argv[1]) : 16.0);
+    const int frames(argc > 2 ? std::atoi(argv[2]) : 300);
+    const GLsizei regions(argc > 3 ? std::max(std::atoi(argv[3]), 2) : 3);
+
+    if (glfwInit() == GL_FALSE)
+    {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+
+    atexit(glfwTerminate);
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+    Window window(64, 64, "StreamBenchmark");
+
+    // 垂直同期を待たない
+    glfwSwapInterval(0);
+
+    // 頂点の処理だけを行う
+    glEnable(GL_RASTERIZER_DISCARD);
+    const GLuint program(createStreamProgram());
+    glUseProgram(program);
+
+    const GLsizei vertexcount(
+        static_cast<GLsizei>(megabytes * 1024.0 * 1024.0 / sizeof(Object::Vertex)));
+    std::vector<Object::Vertex> vertex(vertexcount, Object::Vertex {});
+    const Object object(3, vertexcount, vertex.data(), 0, NULL, regions);
+
+    glFinish();
+    const double start(glfwGetTime());
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        // 領域を書き換えてから描画する
+        Object::Vertex* const p(object.map());
+        if (p == NULL)
+        {
+            // glMapBufferRange() に失敗した
+            std::cerr << "Can't map the vertex buffer object at frame " << frame << std::endl;
+            glDeleteProgram(program);
+            return 1;
+        }
+        for (GLsizei i = 0; i < vertexcount; ++i)
+        {
+            p[i] = vertex[i];
+            p[i].position[0] = static_cast<GLfloat>(frame);
+        }
+        object.unmap();
+
+        object.bind();
+        glDrawArrays(GL_POINTS, 0, vertexcount);
+        object.fence();
+        glFlush();
+    }
+    glFinish();
+    const double elapsed(glfwGetTime() - start);
+
+    std::cout << "mode: " << (GLEW_ARB_buffer_storage ? "persistent" : "unsynchronized")
+              << ", regions: " << object.getRegions() << std::endl;
+    std::cout << "streamed " << megabytes << " MB/frame x " << frames << " frames in "
+              << elapsed << " s" << std::endl;
+    std::cout << "throughput: " << megabytes * frames / elapsed << " MB/s, "
+              << frames / elapsed << " frames/s, stalls: " << object.getStalls() << std::endl;
+
+    glDeleteProgram(program);
+    return 0;
+}
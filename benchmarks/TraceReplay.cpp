@@ -0,0 +1,121 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "FrameStats.h"
+#include "GlReplay.h"
+#include "Image.h"
+#include "Window.h"
+
+/**
+ * GlTrace で記録した OpenGL の命令をウィンドウを表示せずにできるだけ速く再生し、
+ * 命令ごとの CPU の時間とフレームごとの時間を表示する
+ *
+ * usage: TraceReplay <trace> [repeat] [prefix]
+ *   記録したフレームを repeat 回繰り返して再生する
+ *   prefix を指定すると最後のフレームを prefix.png に書き出す
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace> [repeat] [prefix]" << std::endl;
+        return 1;
+    }
+    const std::string name(argv[1]);
+    const int repeat(argc > 2 ? std::max(std::atoi(argv[2]), 1) : 1);
+    const std::string prefix(argc > 3 ? argv[3] : "");
+
+    if (glfwInit() == GL_FALSE)
+    {
+        std::cerr << "Failed to initialize GLFW" << std::endl;
+        return 1;
+    }
+
+    atexit(glfwTerminate);
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+    Window window(64, 64, "TraceReplay");
+    glfwSwapInterval(0);
+
+    int result(0);
+    {
+        GlReplay replay(name);
+        if (!replay || replay.getFrames() == 0)
+        {
+            std::cerr << name << ": no frames to replay" << std::endl;
+            return 1;
+        }
+
+        // 記録したビューポートの大きさのフレームバッファオブジェクトに描く
+        const GLsizei width(std::max(replay.getWidth(), 1));
+        const GLsizei height(std::max(replay.getHeight(), 1));
+        GLuint fbo, renderbuffers[2];
+        glGenFramebuffers(1, &fbo);
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+        // 記録を始めたフレームまでの資源と状態を作る
+        const double t0(glfwGetTime());
+        replay.setup();
+        glFinish();
+        const double setup(glfwGetTime() - t0);
+        replay.resetStats();
+
+        // 記録したフレームを繰り返し再生する
+        FrameStats frameTime("frame", 4096);
+        const double t1(glfwGetTime());
+        for (int r = 0; r < repeat; ++r)
+        {
+            for (std::size_t f = 0; f < replay.getFrames(); ++f)
+            {
+                const double start(glfwGetTime());
+                replay.play(f);
+                glFinish();
+                frameTime.add(glfwGetTime() - start);
+            }
+        }
+        const double elapsed(glfwGetTime() - t1);
+        const std::size_t frames(replay.getFrames() * repeat);
+
+        std::cout << name << ": " << replay.getFrames() << " frames from frame "
+                  << replay.getFirst() << ", " << width << "x" << height << ", setup "
+                  << setup * 1000.0 << "ms" << std::endl;
+        std::cout << "replayed " << frames << " frames in " << elapsed << "s ("
+                  << frames / elapsed << " frames/s)" << std::endl;
+        frameTime.print();
+        std::cout << "calls (CPU time):" << std::endl;
+        replay.print();
+
+        if (!prefix.empty())
+        {
+            std::vector<unsigned char> pixels(width * height * 4);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            if (!Image::writePng(prefix + ".png", width, height, pixels.data()))
+                result = 1;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(2, renderbuffers);
+        glDeleteFramebuffers(1, &fbo);
+    }
+
+    return result;
+}
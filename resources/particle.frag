@@ -0,0 +1,15 @@
+#version 150 core
+in float fade;
+out vec4 fragment;
+
+void main()
+{
+    // 点を円にして中心ほど明るくする
+    vec2 d = gl_PointCoord * 2.0 - 1.0;
+    float r = dot(d, d);
+    if (r > 1.0)
+        discard;
+    vec3 hot = vec3(1.0, 0.85, 0.3);
+    vec3 cold = vec3(0.8, 0.15, 0.0);
+    fragment = vec4(mix(cold, hot, fade), (1.0 - r) * fade);
+}
@@ -0,0 +1,17 @@
+#version 150 core
+uniform mat4 modelView;
+uniform mat4 projection;
+uniform float pointScale;
+in vec4 position;
+in vec4 velocity;
+out float fade;
+
+void main()
+{
+    vec4 P = modelView * vec4(position.xyz, 1.0);
+    fade = velocity.w > 0.0 ? clamp(position.w / velocity.w, 0.0, 1.0) : 0.0;
+
+    // 寿命の尽きた粒子は視野の外に置く
+    gl_Position = position.w > 0.0 ? projection * P : vec4(0.0, 0.0, 2.0, 1.0);
+    gl_PointSize = max(pointScale / max(-P.z, 0.001), 1.0);
+}
@@ -0,0 +1,65 @@
+#version 150 core
+const int maxBatches = 16;
+uniform float dt;
+uniform vec3 gravity;
+uniform vec2 ground;
+uniform uint seed;
+uniform int batches;
+uniform int emitFirst[maxBatches];
+uniform int emitCount[maxBatches];
+uniform vec4 emitPosition[maxBatches];
+uniform vec4 emitVelocity[maxBatches];
+in vec4 position;
+in vec4 velocity;
+out vec4 outPosition;
+out vec4 outVelocity;
+
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float random(inout uint state)
+{
+    state = hash(state);
+    return float(state >> 8) * (1.0 / 16777216.0);
+}
+
+void main()
+{
+    vec4 p = position;
+    vec4 v = velocity;
+
+    // 寿命が残っていれば進めて、地面より下に行けば跳ね返す
+    if (p.w > 0.0)
+    {
+        v.xyz += gravity * dt;
+        p.xyz += v.xyz * dt;
+        p.w -= dt;
+        if (p.y < ground.x && v.y < 0.0)
+        {
+            p.y = ground.x;
+            v.y = -v.y * ground.y;
+        }
+    }
+
+    // 放出の範囲に入っていれば新しい粒子にする
+    for (int i = 0; i < batches; ++i)
+    {
+        if (gl_VertexID >= emitFirst[i] && gl_VertexID < emitFirst[i] + emitCount[i])
+        {
+            uint state = hash(uint(gl_VertexID) ^ hash(seed));
+            vec3 r = vec3(random(state), random(state), random(state)) * 2.0 - 1.0;
+            p = vec4(emitPosition[i].xyz, emitPosition[i].w);
+            v = vec4(emitVelocity[i].xyz + r * emitVelocity[i].w, emitPosition[i].w);
+        }
+    }
+
+    outPosition = p;
+    outVelocity = v;
+}
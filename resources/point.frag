@@ -1,22 +1,49 @@
 #version 150 core
-const int Lcount = 2;
-uniform vec4 Lpos[Lcount];
-uniform vec3 Lamb[Lcount];
-uniform vec3 Ldiff[Lcount];
-uniform vec3 Lspec[Lcount];
+const int maxLights = 8;
+uniform int Lcount;
+uniform vec4 Lpos[maxLights];
+uniform vec3 Lamb[maxLights];
+uniform vec3 Ldiff[maxLights];
+uniform vec3 Lspec[maxLights];
+struct MaterialData
+{
+    vec3 Kamb;
+    vec3 Kdiff;
+    vec3 Kspec;
+    float Kshi;
+};
+#ifdef MATERIAL_TEXTURE
+// 材質ごとに RGBA32F の 3 画素 (Kamb, Kdiff, Kspec と Kshi) を並べたバッファテクスチャ
+uniform samplerBuffer materialTexture;
+MaterialData getMaterial(int i)
+{
+    vec4 spec = texelFetch(materialTexture, i * 3 + 2);
+    return MaterialData(texelFetch(materialTexture, i * 3).rgb,
+                        texelFetch(materialTexture, i * 3 + 1).rgb,
+                        spec.rgb, spec.a);
+}
+#else
 layout (std140) uniform Material
 {
- vec3 Kamb;
- vec3 Kdiff;
- vec3 Kspec;
- float Kshi;
+    MaterialData materials[256];
 };
+MaterialData getMaterial(int i)
+{
+    return materials[i];
+}
+#endif
+uniform int materialIndex;
 in vec4 P;
 in vec3 N;
 out vec4 fragment;
 
 void main()
 {
+    MaterialData material = getMaterial(materialIndex);
+    vec3 Kamb = material.Kamb;
+    vec3 Kdiff = material.Kdiff;
+    vec3 Kspec = material.Kspec;
+    float Kshi = material.Kshi;
     vec3 V = -normalize(P.xyz);
     vec3 Idiff = vec3(0.0);
     vec3 Ispec = vec3(0.0);
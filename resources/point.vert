@@ -2,17 +2,39 @@
 uniform mat4 modelView;
 uniform mat4 projection;
 uniform mat3 normalMatrix;
-const int Lcount = 2;
-uniform vec4 Lpos[Lcount];
-uniform vec3 Lamb[Lcount];
-uniform vec3 Ldiff[Lcount];
-layout (std140) uniform Material
+const int maxLights = 8;
+uniform int Lcount;
+uniform vec4 Lpos[maxLights];
+uniform vec3 Lamb[maxLights];
+uniform vec3 Ldiff[maxLights];
+struct MaterialData
 {
     vec3 Kamb;
     vec3 Kdiff;
     vec3 Kspec;
     float Kshi;
 };
+#ifdef MATERIAL_TEXTURE
+// 材質ごとに RGBA32F の 3 画素 (Kamb, Kdiff, Kspec と Kshi) を並べたバッファテクスチャ
+uniform samplerBuffer materialTexture;
+MaterialData getMaterial(int i)
+{
+    vec4 spec = texelFetch(materialTexture, i * 3 + 2);
+    return MaterialData(texelFetch(materialTexture, i * 3).rgb,
+                        texelFetch(materialTexture, i * 3 + 1).rgb,
+                        spec.rgb, spec.a);
+}
+#else
+layout (std140) uniform Material
+{
+    MaterialData materials[256];
+};
+MaterialData getMaterial(int i)
+{
+    return materials[i];
+}
+#endif
+uniform int materialIndex;
 in vec4 position;
 in vec3 normal;
 out vec3 Idiff;
@@ -21,6 +43,9 @@ out vec3 N;
 
 void main()
 {
+    MaterialData material = getMaterial(materialIndex);
+    vec3 Kamb = material.Kamb;
+    vec3 Kdiff = material.Kdiff;
     P = modelView * position;
     N = normalize(normalMatrix * normal);
     Idiff = vec3(0.0);
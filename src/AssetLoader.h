@@ -0,0 +1,313 @@
+#pragma once
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ObjFile.h"
+#include "Shape.h"
+#include "SolidShapeIndex.h"
+#include "VertexWelder.h"
+
+/**
+ * 図形を別のスレッドで読み込むクラス
+ *
+ * 描画のコンテキストとオブジェクトを共有するコンテキストを読み込みのスレッドが持ち、
+ * ファイルの読み込み、解析、バッファオブジェクトへの転送をそのスレッドで行う。
+ * 転送を終えた図形にはフェンスを置いて渡し、描画のスレッドは poll() で
+ * フェンスが通過した図形だけを待たずに受け取るので、読み込みの間もフレームが止まらない。
+ * 頂点配列オブジェクトは共有できないので、受け取った図形は描画のコンテキストで
+ * 最初に描画したときに頂点配列オブジェクトを作る (Object を参照)。
+ */
+class AssetLoader
+{
+public:
+    /**
+     * 図形を作る関数 (読み込みのスレッドのコンテキストで呼び出す、失敗したら空を返す)
+     */
+    using Builder = std::function<std::shared_ptr<const Shape>()>;
+
+    /**
+     * 読み込みを終えた図形
+     */
+    struct Asset
+    {
+        /** load() が返した番号 */
+        unsigned long ticket;
+        /** 名前 */
+        std::string name;
+        /** 図形 (読み込めなければ空) */
+        std::shared_ptr<const Shape> shape;
+        /** 読み込みのスレッドで図形の作成にかかった時間 (秒) */
+        double seconds;
+    };
+
+private:
+    /**
+     * 読み込みの依頼
+     */
+    struct Request
+    {
+        /** 番号 */
+        unsigned long ticket;
+        /** 名前 */
+        std::string name;
+        /** 図形を作る関数 */
+        Builder builder;
+    };
+
+    /**
+     * 転送を終えた図形
+     */
+    struct Upload
+    {
+        /** 読み込みを終えた図形 */
+        Asset asset;
+        /** 転送の完了を待つフェンス (図形がなければ 0) */
+        GLsync fence;
+    };
+
+    /** 描画のコンテキストとオブジェクトを共有するコンテキストを持つウィンドウ */
+    GLFWwindow* const context;
+
+    /** 以下の変数を保護する */
+    std::mutex mutex;
+
+    /** 依頼を追加したときと終了するときに通知する */
+    std::condition_variable wake;
+
+    /** まだ読み込んでいない依頼 */
+    std::deque<Request> requests;
+
+    /** 転送を終えてまだ受け取られていない図形 */
+    std::deque<Upload> uploads;
+
+    /** 次の依頼の番号 */
+    unsigned long next;
+
+    /** 受け取られていない依頼の数 */
+    std::size_t pending;
+
+    /** 終了する */
+    bool stop;
+
+    /** 読み込みのスレッド */
+    std::thread worker;
+
+public:
+    /**
+     * @brief Construct a new AssetLoader object
+     *
+     * @param context 描画のコンテキストと共有するコンテキストを持つウィンドウ
+     *                (Window::createSharedContext() で作ったもの、このオブジェクトが破棄する)
+     */
+    explicit AssetLoader(GLFWwindow* context) :
+        context(context), next(1), pending(0), stop(false)
+    {
+        if (context != NULL)
+            worker = std::thread(&AssetLoader::work, this);
+    }
+
+    /** 読み込みのスレッドを止めてコンテキストを破棄する (メインスレッドで破棄すること) */
+    virtual ~AssetLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        if (worker.joinable())
+            worker.join();
+        if (context != NULL)
+            glfwDestroyWindow(context);
+    }
+
+    /** 読み込みのスレッドが動いているかを返す */
+    explicit operator bool() const
+    {
+        return context != NULL;
+    }
+
+    /**
+     * @brief 図形の読み込みを依頼する
+     *
+     * @param name 名前
+     * @param builder 読み込みのスレッドで図形を作る関数
+     * @return unsigned long 依頼の番号 (読み込みのスレッドがなければ 0)
+     */
+    unsigned long load(const std::string& name, const Builder& builder)
+    {
+        if (context == NULL)
+            return 0;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const unsigned long ticket(next++);
+        requests.push_back({ticket, name, builder});
+        ++pending;
+        wake.notify_one();
+        return ticket;
+    }
+
+    /**
+     * @brief OBJ 形式のファイルの読み込みを依頼する
+     *
+     * 重複する頂点をまとめ、原点を中心とする半径 1 の球に収まるように大きさを揃える。
+     *
+     * @param name ファイル名
+     * @return unsigned long 依頼の番号 (読み込みのスレッドがなければ 0)
+     */
+    unsigned long loadObj(const std::string& name)
+    {
+        return load(name, [name]() { return createObjShape(name); });
+    }
+
+    /**
+     * @brief 転送を終えた図形を一つ受け取る (描画のスレッドから呼び出す)
+     *
+     * フェンスが通過していなければ待たずに戻る。
+     *
+     * @param asset 受け取った図形の格納先
+     * @return true 受け取った
+     * @return false 受け取れる図形がない
+     */
+    bool poll(Asset& asset)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (uploads.empty())
+            return false;
+
+        // 依頼した順に受け取る
+        Upload& upload(uploads.front());
+        if (upload.fence != 0)
+        {
+            if (glClientWaitSync(upload.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                return false;
+
+            glDeleteSync(upload.fence);
+        }
+
+        asset = std::move(upload.asset);
+        uploads.pop_front();
+        --pending;
+        return true;
+    }
+
+    /** 受け取られていない依頼の数を返す */
+    std::size_t getPending()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pending;
+    }
+
+    /**
+     * @brief OBJ 形式のファイルから図形を作る (コンテキストを持つスレッドで呼び出す)
+     *
+     * @param name ファイル名
+     * @return std::shared_ptr<const Shape> 図形 (読み込めなければ空)
+     */
+    static std::shared_ptr<const Shape> createObjShape(const std::string& name)
+    {
+        std::vector<Object::Vertex> vertex;
+        if (!::loadObj(name, vertex) || vertex.empty())
+            return std::shared_ptr<const Shape>();
+
+        // 境界箱の中心を原点に移して半径 1 の球に収める
+        GLfloat low[3], high[3];
+        for (int e = 0; e < 3; ++e)
+        {
+            low[e] = high[e] = vertex[0].position[e];
+        }
+        for (const Object::Vertex& v : vertex)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                low[e]  = std::min(low[e], v.position[e]);
+                high[e] = std::max(high[e], v.position[e]);
+            }
+        }
+        const GLfloat center[] = {
+            (low[0] + high[0]) * 0.5f, (low[1] + high[1]) * 0.5f, (low[2] + high[2]) * 0.5f};
+        GLfloat radius(0.0f);
+        for (const Object::Vertex& v : vertex)
+        {
+            const GLfloat d[] = {
+                v.position[0] - center[0], v.position[1] - center[1], v.position[2] - center[2]};
+            radius = std::max(radius, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        }
+        const GLfloat scale(radius > 0.0f ? 1.0f / std::sqrt(radius) : 1.0f);
+        for (Object::Vertex& v : vertex)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                v.position[e] = (v.position[e] - center[e]) * scale;
+            }
+        }
+
+        const VertexWelder welded(static_cast<GLsizei>(vertex.size()), vertex.data());
+        return std::make_shared<const SolidShapeIndex>(3, welded);
+    }
+
+private:
+    /** 読み込みのスレッド */
+    void work()
+    {
+        glfwMakeContextCurrent(context);
+
+        for (;;)
+        {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stop || !requests.empty(); });
+                if (stop)
+                    break;
+
+                request = std::move(requests.front());
+                requests.pop_front();
+            }
+
+            // 図形を作ってバッファオブジェクトに転送する
+            const double start(glfwGetTime());
+            std::shared_ptr<const Shape> shape(request.builder());
+            const double seconds(glfwGetTime() - start);
+
+            // 転送の完了を待つフェンスを置き、他のコンテキストから見えるように送り出す
+            GLsync fence(0);
+            if (shape)
+            {
+                fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                glFlush();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            uploads.push_back({{request.ticket, request.name, shape, seconds}, fence});
+        }
+
+        // 受け取られなかった図形はこのコンテキストで破棄する
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (Upload& upload : uploads)
+            {
+                glDeleteSync(upload.fence);
+            }
+            uploads.clear();
+            requests.clear();
+        }
+        glFinish();
+
+        glfwMakeContextCurrent(NULL);
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    AssetLoader(const AssetLoader& a);
+
+    /** 代入によるコピー禁止 */
+    AssetLoader& operator=(const AssetLoader& a);
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+#include "Object.h"
+
+/**
+ * @brief 中心が原点で一辺の長さが 2 の立方体の頂点属性とインデックスを作成する
+ *
+ * 面ごとに法線ベクトルの異なる頂点を持ち、三角形は外から見て反時計回りになる
+ *
+ * @param vertex 頂点属性の格納先
+ * @param index 三角形の頂点のインデックスの格納先
+ */
+inline void createBox(std::vector<Object::Vertex>& vertex, std::vector<GLuint>& index)
+{
+    vertex.clear();
+    index.clear();
+    vertex.reserve(24);
+    index.reserve(36);
+    for (int face = 0; face < 6; ++face)
+    {
+        // 面の法線の軸と向き
+        const int axis(face / 2), u((axis + 1) % 3), v((axis + 2) % 3);
+        const GLfloat sign(face % 2 == 0 ? 1.0f : -1.0f);
+
+        // u 軸, v 軸の順に回ると +axis から見て反時計回りになる
+        const GLfloat corner[][2] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+        const GLuint base(static_cast<GLuint>(vertex.size()));
+        for (const GLfloat* c : corner)
+        {
+            Object::Vertex p {};
+            p.position[axis] = sign;
+            p.position[u]    = c[0] * sign;
+            p.position[v]    = c[1];
+            p.normal[axis]   = sign;
+            vertex.push_back(p);
+        }
+
+        // 左下の三角形と右上の三角形
+        const GLuint quad[] = {0, 1, 2, 0, 2, 3};
+        for (GLuint i : quad)
+        {
+            index.push_back(base + i);
+        }
+    }
+}
@@ -0,0 +1,440 @@
+#pragma once
+#include <GL/glew.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Image.h"
+#include "MemoryStats.h"
+
+/**
+ * フレームバッファの内容をピクセルバッファオブジェクトに非同期に読み出して、
+ * 別のスレッドで連番の画像ファイルに書き出すクラス
+ *
+ * glReadPixels() はピクセルバッファオブジェクトへの転送を指示するだけで戻り、
+ * 転送の完了はフェンスで確かめるので、描画のスレッドはGPUを待たない
+ */
+class Capture
+{
+public:
+    /**
+     * 書き出すファイルの形式
+     */
+    enum class Format
+    {
+        /** 無圧縮の PNG */
+        Png,
+        /** RGBA の画素をそのまま並べたもの */
+        Raw
+    };
+
+private:
+    /**
+     * 読み出しに使う領域の状態
+     */
+    enum State
+    {
+        /** 空いている */
+        Free,
+        /** GPU が転送している */
+        Reading,
+        /** 書き出しのスレッドが使っている */
+        Encoding
+    };
+
+    /**
+     * 読み出しに使う領域
+     */
+    struct Slot
+    {
+        /** ピクセルバッファオブジェクト名 */
+        GLuint pbo;
+
+        /** 転送の完了を待つフェンス */
+        GLsync fence;
+
+        /** フレームの番号 */
+        unsigned long frame;
+
+        /** 永続的にマップした画素 (使わないときは NULL) */
+        const unsigned char* mapped;
+
+        /** 永続的にマップしないときに画素を写しておく領域 */
+        std::vector<unsigned char> copy;
+
+        /** 状態 */
+        std::atomic<int> state;
+    };
+
+    /** 読み出す大きさ (resize() で変える) */
+    GLsizei width, height;
+
+    /** 書き出すファイル名の先頭 */
+    const std::string prefix;
+
+    /** 書き出すファイルの形式 */
+    const Format format;
+
+    /** 空いている領域がなければ待つ (false ならそのフレームを捨てる) */
+    const bool blocking;
+
+    /** 読み出しに使う領域 */
+    std::unique_ptr<Slot[]> slots;
+
+    /** 領域の数 */
+    const unsigned int depth;
+
+    /** 次に使う領域 */
+    unsigned int next;
+
+    /** 転送中の領域 (古い順) */
+    std::deque<unsigned int> reading;
+
+    /** 次のフレームの番号 */
+    unsigned long frame;
+
+    /** 空いている領域がないか読み出しに失敗して捨てたフレームの数 */
+    unsigned long dropped;
+
+    /** 書き出すフレーム (書き出しのスレッドと共有する) */
+    std::deque<unsigned int> jobs;
+
+    /** jobs の排他制御 */
+    std::mutex mutex;
+
+    /** jobs の追加と領域の解放を知らせる */
+    std::condition_variable condition;
+
+    /** 書き出しを終了する */
+    bool quit;
+
+    /** 書き出したフレームの数 */
+    std::atomic<unsigned long> written;
+
+    /** 書き出しのスレッド */
+    std::thread encoder;
+
+public:
+    /**
+     * @brief Construct a new Capture object
+     *
+     * @param width 読み出す幅
+     * @param height 読み出す高さ
+     * @param prefix 書き出すファイル名の先頭 (後ろにフレームの番号と拡張子を付ける)
+     * @param format 書き出すファイルの形式
+     * @param depth 読み出しに使う領域の数 (何フレーム遅れて画素を受け取るか)
+     * @param blocking 空いている領域がなければ待つ (false ならそのフレームを捨てる)
+     */
+    Capture(GLsizei width,
+            GLsizei height,
+            std::string prefix,
+            Format format       = Format::Png,
+            unsigned int depth  = 3,
+            bool blocking       = false) :
+        width(width), height(height), prefix(prefix), format(format), blocking(blocking),
+        slots(new Slot[depth > 0 ? depth : 1]), depth(depth > 0 ? depth : 1), next(0), frame(0),
+        dropped(0), quit(false), written(0)
+    {
+        for (unsigned int i = 0; i < this->depth; ++i)
+        {
+            Slot& slot(slots[i]);
+            slot.fence = 0;
+            slot.frame = 0;
+            slot.state = Free;
+        }
+        allocate();
+
+        encoder = std::thread(&Capture::encode, this);
+    }
+
+    /** 読み出し中のフレームを全て書き出してから終了する */
+    virtual ~Capture()
+    {
+        while (!reading.empty())
+        {
+            retire(true);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        condition.notify_all();
+        encoder.join();
+
+        release();
+    }
+
+    /**
+     * @brief 読み出す大きさを変える (ウィンドウの大きさが変わったときに呼ぶ)
+     *
+     * 大きさが変わっていれば、読み出し中と書き出し中のフレームを全て書き出してから
+     * ピクセルバッファオブジェクトを作り直す。
+     *
+     * @param width 読み出す幅
+     * @param height 読み出す高さ
+     */
+    void resize(GLsizei width, GLsizei height)
+    {
+        if (width == this->width && height == this->height)
+            return;
+
+        while (!reading.empty())
+        {
+            retire(true);
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() { return jobs.empty() && isIdle(); });
+        }
+
+        release();
+        this->width  = width;
+        this->height = height;
+        allocate();
+    }
+
+    /**
+     * @brief フレームバッファの内容の読み出しを開始する (描画が終わってから呼ぶ)
+     *
+     * @param framebuffer 読み出すフレームバッファオブジェクト (0 ならデフォルトのフレームバッファ)
+     */
+    void capture(GLuint framebuffer = 0)
+    {
+        // 転送が終わった領域を書き出しのスレッドに渡す
+        while (!reading.empty() && retire(false))
+        {
+        }
+
+        Slot& slot(slots[next]);
+        if (slot.state.load(std::memory_order_acquire) != Free)
+        {
+            if (!blocking)
+            {
+                ++dropped;
+                return;
+            }
+
+            // 転送中なら完了を待ち、書き出し中なら書き出しが終わるのを待つ
+            while (slot.state.load(std::memory_order_acquire) == Reading)
+            {
+                retire(true);
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() {
+                return slot.state.load(std::memory_order_acquire) == Free;
+            });
+        }
+
+        // ピクセルバッファオブジェクトへの転送を指示する
+        GLint previous, alignment;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+        glGetIntegerv(GL_PACK_ALIGNMENT, &alignment);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = frame++;
+        slot.state.store(Reading, std::memory_order_relaxed);
+        reading.push_back(next);
+        next = (next + 1) % depth;
+    }
+
+    /** 読み出しを開始したフレームの数を返す */
+    unsigned long getFrames() const
+    {
+        return frame;
+    }
+
+    /** 書き出したフレームの数を返す */
+    unsigned long getWritten() const
+    {
+        return written.load(std::memory_order_relaxed);
+    }
+
+    /** 空いている領域がないか読み出しに失敗して捨てたフレームの数を返す */
+    unsigned long getDropped() const
+    {
+        return dropped;
+    }
+
+private:
+    /**
+     * @brief 一番古い転送中の領域の転送が終わっていれば書き出しのスレッドに渡す
+     *
+     * フェンスの待ち合わせやマップに失敗したときは、そのフレームを捨てて領域を空ける。
+     *
+     * @param wait true なら転送が終わるまで待つ
+     * @return true 書き出しのスレッドに渡したか、捨てた
+     * @return false まだ転送が終わっていない
+     */
+    bool retire(bool wait)
+    {
+        const unsigned int i(reading.front());
+        Slot& slot(slots[i]);
+
+        const GLuint64 timeout(wait ? 1000000000ull : 0ull);
+        const GLenum status(glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout));
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+        reading.pop_front();
+
+        if (status == GL_WAIT_FAILED)
+        {
+            std::cerr << "Can't wait for the transfer of frame " << slot.frame << std::endl;
+            discard(slot);
+            return true;
+        }
+
+        // 永続的にマップしていなければ画素を写しておく
+        if (slot.mapped == NULL)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            const void* const p(glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+                                                 0,
+                                                 static_cast<GLsizeiptr>(slot.copy.size()),
+                                                 GL_MAP_READ_BIT));
+            if (p == NULL)
+            {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                std::cerr << "Can't map the pixel buffer of frame " << slot.frame << std::endl;
+                discard(slot);
+                return true;
+            }
+            std::memcpy(slot.copy.data(), p, slot.copy.size());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        slot.state.store(Encoding, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(i);
+        }
+        condition.notify_all();
+        return true;
+    }
+
+    /** 今の大きさのピクセルバッファオブジェクトを作る */
+    void allocate()
+    {
+        const GLsizeiptr size(static_cast<GLsizeiptr>(width) * height * 4);
+        for (unsigned int i = 0; i < depth; ++i)
+        {
+            Slot& slot(slots[i]);
+            slot.mapped = NULL;
+            std::vector<unsigned char>().swap(slot.copy);
+
+            glGenBuffers(1, &slot.pbo);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+            if (GLEW_ARB_buffer_storage)
+            {
+                // 書き出しのスレッドがマップしたまま直接読み出す
+                const GLbitfield flags(GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT
+                                       | GL_MAP_COHERENT_BIT);
+                glBufferStorage(GL_PIXEL_PACK_BUFFER, size, NULL, flags);
+                slot.mapped = static_cast<const unsigned char*>(
+                    glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, flags));
+            }
+            else
+            {
+                glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+            }
+
+            // 永続的にマップできなければ転送が終わるたびにマップして写す
+            if (slot.mapped == NULL)
+                slot.copy.resize(size);
+            MemoryStats::get().allocate(MemoryStats::Category::PixelBuffer, size);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    /** ピクセルバッファオブジェクトを削除する (全ての領域が空いているときに呼ぶ) */
+    void release()
+    {
+        for (unsigned int i = 0; i < depth; ++i)
+        {
+            glDeleteSync(slots[i].fence);
+            slots[i].fence = 0;
+            glDeleteBuffers(1, &slots[i].pbo);
+            MemoryStats::get().release(MemoryStats::Category::PixelBuffer,
+                                       static_cast<GLsizeiptr>(width) * height * 4);
+        }
+    }
+
+    /** 全ての領域が空いているか */
+    bool isIdle() const
+    {
+        for (unsigned int i = 0; i < depth; ++i)
+        {
+            if (slots[i].state.load(std::memory_order_acquire) != Free)
+                return false;
+        }
+        return true;
+    }
+
+    /** 転送を終えた領域のフレームを書き出さずに捨てて領域を空ける */
+    void discard(Slot& slot)
+    {
+        ++dropped;
+        slot.state.store(Free, std::memory_order_release);
+    }
+
+    /** 書き出しのスレッドの処理 */
+    void encode()
+    {
+        for (;;)
+        {
+            unsigned int i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]() { return quit || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                i = jobs.front();
+                jobs.pop_front();
+            }
+
+            Slot& slot(slots[i]);
+            const unsigned char* const pixels(slot.mapped ? slot.mapped : slot.copy.data());
+
+            char number[16];
+            std::snprintf(number, sizeof number, "%06lu", slot.frame);
+            const std::string name(prefix + number + (format == Format::Png ? ".png" : ".rgba"));
+            const bool ok(format == Format::Png ? Image::writePng(name, width, height, pixels)
+                                                : Image::writeRaw(name, width, height, pixels));
+            if (ok)
+                written.fetch_add(1, std::memory_order_relaxed);
+            else
+                std::cerr << "Failed to write " << name << std::endl;
+
+            // 領域を空ける
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slot.state.store(Free, std::memory_order_release);
+            }
+            condition.notify_all();
+        }
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    Capture(const Capture& o);
+
+    /** 代入によるコピー禁止 */
+    Capture& operator=(const Capture& o);
+};
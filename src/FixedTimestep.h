@@ -0,0 +1,75 @@
+#pragma once
+
+/**
+ * 固定時間刻みでシミュレーションを進めるクラス
+ */
+class FixedTimestep
+{
+    /** 一回の更新で進める時間 */
+    const double step;
+
+    /** 一度に進める更新の最大回数 */
+    const int maxSteps;
+
+    /** 前回の時刻 */
+    double last;
+
+    /** まだ更新に使っていない時間 */
+    double accumulator;
+
+public:
+    /**
+     * @brief Construct a new FixedTimestep object
+     *
+     * @param step 一回の更新で進める時間
+     * @param maxSteps 一度に進める更新の最大回数 (処理落ちしたときに追いつこうとし続けない)
+     */
+    FixedTimestep(double step = 1.0 / 60.0, int maxSteps = 8) :
+        step(step), maxSteps(maxSteps), last(0.0), accumulator(0.0)
+    {
+    }
+
+    /** 時刻を設定し直す */
+    void reset(double now)
+    {
+        last        = now;
+        accumulator = 0.0;
+    }
+
+    /**
+     * @brief 時刻を進めて行うべき更新の回数を求める
+     *
+     * @param now 現在の時刻
+     * @return int 更新の回数
+     */
+    int advance(double now)
+    {
+        accumulator += now - last;
+        last = now;
+
+        int steps(0);
+        while (accumulator >= step && steps < maxSteps)
+        {
+            accumulator -= step;
+            ++steps;
+        }
+
+        // 追いつけなかった時間は捨てる
+        if (steps == maxSteps && accumulator >= step)
+            accumulator = 0.0;
+
+        return steps;
+    }
+
+    /** 一回の更新で進める時間を返す */
+    double getStep() const
+    {
+        return step;
+    }
+
+    /** 直前の更新から次の更新までの補間に使う割合を返す */
+    double getAlpha() const
+    {
+        return accumulator / step;
+    }
+};
@@ -0,0 +1,311 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "MemoryStats.h"
+
+/**
+ * 一フレームの間だけ使うデータを確保する線形のアロケータ
+ *
+ * 確保はブロックの中で位置を進めるだけで、個別には解放せず、フレームの終わりに
+ * reset() でまとめて捨てる。一つのブロックに収まらなければ新しいブロックを足し、
+ * reset() のときにそのフレームで使った量の 1.25 倍の一つのブロックにまとめなおすので、
+ * 使う量が前のフレームから大きく増えない限りヒープからの確保は起きない。
+ * 一つのアリーナは一つのスレッドだけが確保と reset() を行うこと (local() を参照)。
+ * このアリーナから確保したコンテナは reset() の前に破棄するか、
+ * reset() の後に作りなおすこと。
+ */
+class FrameArena
+{
+    /**
+     * ヒープから確保したブロック
+     */
+    struct Block
+    {
+        /** 先頭 */
+        char* data;
+        /** バイト数 */
+        std::size_t size;
+    };
+
+    /** 確保したブロック (最後のブロックから確保する) */
+    std::vector<Block> blocks;
+
+    /** 最後のブロックで使ったバイト数 */
+    std::size_t offset;
+
+    /** 最後のブロックより前のブロックで使ったバイト数 */
+    std::size_t filled;
+
+    /** 最初のブロックのバイト数 */
+    const std::size_t initial;
+
+    /** 確保したブロックの合計のバイト数 */
+    std::size_t capacity;
+
+    /** フレームの中で使ったバイト数の最大値 */
+    std::size_t peak;
+
+    /** このフレームで確保した回数 */
+    unsigned long allocations;
+
+    /** このフレームでヒープから確保した回数 */
+    unsigned long frameMallocs;
+
+    /** ヒープから確保した回数 */
+    unsigned long mallocs;
+
+    /** reset() した回数 */
+    unsigned long frames;
+
+    /** 全てのアリーナがヒープから確保した回数 */
+    static std::atomic<unsigned long>& totalMallocs()
+    {
+        static std::atomic<unsigned long> count(0);
+        return count;
+    }
+
+public:
+    /**
+     * @brief Construct a new FrameArena object
+     *
+     * ブロックは最初に確保するときに用意する。
+     *
+     * @param initial 最初のブロックのバイト数
+     */
+    explicit FrameArena(std::size_t initial = 64 * 1024) :
+        offset(0), filled(0), initial(std::max(initial, static_cast<std::size_t>(256))),
+        capacity(0), peak(0), allocations(0), frameMallocs(0), mallocs(0), frames(0)
+    {
+        blocks.reserve(16);
+    }
+
+    virtual ~FrameArena()
+    {
+        release();
+    }
+
+    /**
+     * @brief メモリを確保する
+     *
+     * @param bytes バイト数
+     * @param alignment アライメント (2 の累乗)
+     * @return void* 確保したメモリ (reset() まで有効)
+     */
+    void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t))
+    {
+        ++allocations;
+        if (!blocks.empty())
+        {
+            const Block& block(blocks.back());
+            const std::size_t start(align(block.data, offset, alignment));
+            if (start + bytes <= block.size)
+            {
+                offset = start + bytes;
+                peak   = std::max(peak, filled + offset);
+                return block.data + start;
+            }
+        }
+
+        // 収まらなければ確保した合計の半分以上のブロックを足す
+        grow(std::max(capacity / 2, bytes + alignment));
+        const Block& block(blocks.back());
+        const std::size_t start(align(block.data, 0, alignment));
+        offset = start + bytes;
+        peak   = std::max(peak, filled + offset);
+        return block.data + start;
+    }
+
+    /**
+     * @brief このフレームで確保したメモリをまとめて捨てる
+     *
+     * 複数のブロックを使ったときは、使った量の 1.25 倍の一つのブロックにまとめなおす。
+     */
+    void reset()
+    {
+        if (blocks.size() > 1)
+        {
+            const std::size_t used(getUsed());
+            release();
+            grow(used + used / 4);
+        }
+        offset       = 0;
+        filled       = 0;
+        allocations  = 0;
+        frameMallocs = 0;
+        ++frames;
+    }
+
+    /** このフレームで使ったバイト数を返す */
+    std::size_t getUsed() const
+    {
+        return filled + offset;
+    }
+
+    /** フレームの中で使ったバイト数の最大値を返す */
+    std::size_t getPeak() const
+    {
+        return peak;
+    }
+
+    /** 確保したブロックの合計のバイト数を返す */
+    std::size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+    /** このフレームで確保した回数を返す */
+    unsigned long getAllocations() const
+    {
+        return allocations;
+    }
+
+    /** このフレームでヒープから確保した回数を返す (定常状態では 0) */
+    unsigned long getFrameMallocs() const
+    {
+        return frameMallocs;
+    }
+
+    /** ヒープから確保した回数を返す */
+    unsigned long getMallocs() const
+    {
+        return mallocs;
+    }
+
+    /** reset() した回数を返す */
+    unsigned long getFrames() const
+    {
+        return frames;
+    }
+
+    /** 全てのアリーナがヒープから確保した回数を返す */
+    static unsigned long getTotalMallocs()
+    {
+        return totalMallocs().load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 呼び出したスレッドのアリーナを返す
+     *
+     * 描画やシミュレーションのループは、そのスレッドのアリーナをフレームの終わりに
+     * reset() する。
+     *
+     * @return FrameArena&
+     */
+    static FrameArena& local()
+    {
+        thread_local FrameArena arena;
+        return arena;
+    }
+
+private:
+    /** ブロックの先頭から offset 以降で alignment に揃えた位置を返す */
+    static std::size_t align(const char* data, std::size_t offset, std::size_t alignment)
+    {
+        const std::uintptr_t address(reinterpret_cast<std::uintptr_t>(data) + offset);
+        return offset + ((alignment - address % alignment) % alignment);
+    }
+
+    /** bytes 以上のブロックを足す */
+    void grow(std::size_t bytes)
+    {
+        bytes = std::max(bytes, initial);
+        char* const data(static_cast<char*>(std::malloc(bytes)));
+        if (data == NULL)
+            throw std::bad_alloc();
+
+        if (!blocks.empty())
+            filled += offset;
+        blocks.push_back({data, bytes});
+        offset = 0;
+        capacity += bytes;
+        ++frameMallocs;
+        ++mallocs;
+        totalMallocs().fetch_add(1, std::memory_order_relaxed);
+        MemoryStats::get().allocate(MemoryStats::Category::FrameArena, bytes);
+    }
+
+    /** 全てのブロックを解放する */
+    void release()
+    {
+        for (const Block& block : blocks)
+        {
+            std::free(block.data);
+            MemoryStats::get().release(MemoryStats::Category::FrameArena, block.size);
+        }
+        blocks.clear();
+        capacity = 0;
+        offset   = 0;
+        filled   = 0;
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    FrameArena(const FrameArena& a);
+
+    /** 代入によるコピー禁止 */
+    FrameArena& operator=(const FrameArena& a);
+};
+
+/**
+ * FrameArena から確保する STL のコンテナ用のアロケータ
+ *
+ * deallocate() は何もせず、メモリはアリーナの reset() でまとめて捨てる。
+ */
+template <typename T>
+class FrameAllocator
+{
+    template <typename U>
+    friend class FrameAllocator;
+
+    /** 確保するアリーナ */
+    FrameArena* arena;
+
+public:
+    using value_type = T;
+
+    /** 呼び出したスレッドのアリーナから確保する */
+    FrameAllocator() noexcept : arena(&FrameArena::local()) {}
+
+    /** 指定したアリーナから確保する */
+    explicit FrameAllocator(FrameArena& arena) noexcept : arena(&arena) {}
+
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U>& a) noexcept : arena(a.arena)
+    {
+    }
+
+    /** n 個の要素の領域を確保する */
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    /** 個別には解放しない */
+    void deallocate(T*, std::size_t) noexcept {}
+
+    /** 確保するアリーナを返す */
+    FrameArena& getArena() const
+    {
+        return *arena;
+    }
+
+    template <typename U>
+    bool operator==(const FrameAllocator<U>& a) const noexcept
+    {
+        return arena == a.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const FrameAllocator<U>& a) const noexcept
+    {
+        return arena != a.arena;
+    }
+};
+
+/** FrameArena から確保する可変長の配列 */
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
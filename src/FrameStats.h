@@ -0,0 +1,106 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * 時間の計測値の統計を取るクラス
+ */
+class FrameStats
+{
+    /** 名前 */
+    const std::string name;
+
+    /** 直近の計測値 (百分位数に使う) */
+    std::vector<double> recent;
+
+    /** 次に直近の計測値を書き込む位置 */
+    std::size_t next;
+
+    /** 計測値の数 */
+    std::size_t count;
+
+    /** 平均 */
+    double mean;
+
+    /** 平均との差の二乗和 */
+    double m2;
+
+    /** 最小値 */
+    double minimum;
+
+    /** 最大値 */
+    double maximum;
+
+public:
+    /**
+     * @brief Construct a new FrameStats object
+     *
+     * @param name 表示に使う名前
+     * @param capacity 百分位数を求めるために保持する直近の計測値の数
+     */
+    FrameStats(std::string name, std::size_t capacity = 1024) :
+        name(name), recent(capacity), next(0), count(0), mean(0.0), m2(0.0), minimum(0.0),
+        maximum(0.0)
+    {
+    }
+
+    /** 計測値を追加する */
+    void add(double t)
+    {
+        recent[next] = t;
+        next         = (next + 1) % recent.size();
+
+        // 平均と分散を逐次的に求める
+        ++count;
+        const double d(t - mean);
+        mean += d / static_cast<double>(count);
+        m2 += d * (t - mean);
+
+        minimum = count == 1 ? t : std::min(minimum, t);
+        maximum = count == 1 ? t : std::max(maximum, t);
+    }
+
+    /** 計測値の数を返す */
+    std::size_t getCount() const
+    {
+        return count;
+    }
+
+    /** 平均を返す */
+    double getMean() const
+    {
+        return mean;
+    }
+
+    /** 標準偏差 (ジッタ) を返す */
+    double getDeviation() const
+    {
+        return count > 1 ? std::sqrt(m2 / static_cast<double>(count - 1)) : 0.0;
+    }
+
+    /** 直近の計測値の百分位数を返す */
+    double getPercentile(double p) const
+    {
+        const std::size_t n(std::min(count, recent.size()));
+        if (n == 0)
+            return 0.0;
+
+        std::vector<double> sorted(recent.begin(), recent.begin() + n);
+        const std::size_t k(std::min(n - 1, static_cast<std::size_t>(p * 0.01 * n)));
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        return sorted[k];
+    }
+
+    /** 統計をミリ秒単位で出力する */
+    void print(std::ostream& os = std::cout) const
+    {
+        os << name << ": n=" << count << " mean=" << mean * 1000.0
+           << "ms jitter=" << getDeviation() * 1000.0 << "ms min=" << minimum * 1000.0
+           << "ms max=" << maximum * 1000.0 << "ms p99=" << getPercentile(99.0) * 1000.0 << "ms"
+           << std::endl;
+    }
+};
@@ -0,0 +1,614 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GlTrace.h"
+#include "Shader.h"
+
+/**
+ * GlTrace が記録した OpenGL の命令を再生するクラス
+ *
+ * ファイルを全て読み込んでフレームの区切りを調べておき、setup() で記録を始めたフレームまでの
+ * 資源の作成と状態の変更を一度だけ実行してから、play() でフレームごとに命令を実行する。
+ * 記録したときのバッファオブジェクトなどの名前は再生で作ったものに、
+ * uniform 変数の場所は再生で問い合わせたものに置き換える。
+ * 命令ごとに実行の回数と CPU の時間を集計する。
+ */
+class GlReplay
+{
+public:
+    /**
+     * 命令ごとの集計
+     */
+    struct CallStats
+    {
+        /** 実行した回数 */
+        unsigned long count;
+        /** 実行にかかった時間 (秒) */
+        double seconds;
+    };
+
+private:
+    using Command = GlTrace::Command;
+
+    /** ファイルの内容 */
+    std::vector<char> data;
+
+    /** 記録を始めたフレームまでの命令の終わり */
+    std::size_t setupEnd;
+
+    /** フレームごとの命令の終わり */
+    std::vector<std::size_t> frameEnds;
+
+    /** 記録を始めたフレームの番号 */
+    unsigned long first;
+
+    /** ビューポートの最大の大きさ */
+    GLsizei size[2];
+
+    /** 記録したときの名前から再生で作った名前への対応 */
+    std::unordered_map<GLuint, GLuint> buffers, arrays, textures, programs;
+
+    /** プログラムオブジェクトごとの uniform 変数の場所の対応 */
+    std::unordered_map<GLuint, std::map<GLint, GLint>> locations;
+
+    /** プログラムオブジェクトごとの uniform ブロックの番号の対応 */
+    std::unordered_map<GLuint, std::map<GLuint, GLuint>> blocks;
+
+    /** 記録したときの使用中のプログラムオブジェクト */
+    GLuint current;
+
+    /** 命令ごとの集計 */
+    CallStats stats[GlTrace::commands];
+
+    /** 読み込めた */
+    bool valid;
+
+public:
+    /**
+     * @brief Construct a new GlReplay object
+     *
+     * @param name GlTrace が書き出したファイル名
+     */
+    explicit GlReplay(const std::string& name) :
+        setupEnd(0), first(0), size{0, 0}, current(0), valid(false)
+    {
+        resetStats();
+
+        std::ifstream file(name, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "Failed to open file: " << name << std::endl;
+            return;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        // 見出しを確かめる
+        const std::size_t header(4 * sizeof(std::uint32_t));
+        std::uint32_t head[4] = {0, 0, 0, 0};
+        if (data.size() >= header)
+            std::memcpy(head, data.data(), header);
+        if (head[0] != GlTrace::magic || head[1] != GlTrace::version)
+        {
+            std::cerr << name << ": not a trace of version " << GlTrace::version << std::endl;
+            return;
+        }
+        first = head[2];
+
+        // 命令を実行せずにたどってフレームの区切りを調べる
+        std::size_t offset(header);
+        bool begun(false);
+        while (offset < data.size())
+        {
+            const Command command(static_cast<Command>(data[offset]));
+            if (static_cast<int>(command) >= GlTrace::commands)
+            {
+                std::cerr << name << ": unknown command at " << offset << std::endl;
+                break;
+            }
+
+            Cursor cursor = {data.data() + offset, data.data() + data.size()};
+            ++cursor.p;
+            if (!execute(command, cursor, false))
+            {
+                std::cerr << name << ": truncated at " << offset << std::endl;
+                break;
+            }
+            offset = cursor.p - data.data();
+
+            if (command == Command::Begin)
+            {
+                setupEnd = offset;
+                begun    = true;
+            }
+            else if (command == Command::Frame && begun)
+            {
+                frameEnds.push_back(offset);
+            }
+        }
+        valid = begun;
+    }
+
+    virtual ~GlReplay()
+    {
+        for (const auto& b : buffers)
+        {
+            glDeleteBuffers(1, &b.second);
+        }
+        for (const auto& a : arrays)
+        {
+            glDeleteVertexArrays(1, &a.second);
+        }
+        for (const auto& t : textures)
+        {
+            glDeleteTextures(1, &t.second);
+        }
+        for (const auto& p : programs)
+        {
+            deleteProgram(p.second);
+        }
+    }
+
+    /** 再生できるかを返す */
+    explicit operator bool() const
+    {
+        return valid;
+    }
+
+    /** 記録したフレームの数を返す */
+    std::size_t getFrames() const
+    {
+        return frameEnds.size();
+    }
+
+    /** 記録を始めたフレームの番号を返す */
+    unsigned long getFirst() const
+    {
+        return first;
+    }
+
+    /** ビューポートの最大の幅を返す */
+    GLsizei getWidth() const
+    {
+        return size[0];
+    }
+
+    /** ビューポートの最大の高さを返す */
+    GLsizei getHeight() const
+    {
+        return size[1];
+    }
+
+    /** 記録を始めたフレームまでの資源の作成と状態の変更を実行する */
+    void setup()
+    {
+        run(4 * sizeof(std::uint32_t), setupEnd);
+    }
+
+    /**
+     * @brief 一つのフレームの命令を実行する
+     *
+     * @param frame フレームの番号 (0 が記録を始めたフレーム)
+     */
+    void play(std::size_t frame)
+    {
+        run(frame == 0 ? setupEnd : frameEnds[frame - 1], frameEnds[frame]);
+    }
+
+    /** 命令ごとの集計を返す */
+    const CallStats& getStats(GlTrace::Command command) const
+    {
+        return stats[static_cast<int>(command)];
+    }
+
+    /** 命令ごとの集計を 0 にする */
+    void resetStats()
+    {
+        for (CallStats& s : stats)
+        {
+            s.count   = 0;
+            s.seconds = 0.0;
+        }
+    }
+
+    /** 命令ごとの集計を時間の長い順に表示する */
+    void print(std::ostream& os = std::cout) const
+    {
+        std::vector<int> order;
+        for (int i = 0; i < GlTrace::commands; ++i)
+        {
+            if (stats[i].count > 0)
+                order.push_back(i);
+        }
+        std::sort(order.begin(), order.end(), [this](int a, int b) {
+            return stats[a].seconds > stats[b].seconds;
+        });
+        for (int i : order)
+        {
+            os << "  " << GlTrace::getName(static_cast<Command>(i)) << ": n=" << stats[i].count
+               << " total=" << stats[i].seconds * 1000.0
+               << "ms mean=" << stats[i].seconds * 1.0e6 / stats[i].count << "us" << std::endl;
+        }
+    }
+
+private:
+    /**
+     * 命令を読み出す位置
+     */
+    struct Cursor
+    {
+        /** 次に読み出す位置 */
+        const char* p;
+        /** 終わり */
+        const char* end;
+
+        /** 値を読み出す */
+        template<typename T>
+        bool get(T& value)
+        {
+            if (end - p < static_cast<std::ptrdiff_t>(sizeof value))
+                return false;
+            std::memcpy(&value, p, sizeof value);
+            p += sizeof value;
+            return true;
+        }
+
+        /** 長さの付いたデータを読み出す */
+        bool getData(const char*& bytes, std::uint32_t& size)
+        {
+            if (!get(size) || end - p < static_cast<std::ptrdiff_t>(size))
+                return false;
+            bytes = p;
+            p += size;
+            return true;
+        }
+    };
+
+    /** 範囲の命令を実行する */
+    void run(std::size_t begin, std::size_t end)
+    {
+        Cursor cursor = {data.data() + begin, data.data() + end};
+        while (cursor.p < cursor.end)
+        {
+            const Command command(static_cast<Command>(*cursor.p++));
+            const auto start(std::chrono::steady_clock::now());
+            execute(command, cursor, true);
+            const std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - start);
+            CallStats& s(stats[static_cast<int>(command)]);
+            ++s.count;
+            s.seconds += elapsed.count();
+        }
+    }
+
+    /** 記録したときの名前を再生で作った名前に置き換える */
+    static GLuint map(const std::unordered_map<GLuint, GLuint>& names, GLuint name)
+    {
+        const auto i(names.find(name));
+        return i != names.end() ? i->second : 0;
+    }
+
+    /** バッファオブジェクトの中の位置をポインタにする */
+    static const void* toPointer(std::uint64_t offset)
+    {
+        return reinterpret_cast<const void*>(static_cast<std::uintptr_t>(offset));
+    }
+
+    /** 記録したときの uniform 変数の場所を再生の場所に置き換える (配列の要素も扱う) */
+    GLint mapLocation(GLint location) const
+    {
+        const auto program(locations.find(current));
+        if (location < 0 || program == locations.end())
+            return -1;
+
+        // 記録した場所のうち、これを超えない最大のものからの差をとる
+        const auto i(program->second.upper_bound(location));
+        if (i == program->second.begin())
+            return -1;
+        const auto base(std::prev(i));
+        return base->second < 0 ? -1 : base->second + (location - base->first);
+    }
+
+    /**
+     * @brief 一つの命令を読み出して実行する
+     *
+     * @param command 命令
+     * @param c 引数を読み出す位置
+     * @param run false なら読み出すだけで実行しない
+     * @return false 引数が途中で切れている
+     */
+    bool execute(Command command, Cursor& c, bool run)
+    {
+        std::uint32_t a(0), b(0), d(0), e(0), f(0), g(0);
+        std::uint64_t x(0), y(0);
+        GLint i(0), j(0);
+        GLfloat v[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        GLdouble depth(0.0);
+        std::uint8_t transpose(0);
+        const char* bytes(NULL);
+        const char* more(NULL);
+        std::uint32_t length(0), moreLength(0);
+
+        switch (command)
+        {
+        case Command::Begin:
+        case Command::Frame:
+            return true;
+        case Command::GenBuffer:
+        case Command::GenVertexArray:
+        case Command::GenTexture:
+            if (!c.get(a))
+                return false;
+            if (run)
+            {
+                GLuint name(0);
+                if (command == Command::GenBuffer)
+                    glGenBuffers(1, &name);
+                else if (command == Command::GenVertexArray)
+                    glGenVertexArrays(1, &name);
+                else
+                    glGenTextures(1, &name);
+                (command == Command::GenBuffer        ? buffers
+                 : command == Command::GenVertexArray ? arrays
+                                                      : textures)[a] = name;
+            }
+            return true;
+        case Command::DeleteBuffer:
+            if (!c.get(a))
+                return false;
+            if (run)
+            {
+                const GLuint name(map(buffers, a));
+                glDeleteBuffers(1, &name);
+                buffers.erase(a);
+            }
+            return true;
+        case Command::DeleteVertexArray:
+            if (!c.get(a))
+                return false;
+            if (run)
+            {
+                const GLuint name(map(arrays, a));
+                glDeleteVertexArrays(1, &name);
+                arrays.erase(a);
+            }
+            return true;
+        case Command::DeleteTexture:
+            if (!c.get(a))
+                return false;
+            if (run)
+            {
+                const GLuint name(map(textures, a));
+                glDeleteTextures(1, &name);
+                textures.erase(a);
+            }
+            return true;
+        case Command::DeleteProgram:
+            if (!c.get(a))
+                return false;
+            if (run)
+            {
+                deleteProgram(map(programs, a));
+                programs.erase(a);
+            }
+            return true;
+        case Command::BindBuffer:
+            if (!c.get(a) || !c.get(b))
+                return false;
+            if (run)
+                glBindBuffer(a, map(buffers, b));
+            return true;
+        case Command::BufferData:
+        case Command::BufferSubData:
+            if (!c.get(a) || !c.get(b) || !c.get(x) || !c.getData(bytes, length))
+                return false;
+            if (run)
+            {
+                glBindBuffer(a, map(buffers, b));
+                if (command == Command::BufferData)
+                    glBufferData(a, length, bytes, static_cast<GLenum>(x));
+                else
+                    glBufferSubData(a, static_cast<GLintptr>(x), length, bytes);
+            }
+            return true;
+        case Command::BindBufferBase:
+            if (!c.get(a) || !c.get(b) || !c.get(d))
+                return false;
+            if (run)
+                glBindBufferBase(a, b, map(buffers, d));
+            return true;
+        case Command::BindBufferRange:
+            if (!c.get(a) || !c.get(b) || !c.get(d) || !c.get(x) || !c.get(y))
+                return false;
+            if (run)
+                glBindBufferRange(a, b, map(buffers, d), x, y);
+            return true;
+        case Command::BindVertexArray:
+            if (!c.get(a))
+                return false;
+            if (run)
+                glBindVertexArray(map(arrays, a));
+            return true;
+        case Command::VertexAttribPointer:
+            if (!c.get(a) || !c.get(b) || !c.get(i) || !c.get(d) || !c.get(e) || !c.get(j)
+                || !c.get(x))
+                return false;
+            if (run)
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, map(buffers, a));
+                glVertexAttribPointer(b, i, d, static_cast<GLboolean>(e), j, toPointer(x));
+            }
+            return true;
+        case Command::EnableVertexAttribArray:
+            if (!c.get(a))
+                return false;
+            if (run)
+                glEnableVertexAttribArray(a);
+            return true;
+        case Command::ActiveTexture:
+            if (!c.get(a))
+                return false;
+            if (run)
+                glActiveTexture(a);
+            return true;
+        case Command::BindTexture:
+            if (!c.get(a) || !c.get(b))
+                return false;
+            if (run)
+                glBindTexture(a, map(textures, b));
+            return true;
+        case Command::TexBuffer:
+            if (!c.get(a) || !c.get(b) || !c.get(d))
+                return false;
+            if (run)
+                glTexBuffer(a, b, map(buffers, d));
+            return true;
+        case Command::CreateProgram:
+            if (!c.get(a) || !c.getData(bytes, length) || !c.getData(more, moreLength))
+                return false;
+            if (run)
+                programs[a] = createProgram(std::string(bytes, length),
+                                            std::string(more, moreLength));
+            return true;
+        case Command::UseProgram:
+            if (!c.get(a))
+                return false;
+            if (run)
+            {
+                current = a;
+                glUseProgram(map(programs, a));
+            }
+            return true;
+        case Command::GetUniformLocation:
+        case Command::GetUniformBlockIndex:
+            if (!c.get(a) || !c.get(i) || !c.getData(bytes, length))
+                return false;
+            if (run)
+            {
+                const std::string name(bytes, length);
+                const GLuint program(map(programs, a));
+                if (command == Command::GetUniformLocation)
+                    locations[a][i] = glGetUniformLocation(program, name.c_str());
+                else
+                    blocks[a][static_cast<GLuint>(i)] =
+                        glGetUniformBlockIndex(program, name.c_str());
+            }
+            return true;
+        case Command::UniformBlockBinding:
+            if (!c.get(a) || !c.get(b) || !c.get(d))
+                return false;
+            if (run)
+                glUniformBlockBinding(map(programs, a), blocks[a][b], d);
+            return true;
+        case Command::Uniform1i:
+            if (!c.get(i) || !c.get(j))
+                return false;
+            if (run)
+                glUniform1i(mapLocation(i), j);
+            return true;
+        case Command::Uniform1f:
+            if (!c.get(i) || !c.get(v[0]))
+                return false;
+            if (run)
+                glUniform1f(mapLocation(i), v[0]);
+            return true;
+        case Command::Uniform3fv:
+        case Command::Uniform4fv:
+        case Command::UniformMatrix3fv:
+        case Command::UniformMatrix4fv:
+            if (!c.get(i) || !c.get(transpose) || !c.getData(bytes, length))
+                return false;
+            if (run)
+            {
+                // 記録した内容は揃っていないかもしれないので写してから渡す
+                std::vector<GLfloat> values(length / sizeof(GLfloat));
+                std::memcpy(values.data(), bytes, values.size() * sizeof(GLfloat));
+                const GLint location(mapLocation(i));
+                const GLsizei n(static_cast<GLsizei>(values.size()));
+                if (command == Command::Uniform3fv)
+                    glUniform3fv(location, n / 3, values.data());
+                else if (command == Command::Uniform4fv)
+                    glUniform4fv(location, n / 4, values.data());
+                else if (command == Command::UniformMatrix3fv)
+                    glUniformMatrix3fv(location, n / 9, transpose, values.data());
+                else
+                    glUniformMatrix4fv(location, n / 16, transpose, values.data());
+            }
+            return true;
+        case Command::Enable:
+        case Command::Disable:
+        case Command::FrontFace:
+        case Command::CullFace:
+        case Command::DepthFunc:
+        case Command::Clear:
+        case Command::PrimitiveRestartIndex:
+            if (!c.get(a))
+                return false;
+            if (run)
+            {
+                if (command == Command::Enable)
+                    glEnable(a);
+                else if (command == Command::Disable)
+                    glDisable(a);
+                else if (command == Command::FrontFace)
+                    glFrontFace(a);
+                else if (command == Command::CullFace)
+                    glCullFace(a);
+                else if (command == Command::DepthFunc)
+                    glDepthFunc(a);
+                else if (command == Command::Clear)
+                    glClear(a);
+                else
+                    glPrimitiveRestartIndex(a);
+            }
+            return true;
+        case Command::ClearDepth:
+            if (!c.get(depth))
+                return false;
+            if (run)
+                glClearDepth(depth);
+            return true;
+        case Command::ClearColor:
+            if (!c.get(v[0]) || !c.get(v[1]) || !c.get(v[2]) || !c.get(v[3]))
+                return false;
+            if (run)
+                glClearColor(v[0], v[1], v[2], v[3]);
+            return true;
+        case Command::Viewport:
+            if (!c.get(i) || !c.get(j) || !c.get(f) || !c.get(g))
+                return false;
+            size[0] = std::max(size[0], static_cast<GLsizei>(f));
+            size[1] = std::max(size[1], static_cast<GLsizei>(g));
+            if (run)
+                glViewport(i, j, f, g);
+            return true;
+        case Command::DrawArrays:
+            if (!c.get(a) || !c.get(i) || !c.get(j))
+                return false;
+            if (run)
+                glDrawArrays(a, i, j);
+            return true;
+        case Command::DrawElements:
+            if (!c.get(a) || !c.get(i) || !c.get(b) || !c.get(x))
+                return false;
+            if (run)
+                glDrawElements(a, i, b, toPointer(x));
+            return true;
+        }
+        return false;
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    GlReplay(const GlReplay& r);
+
+    /** 代入によるコピー禁止 */
+    GlReplay& operator=(const GlReplay& r);
+};
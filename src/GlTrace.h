@@ -0,0 +1,963 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * OpenGL の命令を記録するクラス
+ *
+ * Object、Shape、Uniform、MaterialTable、createProgram() と描画のループは
+ * OpenGL の関数の代わりにこのクラスの同じ名前の静的メンバ関数を呼び出す。
+ * 記録していないときは OpenGL の関数を呼ぶだけで、記録しているときは
+ * 命令と引数、バッファオブジェクトに転送した内容をバイナリ形式のファイルに書き出す。
+ *
+ * 指定したフレームより前は描画とクリアを省き、資源の作成と状態の変更を残すので、
+ * 再生すると同じ状態から始められる。そのうちバッファオブジェクトの同じ範囲への転送、
+ * 同じ uniform 変数への設定と頂点配列オブジェクトの結合は最後のものだけを
+ * 記録を始めるときにまとめて書き出すので、毎フレーム変える値はファイルを大きくしない。
+ * 指定した数のフレームを記録したらファイルを閉じる。
+ *
+ * 読み込みのスレッドの命令も同じファイルに記録する。再生は一つのコンテキストで行うので、
+ * バッファオブジェクトへの転送と頂点属性の設定には結合していたバッファオブジェクトも記録し、
+ * 再生するときに結合しなおす。
+ *
+ * ファイルは先頭に magic, version, first, count (それぞれ 32bit) を置き、
+ * 続けて命令ごとに 1 バイトの命令の番号と固定長の引数を並べる。
+ * 長さが変わるデータは 32bit の長さの後に内容を置く。バイト順は記録した計算機のものになる。
+ * 再生は GlReplay が行う。
+ */
+class GlTrace
+{
+public:
+    /**
+     * 記録する命令
+     */
+    enum class Command : std::uint8_t
+    {
+        /** 記録するフレームの始まり (引数なし) */
+        Begin,
+        /** フレームの終わり (引数なし) */
+        Frame,
+        GenBuffer,
+        DeleteBuffer,
+        BindBuffer,
+        /** バッファオブジェクトへの転送 (結合していたバッファオブジェクトを含む) */
+        BufferData,
+        BufferSubData,
+        BindBufferBase,
+        BindBufferRange,
+        GenVertexArray,
+        DeleteVertexArray,
+        BindVertexArray,
+        /** 頂点属性の設定 (結合していたバッファオブジェクトを含む) */
+        VertexAttribPointer,
+        EnableVertexAttribArray,
+        GenTexture,
+        DeleteTexture,
+        ActiveTexture,
+        BindTexture,
+        /** バッファテクスチャへのバッファオブジェクトの割り当て */
+        TexBuffer,
+        /** シェーダのソースプログラムからのプログラムオブジェクトの作成 */
+        CreateProgram,
+        DeleteProgram,
+        UseProgram,
+        GetUniformLocation,
+        GetUniformBlockIndex,
+        UniformBlockBinding,
+        Uniform1i,
+        Uniform1f,
+        Uniform3fv,
+        Uniform4fv,
+        UniformMatrix3fv,
+        UniformMatrix4fv,
+        Enable,
+        Disable,
+        FrontFace,
+        CullFace,
+        DepthFunc,
+        ClearDepth,
+        ClearColor,
+        Clear,
+        Viewport,
+        PrimitiveRestartIndex,
+        DrawArrays,
+        DrawElements
+    };
+
+    /** 命令の数 */
+    static constexpr int commands = static_cast<int>(Command::DrawElements) + 1;
+
+    /** ファイルの先頭の識別子 ("GLTR") */
+    static constexpr std::uint32_t magic = 0x52544c47u;
+
+    /** ファイルの形式の版 */
+    static constexpr std::uint32_t version = 2;
+
+private:
+    /** 以下の変数を保護する */
+    std::mutex mutex;
+
+    /** 記録している */
+    std::atomic<bool> recording;
+
+    /** 書き出すファイル */
+    std::FILE* file;
+
+    /** ファイルに書き出す前の命令 */
+    std::vector<char> buffer;
+
+    /** 終わったフレームの数 */
+    unsigned long frames;
+
+    /** 描画を記録する最初のフレーム */
+    unsigned long first;
+
+    /** 記録を終えるフレーム */
+    unsigned long last;
+
+    /** 記録したバイト数 */
+    unsigned long long bytes;
+
+    /**
+     * 記録する前のフレームで最後のものだけを残す命令
+     */
+    struct Pending
+    {
+        /** 命令を受け取った順番 */
+        unsigned long long sequence;
+        /** 命令と引数 */
+        std::vector<char> command;
+    };
+
+    /** 転送 (0, バッファオブジェクト, 位置, 大きさ) か uniform 変数 (1, プログラム, 場所, 命令) */
+    using PendingKey = std::tuple<std::uint32_t, std::uint32_t, std::uint64_t, std::uint64_t>;
+
+    /** 記録する前のフレームで最後のものだけを残す命令 */
+    std::map<PendingKey, Pending> pending;
+
+    /** pending に加えた命令の数 */
+    unsigned long long sequence;
+
+    /** 記録する前のフレームで使用中のプログラムオブジェクト */
+    GLuint program;
+
+    /** 記録する前のフレームでまだ書き出していない頂点配列オブジェクトの結合 */
+    GLuint array;
+
+    /** array を書き出していない */
+    bool arrayPending;
+
+    GlTrace() :
+        recording(false), file(NULL), frames(0), first(0), last(0), bytes(0), sequence(0),
+        program(0), array(0), arrayPending(false)
+    {
+    }
+
+public:
+    /** プロセスで共有する記録を返す */
+    static GlTrace& get()
+    {
+        static GlTrace trace;
+        return trace;
+    }
+
+    virtual ~GlTrace()
+    {
+        close();
+    }
+
+    /** 命令の名前を返す */
+    static const char* getName(Command command)
+    {
+        static const char* const names[commands] = {"Begin",
+                                                     "Frame",
+                                                     "GenBuffer",
+                                                     "DeleteBuffer",
+                                                     "BindBuffer",
+                                                     "BufferData",
+                                                     "BufferSubData",
+                                                     "BindBufferBase",
+                                                     "BindBufferRange",
+                                                     "GenVertexArray",
+                                                     "DeleteVertexArray",
+                                                     "BindVertexArray",
+                                                     "VertexAttribPointer",
+                                                     "EnableVertexAttribArray",
+                                                     "GenTexture",
+                                                     "DeleteTexture",
+                                                     "ActiveTexture",
+                                                     "BindTexture",
+                                                     "TexBuffer",
+                                                     "CreateProgram",
+                                                     "DeleteProgram",
+                                                     "UseProgram",
+                                                     "GetUniformLocation",
+                                                     "GetUniformBlockIndex",
+                                                     "UniformBlockBinding",
+                                                     "Uniform1i",
+                                                     "Uniform1f",
+                                                     "Uniform3fv",
+                                                     "Uniform4fv",
+                                                     "UniformMatrix3fv",
+                                                     "UniformMatrix4fv",
+                                                     "Enable",
+                                                     "Disable",
+                                                     "FrontFace",
+                                                     "CullFace",
+                                                     "DepthFunc",
+                                                     "ClearDepth",
+                                                     "ClearColor",
+                                                     "Clear",
+                                                     "Viewport",
+                                                     "PrimitiveRestartIndex",
+                                                     "DrawArrays",
+                                                     "DrawElements"};
+        return names[static_cast<int>(command)];
+    }
+
+    /**
+     * @brief 記録を始める (OpenGL の資源を作る前に呼び出す)
+     *
+     * @param name 書き出すファイル名
+     * @param first 描画を記録する最初のフレーム
+     * @param count 記録するフレームの数
+     * @return true 記録を始めた
+     * @return false ファイルを開けなかった
+     */
+    bool open(const std::string& name, unsigned long first, unsigned long count)
+    {
+        close();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        file = std::fopen(name.c_str(), "wb");
+        if (file == NULL)
+        {
+            std::cerr << "Failed to open file: " << name << std::endl;
+            return false;
+        }
+
+        this->first = first;
+        last        = first + (count > 0 ? count : 1);
+        frames      = 0;
+        bytes       = 0;
+        buffer.clear();
+        pending.clear();
+        program      = 0;
+        arrayPending = false;
+        put(magic);
+        put(version);
+        put(static_cast<std::uint32_t>(first));
+        put(static_cast<std::uint32_t>(last - first));
+        if (first == 0)
+            put(Command::Begin);
+        recording.store(true);
+        return true;
+    }
+
+    /** 記録を終えてファイルを閉じる */
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (file == NULL)
+            return;
+
+        recording.store(false);
+        flush();
+        std::fclose(file);
+        file = NULL;
+        pending.clear();
+        const unsigned long recorded(frames > first ? std::min(frames, last) - first : 0);
+        std::cout << "trace: " << recorded << " frames from frame " << first << ", " << bytes
+                  << " bytes" << std::endl;
+    }
+
+    /** 記録しているかを返す */
+    bool isRecording() const
+    {
+        return recording.load(std::memory_order_relaxed);
+    }
+
+    /** フレームの終わりを記録する (描画のループでフレームごとに呼び出す) */
+    void endFrame()
+    {
+        if (!isRecording())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (frames >= first)
+                put(Command::Frame);
+            ++frames;
+            if (frames == first)
+            {
+                putPending();
+                put(Command::Begin);
+            }
+            flush();
+            if (frames < last)
+                return;
+        }
+        close();
+    }
+
+    //
+    // OpenGL の関数の代わりに呼び出す関数
+    //
+
+    static void genBuffers(GLsizei n, GLuint* buffers)
+    {
+        glGenBuffers(n, buffers);
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            get().record(Command::GenBuffer, buffers[i]);
+        }
+    }
+
+    static void deleteBuffers(GLsizei n, const GLuint* buffers)
+    {
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            get().record(Command::DeleteBuffer, buffers[i]);
+        }
+        glDeleteBuffers(n, buffers);
+    }
+
+    static void bindBuffer(GLenum target, GLuint buffer)
+    {
+        glBindBuffer(target, buffer);
+        if (GLuint* const b = getBound(target))
+            *b = buffer;
+        get().record(Command::BindBuffer, target, buffer);
+    }
+
+    static void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        glBufferData(target, size, data, usage);
+        get().recordData(Command::BufferData, target, usage, size, data);
+    }
+
+    /** 永続的にマップする領域の確保 (再生では glBufferData() で確保する) */
+    static void bufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags)
+    {
+        glBufferStorage(target, size, data, flags);
+        get().recordData(Command::BufferData, target, GL_DYNAMIC_DRAW, size, data);
+    }
+
+    static void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        glBufferSubData(target, offset, size, data);
+        get().recordData(Command::BufferSubData, target, offset, size, data);
+    }
+
+    /**
+     * @brief マップした領域に書き込んだ内容を記録する (OpenGL の関数は呼び出さない)
+     *
+     * @param target バッファオブジェクトを結合した標的
+     * @param buffer バッファオブジェクト名 (結合していなくてもよい)
+     * @param offset 書き込んだ領域の先頭
+     * @param size 書き込んだバイト数
+     * @param data 書き込んだ内容
+     */
+    static void mappedData(
+        GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        GlTrace& trace(get());
+        if (!trace.isRecording())
+            return;
+
+        std::lock_guard<std::mutex> lock(trace.mutex);
+        if (!trace.accept(Command::BufferSubData))
+            return;
+
+        const std::size_t start(trace.buffer.size());
+        trace.put(Command::BufferSubData);
+        trace.put(static_cast<std::uint32_t>(target));
+        trace.put(static_cast<std::uint32_t>(buffer));
+        trace.put(static_cast<std::uint64_t>(offset));
+        trace.putData(data, size);
+        trace.coalesce(start);
+    }
+
+    static void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        glBindBufferBase(target, index, buffer);
+        get().record(Command::BindBufferBase, target, index, buffer);
+    }
+
+    static void bindBufferRange(
+        GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+    {
+        glBindBufferRange(target, index, buffer, offset, size);
+        get().record(Command::BindBufferRange,
+                     target,
+                     index,
+                     buffer,
+                     static_cast<std::uint64_t>(offset),
+                     static_cast<std::uint64_t>(size));
+    }
+
+    static void genVertexArrays(GLsizei n, GLuint* arrays)
+    {
+        glGenVertexArrays(n, arrays);
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            get().record(Command::GenVertexArray, arrays[i]);
+        }
+    }
+
+    static void deleteVertexArrays(GLsizei n, const GLuint* arrays)
+    {
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            get().record(Command::DeleteVertexArray, arrays[i]);
+        }
+        glDeleteVertexArrays(n, arrays);
+    }
+
+    static void bindVertexArray(GLuint array)
+    {
+        glBindVertexArray(array);
+        get().record(Command::BindVertexArray, array);
+    }
+
+    static void vertexAttribPointer(GLuint index,
+                                    GLint size,
+                                    GLenum type,
+                                    GLboolean normalized,
+                                    GLsizei stride,
+                                    const void* pointer)
+    {
+        glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+        const GLuint* const b(getBound(GL_ARRAY_BUFFER));
+        get().record(Command::VertexAttribPointer,
+                     *b,
+                     index,
+                     size,
+                     type,
+                     static_cast<std::uint32_t>(normalized),
+                     stride,
+                     static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(pointer)));
+    }
+
+    static void enableVertexAttribArray(GLuint index)
+    {
+        glEnableVertexAttribArray(index);
+        get().record(Command::EnableVertexAttribArray, index);
+    }
+
+    static void genTextures(GLsizei n, GLuint* textures)
+    {
+        glGenTextures(n, textures);
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            get().record(Command::GenTexture, textures[i]);
+        }
+    }
+
+    static void deleteTextures(GLsizei n, const GLuint* textures)
+    {
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            get().record(Command::DeleteTexture, textures[i]);
+        }
+        glDeleteTextures(n, textures);
+    }
+
+    static void activeTexture(GLenum texture)
+    {
+        glActiveTexture(texture);
+        get().record(Command::ActiveTexture, texture);
+    }
+
+    static void bindTexture(GLenum target, GLuint texture)
+    {
+        glBindTexture(target, texture);
+        get().record(Command::BindTexture, target, texture);
+    }
+
+    static void texBuffer(GLenum target, GLenum internalformat, GLuint buffer)
+    {
+        glTexBuffer(target, internalformat, buffer);
+        get().record(Command::TexBuffer, target, internalformat, buffer);
+    }
+
+    /**
+     * @brief createProgram() で作ったプログラムオブジェクトを記録する (OpenGL の関数は呼び出さない)
+     *
+     * @param program プログラムオブジェクト名
+     * @param vsrc バーテックスシェーダのソースプログラム
+     * @param fsrc フラグメントシェーダのソースプログラム
+     */
+    static void createProgram(GLuint program, const std::string& vsrc, const std::string& fsrc)
+    {
+        GlTrace& trace(get());
+        if (!trace.isRecording())
+            return;
+
+        std::lock_guard<std::mutex> lock(trace.mutex);
+        if (!trace.accept(Command::CreateProgram))
+            return;
+
+        const std::size_t start(trace.buffer.size());
+        trace.put(Command::CreateProgram);
+        trace.put(static_cast<std::uint32_t>(program));
+        trace.putData(vsrc.data(), vsrc.size());
+        trace.putData(fsrc.data(), fsrc.size());
+        trace.coalesce(start);
+    }
+
+    static void deleteProgram(GLuint program)
+    {
+        get().record(Command::DeleteProgram, program);
+        glDeleteProgram(program);
+    }
+
+    static void useProgram(GLuint program)
+    {
+        glUseProgram(program);
+        get().record(Command::UseProgram, program);
+    }
+
+    static GLint getUniformLocation(GLuint program, const GLchar* name)
+    {
+        const GLint location(glGetUniformLocation(program, name));
+        get().recordName(Command::GetUniformLocation, program, location, name);
+        return location;
+    }
+
+    static GLuint getUniformBlockIndex(GLuint program, const GLchar* name)
+    {
+        const GLuint index(glGetUniformBlockIndex(program, name));
+        get().recordName(Command::GetUniformBlockIndex, program, index, name);
+        return index;
+    }
+
+    static void uniformBlockBinding(GLuint program, GLuint index, GLuint binding)
+    {
+        glUniformBlockBinding(program, index, binding);
+        get().record(Command::UniformBlockBinding, program, index, binding);
+    }
+
+    static void uniform1i(GLint location, GLint v)
+    {
+        glUniform1i(location, v);
+        get().record(Command::Uniform1i, location, v);
+    }
+
+    static void uniform1f(GLint location, GLfloat v)
+    {
+        glUniform1f(location, v);
+        get().record(Command::Uniform1f, location, v);
+    }
+
+    static void uniform3fv(GLint location, GLsizei count, const GLfloat* v)
+    {
+        glUniform3fv(location, count, v);
+        get().recordArray(Command::Uniform3fv, location, v, count * 3);
+    }
+
+    static void uniform4fv(GLint location, GLsizei count, const GLfloat* v)
+    {
+        glUniform4fv(location, count, v);
+        get().recordArray(Command::Uniform4fv, location, v, count * 4);
+    }
+
+    static void uniformMatrix3fv(GLint location,
+                                 GLsizei count,
+                                 GLboolean transpose,
+                                 const GLfloat* v)
+    {
+        glUniformMatrix3fv(location, count, transpose, v);
+        get().recordArray(Command::UniformMatrix3fv, location, v, count * 9, transpose);
+    }
+
+    static void uniformMatrix4fv(GLint location,
+                                 GLsizei count,
+                                 GLboolean transpose,
+                                 const GLfloat* v)
+    {
+        glUniformMatrix4fv(location, count, transpose, v);
+        get().recordArray(Command::UniformMatrix4fv, location, v, count * 16, transpose);
+    }
+
+    static void enable(GLenum cap)
+    {
+        glEnable(cap);
+        get().record(Command::Enable, cap);
+    }
+
+    static void disable(GLenum cap)
+    {
+        glDisable(cap);
+        get().record(Command::Disable, cap);
+    }
+
+    static void frontFace(GLenum mode)
+    {
+        glFrontFace(mode);
+        get().record(Command::FrontFace, mode);
+    }
+
+    static void cullFace(GLenum mode)
+    {
+        glCullFace(mode);
+        get().record(Command::CullFace, mode);
+    }
+
+    static void depthFunc(GLenum func)
+    {
+        glDepthFunc(func);
+        get().record(Command::DepthFunc, func);
+    }
+
+    static void clearDepth(GLdouble depth)
+    {
+        glClearDepth(depth);
+        get().record(Command::ClearDepth, depth);
+    }
+
+    static void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+    {
+        glClearColor(r, g, b, a);
+        get().record(Command::ClearColor, r, g, b, a);
+    }
+
+    static void clear(GLbitfield mask)
+    {
+        glClear(mask);
+        get().record(Command::Clear, mask);
+    }
+
+    static void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        glViewport(x, y, width, height);
+        get().record(Command::Viewport, x, y, width, height);
+    }
+
+    static void primitiveRestartIndex(GLuint index)
+    {
+        glPrimitiveRestartIndex(index);
+        get().record(Command::PrimitiveRestartIndex, index);
+    }
+
+    static void drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        glDrawArrays(mode, first, count);
+        get().record(Command::DrawArrays, mode, first, count);
+    }
+
+    static void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        glDrawElements(mode, count, type, indices);
+        get().record(Command::DrawElements,
+                     mode,
+                     count,
+                     type,
+                     static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(indices)));
+    }
+
+private:
+    /** このスレッドのコンテキストで標的に結合したバッファオブジェクトを返す (記録しないなら NULL) */
+    static GLuint* getBound(GLenum target)
+    {
+        thread_local GLuint bound[3] = {0, 0, 0};
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER:
+            return &bound[0];
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return &bound[1];
+        case GL_UNIFORM_BUFFER:
+            return &bound[2];
+        default:
+            return NULL;
+        }
+    }
+
+    /** 値をそのまま並べる */
+    template<typename T>
+    void put(const T& value)
+    {
+        const char* const p(reinterpret_cast<const char*>(&value));
+        buffer.insert(buffer.end(), p, p + sizeof value);
+    }
+
+    /** 長さを付けてデータを並べる */
+    void putData(const void* data, std::size_t size)
+    {
+        put(static_cast<std::uint32_t>(size));
+        if (data == NULL)
+        {
+            buffer.resize(buffer.size() + size, 0);
+            return;
+        }
+        const char* const p(static_cast<const char*>(data));
+        buffer.insert(buffer.end(), p, p + size);
+    }
+
+    /** 引数を並べる */
+    void putArgs() {}
+
+    template<typename T, typename... Args>
+    void putArgs(T value, Args... args)
+    {
+        put(value);
+        putArgs(args...);
+    }
+
+    /** 命令を記録するかどうか (mutex を確保して呼び出す) */
+    bool accept(Command command) const
+    {
+        // 閉じた後に届いた命令と、記録する前のフレームの描画とクリアは記録しない
+        if (file == NULL)
+            return false;
+        return frames >= first
+               || !(command == Command::Clear || command == Command::DrawArrays
+                    || command == Command::DrawElements);
+    }
+
+    /** 命令と固定長の引数を記録する */
+    template<typename... Args>
+    void record(Command command, Args... args)
+    {
+        if (!isRecording())
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!accept(command))
+            return;
+
+        const std::size_t start(buffer.size());
+        put(command);
+        putArgs(args...);
+        coalesce(start);
+    }
+
+    /** 結合したバッファオブジェクトへの転送を記録する */
+    void recordData(
+        Command command, GLenum target, std::uint64_t param, GLsizeiptr size, const void* data)
+    {
+        if (!isRecording())
+            return;
+
+        const GLuint* const b(getBound(target));
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!accept(command))
+            return;
+
+        const std::size_t start(buffer.size());
+        put(command);
+        put(static_cast<std::uint32_t>(target));
+        put(static_cast<std::uint32_t>(b != NULL ? *b : 0));
+        put(param);
+        putData(data, size);
+        coalesce(start);
+    }
+
+    /** 名前で問い合わせた結果を記録する */
+    void recordName(Command command, GLuint program, GLint result, const GLchar* name)
+    {
+        if (!isRecording())
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!accept(command))
+            return;
+
+        const std::size_t start(buffer.size());
+        put(command);
+        put(program);
+        put(result);
+        putData(name, std::strlen(name));
+        coalesce(start);
+    }
+
+    /** uniform 変数に設定する配列を記録する */
+    void recordArray(Command command,
+                     GLint location,
+                     const GLfloat* v,
+                     GLsizei n,
+                     GLboolean transpose = GL_FALSE)
+    {
+        if (!isRecording())
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!accept(command))
+            return;
+
+        const std::size_t start(buffer.size());
+        put(command);
+        put(location);
+        put(static_cast<std::uint8_t>(transpose));
+        putData(v, n * sizeof(GLfloat));
+        coalesce(start);
+    }
+
+    /** start に並べた命令の offset バイト目の値を読み返す */
+    template<typename T>
+    T getArg(std::size_t start, std::size_t offset) const
+    {
+        T value;
+        std::memcpy(&value, &buffer[start + offset], sizeof value);
+        return value;
+    }
+
+    /** 取っておいた命令を捨てる (kind と name が同じもの) */
+    void erasePending(std::uint32_t kind, std::uint32_t name)
+    {
+        pending.erase(pending.lower_bound(PendingKey(kind, name, 0, 0)),
+                      pending.lower_bound(PendingKey(kind, name + 1, 0, 0)));
+    }
+
+    /**
+     * @brief 記録する前のフレームの命令をまとめる (mutex を確保し、start から命令を並べて呼び出す)
+     *
+     * 頂点配列オブジェクトに関わらないバッファオブジェクトの範囲への転送と uniform 変数への設定は
+     * 同じ対象への最後のものだけを残せばよいので、ファイルには並べずに pending に取っておく。
+     * 頂点配列オブジェクトの結合は次にファイルに並べる命令の直前まで遅らせる。
+     * 確保しなおしたバッファオブジェクトと削除したプログラムオブジェクトの分は捨てる。
+     */
+    void coalesce(std::size_t start)
+    {
+        if (frames >= first)
+            return;
+
+        const Command command(static_cast<Command>(buffer[start]));
+        const std::uint32_t name(getArg<std::uint32_t>(start, 1));
+        PendingKey key;
+        bool deferred(false);
+        switch (command)
+        {
+        case Command::BindVertexArray:
+            array        = name;
+            arrayPending = true;
+            buffer.resize(start);
+            return;
+        case Command::BufferSubData:
+            // 要素の配列への転送は再生で頂点配列オブジェクトの結合を変えるので残す
+            deferred = name != GL_ELEMENT_ARRAY_BUFFER;
+            key      = PendingKey(0,
+                                  getArg<std::uint32_t>(start, 5),
+                                  getArg<std::uint64_t>(start, 9),
+                                  getArg<std::uint32_t>(start, 17));
+            break;
+        case Command::Uniform1i:
+        case Command::Uniform1f:
+        case Command::Uniform3fv:
+        case Command::Uniform4fv:
+        case Command::UniformMatrix3fv:
+        case Command::UniformMatrix4fv:
+            deferred = true;
+            key      = PendingKey(1, program, name, static_cast<std::uint64_t>(command));
+            break;
+        case Command::UseProgram:
+            program = name;
+            break;
+        case Command::DeleteProgram:
+            erasePending(1, name);
+            break;
+        case Command::BufferData:
+            erasePending(0, getArg<std::uint32_t>(start, 5));
+            break;
+        case Command::DeleteBuffer:
+            erasePending(0, name);
+            break;
+        default:
+            break;
+        }
+
+        if (deferred)
+        {
+            Pending& p(pending[key]);
+            p.sequence = ++sequence;
+            p.command.assign(buffer.begin() + start, buffer.end());
+            buffer.resize(start);
+            return;
+        }
+
+        // ファイルに並べる命令の前に遅らせた結合を入れる
+        if (arrayPending)
+        {
+            char bind[1 + sizeof array];
+            bind[0] = static_cast<char>(Command::BindVertexArray);
+            std::memcpy(bind + 1, &array, sizeof array);
+            buffer.insert(buffer.begin() + start, bind, bind + sizeof bind);
+            arrayPending = false;
+        }
+    }
+
+    /** 取っておいた命令を受け取った順に並べ、変わった結合を記録を始める前の状態に戻す */
+    void putPending()
+    {
+        std::vector<const std::pair<const PendingKey, Pending>*> order;
+        order.reserve(pending.size());
+        for (const auto& p : pending)
+        {
+            order.push_back(&p);
+        }
+        std::sort(order.begin(), order.end(), [](const auto* a, const auto* b) {
+            return a->second.sequence < b->second.sequence;
+        });
+
+        // uniform 変数はそれを持つプログラムオブジェクトを使用してから設定する
+        GLuint used(program);
+        for (const auto* p : order)
+        {
+            const GLuint owner(std::get<1>(p->first));
+            if (std::get<0>(p->first) == 1 && owner != used)
+            {
+                put(Command::UseProgram);
+                put(owner);
+                used = owner;
+            }
+            buffer.insert(buffer.end(), p->second.command.begin(), p->second.command.end());
+        }
+        if (used != program)
+        {
+            put(Command::UseProgram);
+            put(program);
+        }
+        pending.clear();
+
+        // 再生では転送のたびにバッファオブジェクトを結合しなおすので元に戻す
+        for (GLenum target : {GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER})
+        {
+            put(Command::BindBuffer);
+            put(static_cast<std::uint32_t>(target));
+            put(static_cast<std::uint32_t>(*getBound(target)));
+        }
+        if (arrayPending)
+        {
+            put(Command::BindVertexArray);
+            put(array);
+            arrayPending = false;
+        }
+    }
+
+    /** 溜めた命令をファイルに書き出す */
+    void flush()
+    {
+        if (file != NULL && !buffer.empty())
+            std::fwrite(buffer.data(), 1, buffer.size(), file);
+        bytes += buffer.size();
+        buffer.clear();
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    GlTrace(const GlTrace& t);
+
+    /** 代入によるコピー禁止 */
+    GlTrace& operator=(const GlTrace& t);
+};
@@ -0,0 +1,233 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/**
+ * 画像ファイルの書き出し
+ */
+namespace Image
+{
+    /** PNG の CRC を更新する */
+    inline std::uint32_t crc32(std::uint32_t crc, const unsigned char* data, std::size_t size)
+    {
+        static const struct Table
+        {
+            std::uint32_t value[256];
+
+            Table()
+            {
+                for (std::uint32_t n = 0; n < 256; ++n)
+                {
+                    std::uint32_t c(n);
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    }
+                    value[n] = c;
+                }
+            }
+        } table;
+
+        crc = ~crc;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            crc = table.value[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    /** zlib の Adler-32 を更新する */
+    inline std::uint32_t adler32(std::uint32_t adler, const unsigned char* data, std::size_t size)
+    {
+        std::uint32_t a(adler & 0xffff), b(adler >> 16);
+        while (size > 0)
+        {
+            // 桁あふれしない範囲でまとめて足してから剰余を取る
+            const std::size_t n(size < 5552 ? size : 5552);
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                a += data[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            data += n;
+            size -= n;
+        }
+        return (b << 16) | a;
+    }
+
+    /**
+     * PNG のチャンクを CRC を求めながら書き出すクラス
+     */
+    class Chunk
+    {
+        /** 書き出し先 */
+        std::FILE* const file;
+
+        /** CRC */
+        std::uint32_t crc;
+
+    public:
+        /**
+         * @brief チャンクの長さと種類を書き出す
+         *
+         * @param file 書き出し先
+         * @param type チャンクの種類
+         * @param length チャンクのデータの長さ
+         */
+        Chunk(std::FILE* file, const char* type, std::uint32_t length) : file(file), crc(0)
+        {
+            writeBE(length, false);
+            write(reinterpret_cast<const unsigned char*>(type), 4);
+        }
+
+        /** CRC を書き出す */
+        ~Chunk()
+        {
+            writeBE(crc, false);
+        }
+
+        /** データを書き出す */
+        void write(const unsigned char* data, std::size_t size)
+        {
+            crc = crc32(crc, data, size);
+            std::fwrite(data, 1, size, file);
+        }
+
+        /** 32bit の値をビッグエンディアンで書き出す */
+        void writeBE(std::uint32_t value, bool checksum = true)
+        {
+            const unsigned char b[] = {static_cast<unsigned char>(value >> 24),
+                                       static_cast<unsigned char>(value >> 16),
+                                       static_cast<unsigned char>(value >> 8),
+                                       static_cast<unsigned char>(value)};
+            if (checksum)
+                write(b, 4);
+            else
+                std::fwrite(b, 1, 4, file);
+        }
+    };
+
+    /**
+     * @brief RGBA の画素を無圧縮の PNG ファイルに書き出す
+     *
+     * 圧縮しない代わりに書き出しは速いので、連番の画像を出力するのに向いている
+     *
+     * @param name ファイル名
+     * @param width 画像の幅
+     * @param height 画像の高さ
+     * @param pixels RGBA の画素
+     * @param flip true なら下の行から順に格納されている (glReadPixels の並び)
+     * @return true 書き出せた
+     * @return false 書き出せなかった
+     */
+    inline bool writePng(const std::string& name,
+                         int width,
+                         int height,
+                         const unsigned char* pixels,
+                         bool flip = true)
+    {
+        std::FILE* const file(std::fopen(name.c_str(), "wb"));
+        if (file == NULL)
+            return false;
+
+        static const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        std::fwrite(signature, 1, sizeof signature, file);
+
+        // 8bit の RGBA
+        {
+            Chunk ihdr(file, "IHDR", 13);
+            ihdr.writeBE(static_cast<std::uint32_t>(width));
+            ihdr.writeBE(static_cast<std::uint32_t>(height));
+            static const unsigned char format[] = {8, 6, 0, 0, 0};
+            ihdr.write(format, sizeof format);
+        }
+
+        // 各行の先頭にフィルタの種類を置き、deflate の無圧縮ブロックに分けて格納する
+        const std::size_t stride(static_cast<std::size_t>(width) * 4);
+        const std::size_t raw((stride + 1) * height);
+        const std::size_t blocksize(65535);
+        const std::size_t blocks((raw + blocksize - 1) / blocksize);
+        {
+            Chunk idat(file, "IDAT", static_cast<std::uint32_t>(2 + raw + blocks * 5 + 4));
+            static const unsigned char zlib[] = {0x78, 0x01};
+            idat.write(zlib, sizeof zlib);
+
+            std::uint32_t adler(1);
+            std::size_t remaining(raw), column(0);
+            int row(0);
+            while (remaining > 0)
+            {
+                const std::size_t n(remaining < blocksize ? remaining : blocksize);
+                remaining -= n;
+                const unsigned char header[] = {static_cast<unsigned char>(remaining == 0),
+                                                static_cast<unsigned char>(n),
+                                                static_cast<unsigned char>(n >> 8),
+                                                static_cast<unsigned char>(~n),
+                                                static_cast<unsigned char>(~n >> 8)};
+                idat.write(header, sizeof header);
+
+                // ブロックの境界は行の途中にもなる
+                for (std::size_t left = n; left > 0;)
+                {
+                    const unsigned char* data;
+                    std::size_t size;
+                    static const unsigned char filter(0);
+                    if (column == 0)
+                    {
+                        data = &filter;
+                        size = 1;
+                    }
+                    else
+                    {
+                        const int y(flip ? height - 1 - row : row);
+                        data = pixels + y * stride + column - 1;
+                        size = stride + 1 - column < left ? stride + 1 - column : left;
+                    }
+                    idat.write(data, size);
+                    adler = adler32(adler, data, size);
+                    left -= size;
+                    column += size;
+                    if (column == stride + 1)
+                    {
+                        column = 0;
+                        ++row;
+                    }
+                }
+            }
+            idat.writeBE(adler);
+        }
+
+        {
+            Chunk iend(file, "IEND", 0);
+        }
+
+        return std::fclose(file) == 0;
+    }
+
+    /**
+     * @brief RGBA の画素をそのままファイルに書き出す
+     *
+     * @param name ファイル名
+     * @param width 画像の幅
+     * @param height 画像の高さ
+     * @param pixels RGBA の画素
+     * @return true 書き出せた
+     * @return false 書き出せなかった
+     */
+    inline bool writeRaw(const std::string& name,
+                         int width,
+                         int height,
+                         const unsigned char* pixels)
+    {
+        std::FILE* const file(std::fopen(name.c_str(), "wb"));
+        if (file == NULL)
+            return false;
+
+        std::fwrite(pixels, 4, static_cast<std::size_t>(width) * height, file);
+        return std::fclose(file) == 0;
+    }
+}  // namespace Image
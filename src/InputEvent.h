@@ -0,0 +1,37 @@
+#pragma once
+
+/**
+ * 入力イベント
+ */
+struct InputEvent
+{
+    /**
+     * イベントの種類
+     */
+    enum class Type
+    {
+        /** キーの操作 (key, action) */
+        Key,
+        /** マウスボタンの操作 (key にボタン, action) */
+        MouseButton,
+        /** マウスカーソルの移動 (x, y に正規化デバイス座標系上の位置) */
+        CursorPos,
+        /** マウスホイールの操作 (x, y にスクロール量) */
+        Scroll
+    };
+
+    /** イベントの種類 */
+    Type type;
+
+    /** キーまたはマウスボタン */
+    int key;
+
+    /** 押したか離したか */
+    int action;
+
+    /** イベントが発生した時刻 */
+    double time;
+
+    /** 位置またはスクロール量 */
+    double x, y;
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Matrix.h"
+
+/**
+ * 画面上の誤差から詳細度を選ぶクラス
+ *
+ * 詳細度ごとにインデックスの範囲と幾何学的な誤差 (モデル座標系の長さ) を持ち、
+ * 誤差を画面に投影した大きさが閾値を超えない最も粗い詳細度を選ぶ。
+ * 閾値の付近で詳細度が頻繁に切り替わらないように、粗くするときだけ閾値を下げる。
+ */
+class LevelOfDetail
+{
+public:
+    /**
+     * 一つの詳細度
+     */
+    struct Level
+    {
+        /** インデックスの先頭の位置 */
+        GLsizei first;
+        /** インデックスの要素数 */
+        GLsizei count;
+        /** 幾何学的な誤差 */
+        GLfloat error;
+    };
+
+private:
+    /** 詳細度 (細かい順) */
+    std::vector<Level> levels;
+
+    /** 図形の境界球の半径 */
+    GLfloat radius;
+
+    /** 許容する画面上の誤差 (ピクセル) */
+    GLfloat threshold;
+
+    /** 粗くするときに閾値を下げる割合 */
+    GLfloat hysteresis;
+
+public:
+    /**
+     * @brief Construct a new LevelOfDetail object
+     *
+     * @param radius 図形の境界球の半径
+     * @param threshold 許容する画面上の誤差 (ピクセル)
+     * @param hysteresis 粗くするときに閾値を下げる割合
+     */
+    LevelOfDetail(GLfloat radius = 1.0f, GLfloat threshold = 1.0f, GLfloat hysteresis = 0.25f) :
+        radius(radius), threshold(threshold), hysteresis(hysteresis)
+    {
+    }
+
+    /**
+     * @brief 詳細度を追加する (細かいものから順に追加する)
+     *
+     * @param first インデックスの先頭の位置
+     * @param count インデックスの要素数
+     * @param error 幾何学的な誤差
+     */
+    void add(GLsizei first, GLsizei count, GLfloat error)
+    {
+        levels.push_back({first, count, error});
+    }
+
+    /** 詳細度の数を返す */
+    GLsizei getLevels() const
+    {
+        return static_cast<GLsizei>(levels.size());
+    }
+
+    /** 詳細度を返す */
+    const Level& getLevel(GLsizei level) const
+    {
+        return levels[level];
+    }
+
+    /** 許容する画面上の誤差を設定する */
+    void setThreshold(GLfloat pixels)
+    {
+        threshold = pixels;
+    }
+
+    /**
+     * @brief モデル座標系の長さ 1 が画面上で何ピクセルになるかを求める
+     *
+     * 境界球の最も手前の点で求めるので、図形のどこでもこれより大きくなることはない
+     *
+     * @param modelView モデルビュー変換行列
+     * @param projection 投影変換行列
+     * @param height フレームバッファの高さ
+     * @return GLfloat ピクセル数 (視点が境界球の中にあれば負)
+     */
+    GLfloat getPixelsPerUnit(const Matrix& modelView, const Matrix& projection,
+                             GLsizei height) const
+    {
+        // モデルビュー変換の最大の拡大率
+        GLfloat scale(0.0f);
+        for (int c = 0; c < 3; ++c)
+        {
+            const GLfloat* const a(modelView.data() + c * 4);
+            scale = std::max(scale, a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+        }
+        scale = std::sqrt(scale);
+
+        // 正規化デバイス座標系の高さ 2 がフレームバッファの高さになる
+        const GLfloat pixels(projection[5] * static_cast<GLfloat>(height) * 0.5f * scale);
+
+        // 直交投影なら距離によらない
+        if (projection[15] != 0.0f)
+            return pixels;
+
+        const GLfloat distance(-modelView[14] - radius * scale);
+        return distance > 0.0f ? pixels / distance : -1.0f;
+    }
+
+    /**
+     * @brief 詳細度を選ぶ
+     *
+     * @param modelView モデルビュー変換行列
+     * @param projection 投影変換行列
+     * @param height フレームバッファの高さ
+     * @param previous 前のフレームで選んだ詳細度
+     * @return GLsizei 詳細度 (0 が最も細かい)
+     */
+    GLsizei select(const Matrix& modelView, const Matrix& projection, GLsizei height,
+                   GLsizei previous = 0) const
+    {
+        const GLfloat pixels(getPixelsPerUnit(modelView, projection, height));
+        if (pixels < 0.0f)
+            return 0;
+
+        // 粗いほうから順に閾値に収まるものを探す
+        for (GLsizei level = getLevels() - 1; level > 0; --level)
+        {
+            const GLfloat limit(level > previous ? threshold * (1.0f - hysteresis) : threshold);
+            if (levels[level].error * pixels <= limit)
+                return level;
+        }
+        return 0;
+    }
+};
@@ -0,0 +1,53 @@
+#pragma once
+#include "LevelOfDetail.h"
+#include "Shape.h"
+
+/**
+ * 詳細度ごとのインデックスの範囲を三角形で描画する
+ */
+class LodShape : public Shape
+{
+    /** 詳細度ごとのインデックスの範囲 */
+    const LevelOfDetail lod;
+
+public:
+    /**
+     * @brief Construct a new LodShape object
+     *
+     * @param size 頂点の位置の次元
+     * @param vertexcount 頂点の数
+     * @param vertex 頂点属性を格納した配列
+     * @param indexcount 頂点のインデックスの要素数
+     * @param index 全ての詳細度の頂点のインデックスを格納した配列
+     * @param lod 詳細度ごとのインデックスの範囲
+     */
+    LodShape(GLint size,
+             GLsizei vertexcount,
+             const Object::Vertex* vertex,
+             GLsizei indexcount,
+             const GLuint* index,
+             const LevelOfDetail& lod) :
+        Shape(size, vertexcount, vertex, indexcount, index), lod(lod)
+    {
+    }
+
+    /** 詳細度ごとのインデックスの範囲を返す */
+    const LevelOfDetail& getLod() const
+    {
+        return lod;
+    }
+
+    /** 描画の実行 (最も細かい詳細度) */
+    virtual void execute() const
+    {
+        executeLevel(0);
+    }
+
+    /** 詳細度を指定した描画の実行 */
+    virtual void executeLevel(GLsizei level) const
+    {
+        const LevelOfDetail::Level& l(lod.getLevel(std::min(level, lod.getLevels() - 1)));
+        const char* const offset(static_cast<const char*>(0) + l.first * sizeof(GLuint));
+        GlTrace::drawElements(GL_TRIANGLES, l.count, GL_UNSIGNED_INT, offset);
+    }
+};
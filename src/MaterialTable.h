@@ -0,0 +1,260 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include "GlTrace.h"
+#include "Material.h"
+#include "MemoryStats.h"
+
+/**
+ * 材質を詰めて並べた一つのバッファオブジェクト
+ *
+ * Material は std140 の配列と同じ 48 バイトおきに並ぶので、
+ * そのままユニフォームバッファオブジェクトの配列として使える。
+ * シェーダは描画ごとの材質の番号で配列を引くので、フレームごとに一度結合すればよい。
+ * uniform ブロックに収まらない数の材質はバッファテクスチャとして
+ * 一つの材質につき RGBA32F の 3 画素で読み出せる
+ * (Kamb, Kdiff, Kspec が rgb、Kshi が 3 画素目の a に入る)。
+ * point.vert と point.frag は textureDefine を差し込むとバッファテクスチャから材質を読む。
+ *
+ * 同じ値の材質は一つにまとめて同じ番号を返す。
+ * add() は OpenGL を使わないので、どのスレッドからでも呼び出せるが、
+ * bind() や bindTexture() と同時に呼び出してはいけない。
+ * 追加した材質は次の bind() か bindTexture() で転送する。
+ */
+class MaterialTable
+{
+    /** 材質の値を並べたもの */
+    using Key = std::array<std::uint32_t, 10>;
+
+    /** 材質の値のハッシュ関数 */
+    struct Hash
+    {
+        std::size_t operator()(const Key& key) const
+        {
+            std::uint64_t h(14695981039346656037ull);
+            for (std::uint32_t k : key)
+            {
+                h = (h ^ k) * 1099511628211ull;
+            }
+            return static_cast<std::size_t>(h ^ (h >> 32));
+        }
+    };
+
+    /** 材質 */
+    std::vector<Material> materials;
+
+    /** 材質の値から番号を引く表 */
+    std::unordered_map<Key, unsigned int, Hash> table;
+
+    /** 追加を要求された回数 */
+    unsigned long requested;
+
+    /** バッファオブジェクト名 (最初に使うときに作る) */
+    GLuint buffer;
+
+    /** バッファテクスチャ名 (最初に使うときに作る) */
+    GLuint texture;
+
+    /** バッファオブジェクトに確保した材質の数 */
+    GLsizei allocated;
+
+    /** バッファオブジェクトに転送した材質の数 */
+    GLsizei uploaded;
+
+public:
+    /** シェーダの uniform ブロックの配列の要素数 (point.vert と point.frag に合わせる) */
+    static constexpr GLsizei uniformCapacity = 256;
+
+    /** バッファテクスチャから材質を読むシェーダにするために差し込むマクロの定義 */
+    static constexpr const char* textureDefine = "#define MATERIAL_TEXTURE\n";
+
+    /**
+     * @brief Construct a new MaterialTable object
+     *
+     * @param data 材質を格納した配列
+     * @param count 材質の数
+     */
+    MaterialTable(const Material* data = NULL, unsigned int count = 0) :
+        requested(0), buffer(0), texture(0), allocated(0), uploaded(0)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            add(data[i]);
+        }
+    }
+
+    virtual ~MaterialTable()
+    {
+        if (texture != 0)
+            GlTrace::deleteTextures(1, &texture);
+        if (buffer != 0)
+        {
+            GlTrace::deleteBuffers(1, &buffer);
+            MemoryStats::get().release(MemoryStats::Category::UniformBuffer,
+                                       allocated * sizeof(Material));
+        }
+    }
+
+    /**
+     * @brief 材質を追加する
+     *
+     * @param material 材質
+     * @return unsigned int 材質の番号 (同じ値の材質があればその番号)
+     */
+    unsigned int add(const Material& material)
+    {
+        ++requested;
+        const auto result(
+            table.emplace(key(material), static_cast<unsigned int>(materials.size())));
+        if (result.second)
+            materials.push_back(material);
+        return result.first->second;
+    }
+
+    /** 材質の数を返す */
+    GLsizei size() const
+    {
+        return static_cast<GLsizei>(materials.size());
+    }
+
+    /** 材質を返す */
+    const Material* data() const
+    {
+        return materials.data();
+    }
+
+    /** まとめて取り除いた材質の数を返す */
+    unsigned long getDuplicates() const
+    {
+        return requested - materials.size();
+    }
+
+    /** uniform ブロックに収まらず、バッファテクスチャで読み出す必要があるか */
+    bool needsTexture() const
+    {
+        return size() > uniformCapacity;
+    }
+
+    /** バッファテクスチャで読み出せる材質の数の上限を返す (OpenGL のコンテキストが必要) */
+    static GLsizei getTextureCapacity()
+    {
+        GLint texels(0);
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+        return static_cast<GLsizei>(texels / 3);
+    }
+
+    /** 材質が使うバッファオブジェクトのバイト数を返す */
+    GLsizeiptr getBytes() const
+    {
+        return static_cast<GLsizeiptr>(materials.size() * sizeof(Material));
+    }
+
+    /**
+     * @brief uniform ブロックの配列として結合ポイントに結合する
+     *
+     * 先頭から uniformCapacity 個の材質を結合する。
+     * それより後の材質は uniform ブロックからは見えない。
+     *
+     * @param bp 結合ポイント
+     */
+    void bind(GLuint bp)
+    {
+        upload();
+        GlTrace::bindBufferRange(
+            GL_UNIFORM_BUFFER, bp, buffer, 0, uniformCapacity * sizeof(Material));
+    }
+
+    /**
+     * @brief バッファテクスチャとしてテクスチャユニットに結合する
+     *
+     * 全ての材質を結合する (textureDefine を差し込んだシェーダで読み出す)。
+     *
+     * @param unit テクスチャユニットの番号
+     */
+    void bindTexture(GLuint unit)
+    {
+        upload();
+        GlTrace::activeTexture(GL_TEXTURE0 + unit);
+        GlTrace::bindTexture(GL_TEXTURE_BUFFER, texture);
+        GlTrace::activeTexture(GL_TEXTURE0);
+    }
+
+private:
+    /** 材質の値を並べる (-0 と 0 は同じ値として扱う) */
+    static Key key(const Material& m)
+    {
+        const GLfloat value[] = {m.ambient[0],
+                                 m.ambient[1],
+                                 m.ambient[2],
+                                 m.diffuse[0],
+                                 m.diffuse[1],
+                                 m.diffuse[2],
+                                 m.specular[0],
+                                 m.specular[1],
+                                 m.specular[2],
+                                 m.shininess};
+        Key k;
+        for (int i = 0; i < 10; ++i)
+        {
+            const GLfloat x(value[i] == 0.0f ? 0.0f : value[i]);
+            std::memcpy(&k[i], &x, sizeof x);
+        }
+        return k;
+    }
+
+    /** 追加した材質をバッファオブジェクトに転送する */
+    void upload()
+    {
+        if (buffer == 0)
+        {
+            GlTrace::genBuffers(1, &buffer);
+            GlTrace::genTextures(1, &texture);
+        }
+
+        // uniform ブロックの大きさ以上を確保し、
+        // 足りなくなれば倍の大きさに確保しなおして全て転送する
+        const GLsizei count(size());
+        if (count > allocated || allocated == 0)
+        {
+            GLsizei capacity(std::max(allocated, uniformCapacity));
+            while (capacity < count)
+            {
+                capacity *= 2;
+            }
+            GlTrace::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+            GlTrace::bufferData(
+                GL_UNIFORM_BUFFER, capacity * sizeof(Material), NULL, GL_STATIC_DRAW);
+            MemoryStats& stats(MemoryStats::get());
+            if (allocated > 0)
+                stats.release(MemoryStats::Category::UniformBuffer, allocated * sizeof(Material));
+            stats.allocate(MemoryStats::Category::UniformBuffer, capacity * sizeof(Material));
+            allocated = capacity;
+            uploaded  = 0;
+
+            GlTrace::bindTexture(GL_TEXTURE_BUFFER, texture);
+            GlTrace::texBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+            GlTrace::bindTexture(GL_TEXTURE_BUFFER, 0);
+        }
+
+        if (uploaded < count)
+        {
+            GlTrace::bindBuffer(GL_UNIFORM_BUFFER, buffer);
+            GlTrace::bufferSubData(GL_UNIFORM_BUFFER,
+                                   uploaded * sizeof(Material),
+                                   (count - uploaded) * sizeof(Material),
+                                   materials.data() + uploaded);
+            uploaded = count;
+        }
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    MaterialTable(const MaterialTable& t);
+
+    /** 代入によるコピー禁止 */
+    MaterialTable& operator=(const MaterialTable& t);
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+/**
+ * コンパイル時にも評価できる数学関数
+ *
+ * 定数式として評価されるときは級数やニュートン法で求め、
+ * 実行時に呼び出されたときは標準ライブラリの関数を使う
+ */
+namespace Math
+{
+    /** 円周率 */
+    constexpr double pi = 3.14159265358979323846;
+
+    /** 定数式として評価されているか */
+    constexpr bool isConstantEvaluated()
+    {
+#if defined(__cpp_lib_is_constant_evaluated)
+        return std::is_constant_evaluated();
+#elif defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+        return __builtin_is_constant_evaluated();
+#else
+        // 判別できなければ常にコンパイル時と同じ方法で求める
+        return true;
+#endif
+    }
+
+    /** 平方根をニュートン法で求める */
+    constexpr double sqrtNewton(double x)
+    {
+        if (!(x > 0.0))
+            return x == 0.0 ? 0.0 : std::numeric_limits<double>::quiet_NaN();
+        if (x == std::numeric_limits<double>::infinity())
+            return x;
+
+        double r(x > 1.0 ? x : 1.0);
+        for (int i = 0; i < 1100; ++i)
+        {
+            const double next(0.5 * (r + x / r));
+            if (next >= r)
+                break;
+            r = next;
+        }
+        return r;
+    }
+
+    /** 正弦を [-π, π] に範囲を縮小してテイラー級数で求める */
+    constexpr double sinSeries(double x)
+    {
+        const double turns(x / (2.0 * pi));
+        const long long k(static_cast<long long>(turns + (turns < 0.0 ? -0.5 : 0.5)));
+        x -= static_cast<double>(k) * 2.0 * pi;
+
+        double term(x), sum(x);
+        for (int n = 1; n < 30; ++n)
+        {
+            term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+            sum += term;
+        }
+        return sum;
+    }
+
+    /** 平方根 */
+    constexpr float sqrt(float x)
+    {
+        return isConstantEvaluated() ? static_cast<float>(sqrtNewton(x)) : std::sqrt(x);
+    }
+
+    /** 正弦 */
+    constexpr float sin(float x)
+    {
+        return isConstantEvaluated() ? static_cast<float>(sinSeries(x)) : std::sin(x);
+    }
+
+    /** 余弦 */
+    constexpr float cos(float x)
+    {
+        return isConstantEvaluated() ? static_cast<float>(sinSeries(x + 0.5 * pi)) : std::cos(x);
+    }
+
+    /** 正接 */
+    constexpr float tan(float x)
+    {
+        return isConstantEvaluated() ? static_cast<float>(sinSeries(x) / sinSeries(x + 0.5 * pi))
+                                     : std::tan(x);
+    }
+}  // namespace Math
@@ -1,10 +1,12 @@
 #pragma once
-#include <gl/glew.h>
-#include <algorithm>
-#include <cmath>
+#include <GL/glew.h>
+#include <cstddef>
+#include "Math.h"
 
 /**
  * 変換行列のクラス
+ *
+ * 全ての操作は constexpr なので、定数の変換行列はコンパイル時に求めておける
  */
 class Matrix
 {
@@ -12,32 +14,35 @@ class Matrix
     GLfloat matrix[16];
 
 public:
-    Matrix() {}
+    constexpr Matrix() : matrix {} {}
 
     /**
      * @brief 配列の内容で初期化するコンストラクタ
      *
      * @param a GLfloat型の16要素の配列
      */
-    Matrix(const GLfloat* a)
+    constexpr Matrix(const GLfloat* a) : matrix {}
     {
-        std::copy(a, a + 16, matrix);
+        for (int i = 0; i < 16; i++)
+        {
+            matrix[i] = a[i];
+        }
     }
 
     /** 配列の要素を右辺値として参照する */
-    const GLfloat& operator[](std::size_t i) const
+    constexpr const GLfloat& operator[](std::size_t i) const
     {
         return matrix[i];
     }
 
     /** 配列の要素を左辺値として参照する */
-    GLfloat& operator[](std::size_t i)
+    constexpr GLfloat& operator[](std::size_t i)
     {
         return matrix[i];
     }
 
     /** 乗算 */
-    Matrix operator*(const Matrix& other) const
+    constexpr Matrix operator*(const Matrix& other) const
     {
         Matrix m;
         for (int i = 0; i < 16; i++)
@@ -51,20 +56,23 @@ public:
     }
 
     /** 変換行列の配列を返す */
-    const GLfloat* data() const
+    constexpr const GLfloat* data() const
     {
         return matrix;
     }
 
     /** 単位行列を設定する */
-    void loadIdentity()
+    constexpr void loadIdentity()
     {
-        std::fill(matrix, matrix + 16, 0.0f);
+        for (int i = 0; i < 16; i++)
+        {
+            matrix[i] = 0.0f;
+        }
         matrix[0] = matrix[5] = matrix[10] = matrix[15] = 1.0f;
     }
 
     /** 単位行列を作成する */
-    static Matrix identity()
+    static constexpr Matrix identity()
     {
         Matrix m;
         m.loadIdentity();
@@ -72,7 +80,7 @@ public:
     }
 
     /** (x, y, z)だけ平行移動する変換行列を作成する */
-    static Matrix translate(GLfloat x, GLfloat y, GLfloat z)
+    static constexpr Matrix translate(GLfloat x, GLfloat y, GLfloat z)
     {
         Matrix m;
         m.loadIdentity();
@@ -83,7 +91,7 @@ public:
     }
 
     /** (x, y, z)倍に拡大縮小する変換行列を作成する */
-    static Matrix scale(GLfloat x, GLfloat y, GLfloat z)
+    static constexpr Matrix scale(GLfloat x, GLfloat y, GLfloat z)
     {
         Matrix m;
         m.loadIdentity();
@@ -94,16 +102,16 @@ public:
     }
 
     /** (x, y, z)を軸に a 回転する変換行列を作成する */
-    static Matrix rotate(GLfloat a, GLfloat x, GLfloat y, GLfloat z)
+    static constexpr Matrix rotate(GLfloat a, GLfloat x, GLfloat y, GLfloat z)
     {
         Matrix mat;
-        const GLfloat d(sqrt(x * x + y * y + z * z));
+        const GLfloat d(Math::sqrt(x * x + y * y + z * z));
         if (d > 0.0f)
         {
             const GLfloat l(x / d), m(y / d), n(z / d);
             const GLfloat l2(l * l), m2(m * m), n2(n * n);
-            const GLfloat lm(l * m), mn(m * m), nl(n * l);
-            const GLfloat c(std::cos(a)), c1(1.0f - c), s(std::sin(a));
+            const GLfloat lm(l * m), mn(m * n), nl(n * l);
+            const GLfloat c(Math::cos(a)), c1(1.0f - c), s(Math::sin(a));
 
             mat.loadIdentity();
             mat[0]  = (1.0f - l2) * c + l2;
@@ -126,15 +134,15 @@ public:
      * @param gx, gy, gz 目標点の位置
      * @param ux, uy, uz 上方向のベクトル
      */
-    static Matrix lookAt(GLfloat ex,
-                         GLfloat ey,
-                         GLfloat ez,
-                         GLfloat gx,
-                         GLfloat gy,
-                         GLfloat gz,
-                         GLfloat ux,
-                         GLfloat uy,
-                         GLfloat uz)
+    static constexpr Matrix lookAt(GLfloat ex,
+                                   GLfloat ey,
+                                   GLfloat ez,
+                                   GLfloat gx,
+                                   GLfloat gy,
+                                   GLfloat gz,
+                                   GLfloat ux,
+                                   GLfloat uy,
+                                   GLfloat uz)
     {
         // 平行移動の変換行列
         const Matrix tv(translate(-ex, -ey, -ez));
@@ -160,17 +168,17 @@ public:
         Matrix rv;
         rv.loadIdentity();
         // r 軸を正規化して配列変数に格納
-        const GLfloat r(sqrt(rx * rx + ry * ry + rz * rz));
+        const GLfloat r(Math::sqrt(rx * rx + ry * ry + rz * rz));
         rv[0] = rx / r;
         rv[4] = ry / r;
         rv[8] = rz / r;
         // s 軸を正規化して配列変数に格納
-        const GLfloat s(sqrt(s2));
+        const GLfloat s(Math::sqrt(s2));
         rv[1] = sx / s;
         rv[5] = sy / s;
         rv[9] = sz / s;
         // t 軸を正規化して配列変数に格納
-        const GLfloat t(sqrt(tx * tx + ty * ty + tz * tz));
+        const GLfloat t(Math::sqrt(tx * tx + ty * ty + tz * tz));
         rv[2]  = tx / t;
         rv[6]  = ty / t;
         rv[10] = tz / t;
@@ -180,12 +188,12 @@ public:
     }
 
     /** 直交投影変換行列を作成する */
-    static Matrix orthogonal(GLfloat left,
-                             GLfloat right,
-                             GLfloat bottom,
-                             GLfloat top,
-                             GLfloat zNear,
-                             GLfloat zFar)
+    static constexpr Matrix orthogonal(GLfloat left,
+                                       GLfloat right,
+                                       GLfloat bottom,
+                                       GLfloat top,
+                                       GLfloat zNear,
+                                       GLfloat zFar)
     {
         Matrix m;
         const GLfloat dx(right - left);
@@ -207,12 +215,12 @@ public:
     }
 
     /** 透視投影変換行列を作成する */
-    static Matrix frustum(GLfloat left,
-                          GLfloat right,
-                          GLfloat bottom,
-                          GLfloat top,
-                          GLfloat zNear,
-                          GLfloat zFar)
+    static constexpr Matrix frustum(GLfloat left,
+                                    GLfloat right,
+                                    GLfloat bottom,
+                                    GLfloat top,
+                                    GLfloat zNear,
+                                    GLfloat zFar)
     {
         Matrix m;
         const GLfloat dx(right - left);
@@ -236,7 +244,7 @@ public:
     }
 
     /** 画角を指定して透視投影変換行列を作成する */
-    static Matrix perspective(GLfloat fovy, GLfloat aspect, GLfloat zNear, GLfloat zFar)
+    static constexpr Matrix perspective(GLfloat fovy, GLfloat aspect, GLfloat zNear, GLfloat zFar)
     {
         Matrix m;
         const GLfloat dz(zFar - zNear);
@@ -244,7 +252,7 @@ public:
         if (dz != 0.0f)
         {
             m.loadIdentity();
-            m[5]  = 1.0f / std::tan(fovy * 0.5f);
+            m[5]  = 1.0f / Math::tan(fovy * 0.5f);
             m[0]  = m[5] / aspect;
             m[10] = -(zFar + zNear) / dz;
             m[11] = -1.0f;
@@ -255,8 +263,199 @@ public:
         return m;
     }
 
+    /**
+     * @brief 逆行列を求める
+     *
+     * アフィン変換 (最下行が 0, 0, 0, 1) なら左上 3x3 の逆行列と平行移動だけを求める。
+     * 逆行列が存在しなければ零行列を返す。
+     */
+    constexpr Matrix inverse() const
+    {
+        Matrix m;
+        if (matrix[3] == 0.0f && matrix[7] == 0.0f && matrix[11] == 0.0f && matrix[15] == 1.0f)
+        {
+            // 左上 3x3 の余因子行列から逆行列を求める
+            GLfloat c[9] {};
+            getNormalMatrix(c);
+            const GLfloat det(matrix[0] * c[0] + matrix[1] * c[1] + matrix[2] * c[2]);
+            if (det == 0.0f)
+                return Matrix();
+
+            const GLfloat r(1.0f / det);
+            for (int i = 0; i < 3; ++i)
+            {
+                for (int j = 0; j < 3; ++j)
+                {
+                    m[j * 4 + i] = c[i * 3 + j] * r;
+                }
+            }
+
+            // 平行移動量は逆行列で移して符号を反転したもの
+            for (int i = 0; i < 3; ++i)
+            {
+                m[12 + i] = -(m[i] * matrix[12] + m[4 + i] * matrix[13] + m[8 + i] * matrix[14]);
+            }
+            m[3] = m[7] = m[11] = 0.0f;
+            m[15]               = 1.0f;
+            return m;
+        }
+
+        // 一般の 4x4 行列は余因子展開で求める
+        const GLfloat* a(matrix);
+        m[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15]
+               + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+        m[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15]
+               - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+        m[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15]
+               + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+        m[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14]
+                - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+        m[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15]
+               - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+        m[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15]
+               + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+        m[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15]
+               - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+        m[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14]
+                + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+        m[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15]
+               + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+        m[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15]
+               - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+        m[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15]
+                + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+        m[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14]
+                - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+        m[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11]
+               - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+        m[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11]
+               + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+        m[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11]
+                - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+        m[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10]
+                + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+        const GLfloat det(a[0] * m[0] + a[1] * m[4] + a[2] * m[8] + a[3] * m[12]);
+        const GLfloat r(det != 0.0f ? 1.0f / det : 0.0f);
+        for (int i = 0; i < 16; ++i)
+        {
+            m[i] *= r;
+        }
+        return m;
+    }
+
+    /**
+     * @brief 回転と平行移動だけからなる変換行列の逆行列を求める
+     *
+     * 左上 3x3 が直交行列であることを前提に、転置と平行移動の反転だけで求める
+     */
+    constexpr Matrix rigidInverse() const
+    {
+        Matrix m;
+        m[0]  = matrix[0];
+        m[1]  = matrix[4];
+        m[2]  = matrix[8];
+        m[3]  = 0.0f;
+        m[4]  = matrix[1];
+        m[5]  = matrix[5];
+        m[6]  = matrix[9];
+        m[7]  = 0.0f;
+        m[8]  = matrix[2];
+        m[9]  = matrix[6];
+        m[10] = matrix[10];
+        m[11] = 0.0f;
+        m[12] = -(matrix[0] * matrix[12] + matrix[1] * matrix[13] + matrix[2] * matrix[14]);
+        m[13] = -(matrix[4] * matrix[12] + matrix[5] * matrix[13] + matrix[6] * matrix[14]);
+        m[14] = -(matrix[8] * matrix[12] + matrix[9] * matrix[13] + matrix[10] * matrix[14]);
+        m[15] = 1.0f;
+        return m;
+    }
+
+    /**
+     * @brief 複数の変換行列の法線ベクトルの変換行列をまとめて求める
+     *
+     * 左上 3x3 の逆行列の転置を求める。getNormalMatrix() と違って行列式で割るので、
+     * 拡大縮小や鏡映を含んでいても向きと大きさが正しくなる。
+     * lanes 個ずつ要素ごとの配列 (SoA) に並べ替えてから同じ計算を並べて行うので、
+     * 内側のループはコンパイラが SIMD 命令にできる。
+     * 変換行列と法線ベクトルの変換行列は構造体のメンバでもいいように間隔をバイト数で指定する。
+     *
+     * @param matrices 最初の変換行列
+     * @param count 変換行列の数
+     * @param normals 最初の 3x3 の行列の格納先
+     * @param matrixStride 変換行列の間隔のバイト数
+     * @param normalStride 3x3 の行列の間隔のバイト数
+     */
+    static void getNormalMatrices(const Matrix* matrices,
+                                  std::size_t count,
+                                  GLfloat* normals,
+                                  std::size_t matrixStride = sizeof(Matrix),
+                                  std::size_t normalStride = 9 * sizeof(GLfloat))
+    {
+        constexpr std::size_t lanes = 8;
+        const char* source(reinterpret_cast<const char*>(matrices));
+        char* destination(reinterpret_cast<char*>(normals));
+        for (std::size_t k = 0; k < count; k += lanes)
+        {
+            const std::size_t n(count - k < lanes ? count - k : lanes);
+
+            // 左上 3x3 の要素を要素ごとに並べる (足りない分はこの組の最初の行列で埋める)
+            GLfloat a[9][lanes];
+            for (std::size_t l = 0; l < lanes; ++l)
+            {
+                const std::size_t j(k + (l < n ? l : 0));
+                const GLfloat* const m(
+                    reinterpret_cast<const Matrix*>(source + j * matrixStride)->matrix);
+                a[0][l] = m[0];
+                a[1][l] = m[1];
+                a[2][l] = m[2];
+                a[3][l] = m[4];
+                a[4][l] = m[5];
+                a[5][l] = m[6];
+                a[6][l] = m[8];
+                a[7][l] = m[9];
+                a[8][l] = m[10];
+            }
+
+            GLfloat b[9][lanes];
+            for (std::size_t l = 0; l < lanes; ++l)
+            {
+                const GLfloat c0(a[4][l] * a[8][l] - a[5][l] * a[7][l]);
+                const GLfloat c1(a[5][l] * a[6][l] - a[3][l] * a[8][l]);
+                const GLfloat c2(a[3][l] * a[7][l] - a[4][l] * a[6][l]);
+                const GLfloat det(a[0][l] * c0 + a[1][l] * c1 + a[2][l] * c2);
+                // 行列式が 0 なら割らない (分岐を避けて SIMD 命令にしやすくする)
+                const GLfloat r(1.0f / (det + static_cast<GLfloat>(det == 0.0f)));
+                b[0][l] = c0 * r;
+                b[1][l] = c1 * r;
+                b[2][l] = c2 * r;
+                b[3][l] = (a[7][l] * a[2][l] - a[8][l] * a[1][l]) * r;
+                b[4][l] = (a[8][l] * a[0][l] - a[6][l] * a[2][l]) * r;
+                b[5][l] = (a[6][l] * a[1][l] - a[7][l] * a[0][l]) * r;
+                b[6][l] = (a[1][l] * a[5][l] - a[2][l] * a[4][l]) * r;
+                b[7][l] = (a[2][l] * a[3][l] - a[0][l] * a[5][l]) * r;
+                b[8][l] = (a[0][l] * a[4][l] - a[1][l] * a[3][l]) * r;
+            }
+
+            for (std::size_t l = 0; l < n; ++l)
+            {
+                GLfloat* const m(
+                    reinterpret_cast<GLfloat*>(destination + (k + l) * normalStride));
+                m[0] = b[0][l];
+                m[1] = b[1][l];
+                m[2] = b[2][l];
+                m[3] = b[3][l];
+                m[4] = b[4][l];
+                m[5] = b[5][l];
+                m[6] = b[6][l];
+                m[7] = b[7][l];
+                m[8] = b[8][l];
+            }
+        }
+    }
+
     /** 法線ベクトルの変換行列を求める */
-    void getNormalMatrix(GLfloat* m) const
+    constexpr void getNormalMatrix(GLfloat* m) const
     {
         m[0] = matrix[5] * matrix[10] - matrix[6] * matrix[9];
         m[1] = matrix[6] * matrix[8] - matrix[4] * matrix[10];
@@ -0,0 +1,298 @@
+#pragma once
+#include <GL/glew.h>
+#include "Matrix.h"
+#include "Transform.h"
+
+/**
+ * 行列の積を遅延評価する式の基底クラス
+ *
+ * 積の連鎖を式の木として組み立てておき、Matrix に代入するときに
+ * 一つの行列の上で左から順に一度だけ評価する。平行移動・拡大縮小・回転・アフィン変換は
+ * その構造を利用して、4x4 の乗算よりも少ない計算で掛ける。
+ *
+ * 式は Matrix を参照で保持するので、式を評価するまで元の Matrix を破棄してはいけない。
+ *
+ * @tparam E 派生クラス
+ */
+template<typename E>
+class MatrixExpression
+{
+public:
+    /** 派生クラスとして参照する */
+    constexpr const E& self() const
+    {
+        return static_cast<const E&>(*this);
+    }
+
+    /** 式を評価する */
+    constexpr Matrix evaluate() const
+    {
+        Matrix m;
+        self().assign(m);
+        return m;
+    }
+
+    /** 式を評価して Matrix に変換する */
+    constexpr operator Matrix() const
+    {
+        return evaluate();
+    }
+};
+
+/**
+ * 行列の積の式
+ *
+ * @tparam L 左の式
+ * @tparam R 右の式
+ */
+template<typename L, typename R>
+class MatrixProduct : public MatrixExpression<MatrixProduct<L, R>>
+{
+    /** 左の式 */
+    const L left;
+
+    /** 右の式 */
+    const R right;
+
+public:
+    /** 最下行が 0, 0, 0, 1 のままか */
+    static constexpr bool affine = L::affine && R::affine;
+
+    constexpr MatrixProduct(const L& left, const R& right) : left(left), right(right) {}
+
+    /** 式の値を m に格納する */
+    constexpr void assign(Matrix& m) const
+    {
+        left.assign(m);
+        right.template multiply<L::affine>(m);
+    }
+
+    /**
+     * @brief m に右から式の値を掛ける
+     *
+     * @tparam Affine m の最下行が 0, 0, 0, 1 か
+     */
+    template<bool Affine>
+    constexpr void multiply(Matrix& m) const
+    {
+        left.template multiply<Affine>(m);
+        right.template multiply<Affine && L::affine>(m);
+    }
+};
+
+/**
+ * 平行移動の式
+ */
+class TranslateExpression : public MatrixExpression<TranslateExpression>
+{
+    /** 平行移動量 */
+    const GLfloat x, y, z;
+
+public:
+    static constexpr bool affine = true;
+
+    constexpr TranslateExpression(GLfloat x, GLfloat y, GLfloat z) : x(x), y(y), z(z) {}
+
+    constexpr void assign(Matrix& m) const
+    {
+        m = Matrix::translate(x, y, z);
+    }
+
+    /** 平行移動の列だけを更新する */
+    template<bool Affine>
+    constexpr void multiply(Matrix& m) const
+    {
+        for (int r = 0; r < (Affine ? 3 : 4); ++r)
+        {
+            m[12 + r] += m[r] * x + m[4 + r] * y + m[8 + r] * z;
+        }
+    }
+};
+
+/**
+ * 拡大縮小の式
+ */
+class ScaleExpression : public MatrixExpression<ScaleExpression>
+{
+    /** 拡大率 */
+    const GLfloat x, y, z;
+
+public:
+    static constexpr bool affine = true;
+
+    constexpr ScaleExpression(GLfloat x, GLfloat y, GLfloat z) : x(x), y(y), z(z) {}
+
+    constexpr void assign(Matrix& m) const
+    {
+        m = Matrix::scale(x, y, z);
+    }
+
+    /** 左の 3 列に拡大率を掛ける */
+    template<bool Affine>
+    constexpr void multiply(Matrix& m) const
+    {
+        for (int r = 0; r < (Affine ? 3 : 4); ++r)
+        {
+            m[r] *= x;
+            m[4 + r] *= y;
+            m[8 + r] *= z;
+        }
+    }
+};
+
+/**
+ * 左上 3x3 と平行移動で表した変換の式 (回転やアフィン変換行列に使う)
+ */
+class LinearExpression : public MatrixExpression<LinearExpression>
+{
+protected:
+    /** 左上 3x3 の要素 (列優先) */
+    GLfloat linear[9];
+
+    /** 平行移動量 */
+    GLfloat translation[3];
+
+public:
+    static constexpr bool affine = true;
+
+    /** アフィン変換行列から作成する */
+    constexpr LinearExpression(const Matrix& a) :
+        linear {a[0], a[1], a[2], a[4], a[5], a[6], a[8], a[9], a[10]},
+        translation {a[12], a[13], a[14]}
+    {
+    }
+
+    constexpr void assign(Matrix& m) const
+    {
+        m.loadIdentity();
+        for (int c = 0; c < 3; ++c)
+        {
+            m[c * 4 + 0] = linear[c * 3 + 0];
+            m[c * 4 + 1] = linear[c * 3 + 1];
+            m[c * 4 + 2] = linear[c * 3 + 2];
+            m[12 + c]    = translation[c];
+        }
+    }
+
+    /** 最下行が 0, 0, 0, 1 であることを利用して掛ける */
+    template<bool Affine>
+    constexpr void multiply(Matrix& m) const
+    {
+        for (int r = 0; r < (Affine ? 3 : 4); ++r)
+        {
+            const GLfloat a0(m[r]), a1(m[4 + r]), a2(m[8 + r]);
+            m[r]     = a0 * linear[0] + a1 * linear[1] + a2 * linear[2];
+            m[4 + r] = a0 * linear[3] + a1 * linear[4] + a2 * linear[5];
+            m[8 + r] = a0 * linear[6] + a1 * linear[7] + a2 * linear[8];
+            m[12 + r] += a0 * translation[0] + a1 * translation[1] + a2 * translation[2];
+        }
+    }
+};
+
+/**
+ * 一般の 4x4 行列の式
+ */
+class GeneralExpression : public MatrixExpression<GeneralExpression>
+{
+    /** 行列 */
+    const Matrix& matrix;
+
+public:
+    static constexpr bool affine = false;
+
+    constexpr GeneralExpression(const Matrix& matrix) : matrix(matrix) {}
+
+    constexpr void assign(Matrix& m) const
+    {
+        m = matrix;
+    }
+
+    /** m がアフィン変換なら最下行は matrix の最下行になる */
+    template<bool Affine>
+    constexpr void multiply(Matrix& m) const
+    {
+        for (int r = 0; r < (Affine ? 3 : 4); ++r)
+        {
+            const GLfloat a0(m[r]), a1(m[4 + r]), a2(m[8 + r]), a3(m[12 + r]);
+            for (int c = 0; c < 4; ++c)
+            {
+                m[c * 4 + r] = a0 * matrix[c * 4 + 0] + a1 * matrix[c * 4 + 1]
+                               + a2 * matrix[c * 4 + 2] + a3 * matrix[c * 4 + 3];
+            }
+        }
+        if (Affine)
+        {
+            m[3]  = matrix[3];
+            m[7]  = matrix[7];
+            m[11] = matrix[11];
+            m[15] = matrix[15];
+        }
+    }
+};
+
+/**
+ * 遅延評価する行列の式を作成するクラス
+ */
+class LazyMatrix
+{
+public:
+    /** (x, y, z)だけ平行移動する式を作成する */
+    static constexpr TranslateExpression translate(GLfloat x, GLfloat y, GLfloat z)
+    {
+        return TranslateExpression(x, y, z);
+    }
+
+    /** (x, y, z)倍に拡大縮小する式を作成する */
+    static constexpr ScaleExpression scale(GLfloat x, GLfloat y, GLfloat z)
+    {
+        return ScaleExpression(x, y, z);
+    }
+
+    /** (x, y, z)を軸に a 回転する式を作成する */
+    static constexpr LinearExpression rotate(GLfloat a, GLfloat x, GLfloat y, GLfloat z)
+    {
+        return LinearExpression(Matrix::rotate(a, x, y, z));
+    }
+
+    /** 最下行が 0, 0, 0, 1 の行列 (ビュー変換行列など) の式を作成する */
+    static constexpr LinearExpression affine(const Matrix& m)
+    {
+        return LinearExpression(m);
+    }
+
+    /** Transform の式を作成する */
+    static LinearExpression transform(const Transform& t)
+    {
+        return LinearExpression(t.getMatrix());
+    }
+
+    /** 構造のわからない行列の式を作成する (評価するまで m を破棄してはいけない) */
+    static constexpr GeneralExpression general(const Matrix& m)
+    {
+        return GeneralExpression(m);
+    }
+};
+
+/** 式の積 */
+template<typename L, typename R>
+constexpr MatrixProduct<L, R> operator*(const MatrixExpression<L>& left,
+                                        const MatrixExpression<R>& right)
+{
+    return MatrixProduct<L, R>(left.self(), right.self());
+}
+
+/** 行列と式の積 */
+template<typename R>
+constexpr MatrixProduct<GeneralExpression, R> operator*(const Matrix& left,
+                                                        const MatrixExpression<R>& right)
+{
+    return MatrixProduct<GeneralExpression, R>(GeneralExpression(left), right.self());
+}
+
+/** 式と行列の積 */
+template<typename L>
+constexpr MatrixProduct<L, GeneralExpression> operator*(const MatrixExpression<L>& left,
+                                                        const Matrix& right)
+{
+    return MatrixProduct<L, GeneralExpression>(left.self(), GeneralExpression(right));
+}
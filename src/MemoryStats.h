@@ -0,0 +1,297 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+
+/**
+ * バッファオブジェクトなどが使うメモリの量を種類ごとに集計するクラス
+ *
+ * 確保と解放のたびに allocate() と release() を呼び出してもらい、
+ * 現在の量と最大値 (ハイウォーターマーク) を種類ごとに保持する。
+ * GPU の資源には上限 (予算) を設定でき、超えたときは一度だけ警告を出す。
+ * 複数のスレッドから呼び出してよい。
+ */
+class MemoryStats
+{
+public:
+    /**
+     * 資源の種類
+     */
+    enum class Category
+    {
+        /** 頂点バッファオブジェクト */
+        VertexBuffer,
+        /** インデックスの頂点バッファオブジェクト */
+        IndexBuffer,
+        /** ユニフォームバッファオブジェクト */
+        UniformBuffer,
+        /** ピクセルバッファオブジェクト */
+        PixelBuffer,
+        /** 頂点配列オブジェクト (大きさは数えない) */
+        VertexArray,
+        /** プログラムオブジェクト (バイナリの大きさ) */
+        Program,
+        /** CPU に置いた頂点属性とインデックス */
+        Mesh,
+        /** CPU に置いたフレームバッファ */
+        Framebuffer,
+        /** フレームごとに使い回すアリーナ (FrameArena) */
+        FrameArena
+    };
+
+    /** 種類の数 */
+    static constexpr int categories = 9;
+
+private:
+    /**
+     * 一つの種類の集計
+     */
+    struct Counter
+    {
+        /** 現在のバイト数 */
+        std::atomic<std::size_t> bytes;
+        /** バイト数の最大値 */
+        std::atomic<std::size_t> peak;
+        /** 現在の資源の数 */
+        std::atomic<std::size_t> count;
+    };
+
+    /** 種類ごとの集計 */
+    Counter counters[categories];
+
+    /** GPU の資源の合計 */
+    Counter gpu;
+
+    /** CPU の資源の合計 */
+    Counter cpu;
+
+    /** GPU の資源の予算 (0 なら制限しない) */
+    std::atomic<std::size_t> budget;
+
+    /** 予算を超えている */
+    std::atomic<bool> exceeded;
+
+    /** 予算を超えた回数 */
+    std::atomic<unsigned long> warnings;
+
+    MemoryStats() : budget(0), exceeded(false), warnings(0)
+    {
+        for (Counter& c : counters)
+        {
+            reset(c);
+        }
+        reset(gpu);
+        reset(cpu);
+    }
+
+public:
+    /** プロセスで共有する集計を返す */
+    static MemoryStats& get()
+    {
+        static MemoryStats stats;
+        return stats;
+    }
+
+    /** 種類の名前を返す */
+    static const char* getName(Category category)
+    {
+        static const char* const names[categories] = {"vertex buffer",
+                                                      "index buffer",
+                                                      "uniform buffer",
+                                                      "pixel buffer",
+                                                      "vertex array",
+                                                      "program",
+                                                      "mesh (CPU)",
+                                                      "framebuffer (CPU)",
+                                                      "frame arena (CPU)"};
+        return names[static_cast<int>(category)];
+    }
+
+    /** GPU の資源かどうかを返す */
+    static bool isGpu(Category category)
+    {
+        return category != Category::Mesh && category != Category::Framebuffer
+               && category != Category::FrameArena;
+    }
+
+    /**
+     * @brief 資源の確保を記録する
+     *
+     * @param category 資源の種類
+     * @param bytes バイト数
+     */
+    void allocate(Category category, std::size_t bytes)
+    {
+        add(counters[static_cast<int>(category)], bytes);
+        const std::size_t total(add(isGpu(category) ? gpu : cpu, bytes));
+
+        // 予算を超えたときに一度だけ警告する
+        if (isGpu(category))
+            check(total, getName(category));
+    }
+
+    /**
+     * @brief 資源の解放を記録する
+     *
+     * @param category 資源の種類
+     * @param bytes 確保したときのバイト数
+     */
+    void release(Category category, std::size_t bytes)
+    {
+        remove(counters[static_cast<int>(category)], bytes);
+        const std::size_t total(remove(isGpu(category) ? gpu : cpu, bytes));
+
+        const std::size_t limit(budget.load(std::memory_order_relaxed));
+        if (isGpu(category) && (limit == 0 || total <= limit))
+            exceeded.store(false);
+    }
+
+    /**
+     * @brief GPU の資源の予算を設定する
+     *
+     * @param bytes 予算のバイト数 (0 なら制限しない)
+     */
+    void setBudget(std::size_t bytes)
+    {
+        budget.store(bytes);
+        exceeded.store(false);
+        check(getGpuBytes(), "budget");
+    }
+
+    /** GPU の資源の予算を返す (0 なら制限しない) */
+    std::size_t getBudget() const
+    {
+        return budget.load();
+    }
+
+    /**
+     * @brief GPU の資源をさらに確保しても予算に収まるかを調べる
+     *
+     * @param bytes これから確保するバイト数
+     * @return true 収まるか予算が設定されていない
+     */
+    bool fits(std::size_t bytes) const
+    {
+        const std::size_t limit(budget.load());
+        return limit == 0 || getGpuBytes() + bytes <= limit;
+    }
+
+    /** GPU の資源が予算を超えているかを返す */
+    bool isOverBudget() const
+    {
+        return exceeded.load();
+    }
+
+    /** 予算を超えた回数を返す */
+    unsigned long getWarnings() const
+    {
+        return warnings.load();
+    }
+
+    /** 種類ごとの現在のバイト数を返す */
+    std::size_t getBytes(Category category) const
+    {
+        return counters[static_cast<int>(category)].bytes.load();
+    }
+
+    /** 種類ごとのバイト数の最大値を返す */
+    std::size_t getPeak(Category category) const
+    {
+        return counters[static_cast<int>(category)].peak.load();
+    }
+
+    /** 種類ごとの現在の資源の数を返す */
+    std::size_t getCount(Category category) const
+    {
+        return counters[static_cast<int>(category)].count.load();
+    }
+
+    /** GPU の資源の現在のバイト数を返す */
+    std::size_t getGpuBytes() const
+    {
+        return gpu.bytes.load();
+    }
+
+    /** GPU の資源のバイト数の最大値を返す */
+    std::size_t getGpuPeak() const
+    {
+        return gpu.peak.load();
+    }
+
+    /** CPU の資源の現在のバイト数を返す */
+    std::size_t getCpuBytes() const
+    {
+        return cpu.bytes.load();
+    }
+
+    /** CPU の資源のバイト数の最大値を返す */
+    std::size_t getCpuPeak() const
+    {
+        return cpu.peak.load();
+    }
+
+    /** 種類ごとの内訳を表示する */
+    void print(std::ostream& os = std::cout) const
+    {
+        os << "memory: gpu=" << getGpuBytes() << "B peak=" << getGpuPeak()
+           << "B cpu=" << getCpuBytes() << "B peak=" << getCpuPeak() << "B";
+        if (getBudget() > 0)
+            os << " budget=" << getBudget() << "B warnings=" << getWarnings();
+        os << std::endl;
+        for (int i = 0; i < categories; ++i)
+        {
+            const Counter& c(counters[i]);
+            if (c.peak.load() == 0 && c.count.load() == 0)
+                continue;
+
+            os << "  " << getName(static_cast<Category>(i)) << ": n=" << c.count.load()
+               << " bytes=" << c.bytes.load() << " peak=" << c.peak.load() << std::endl;
+        }
+    }
+
+private:
+    /** GPU の資源の合計が予算を超えたら一度だけ警告する */
+    void check(std::size_t total, const char* cause)
+    {
+        const std::size_t limit(budget.load(std::memory_order_relaxed));
+        if (limit > 0 && total > limit && !exceeded.exchange(true))
+        {
+            ++warnings;
+            std::cerr << "warning: GPU memory " << total << " bytes exceeds budget " << limit
+                      << " bytes (" << cause << ")" << std::endl;
+        }
+    }
+
+    /** 集計を 0 にする */
+    static void reset(Counter& c)
+    {
+        c.bytes.store(0);
+        c.peak.store(0);
+        c.count.store(0);
+    }
+
+    /** 集計に加えて最大値を更新し、現在のバイト数を返す */
+    static std::size_t add(Counter& c, std::size_t bytes)
+    {
+        ++c.count;
+        const std::size_t total(c.bytes.fetch_add(bytes) + bytes);
+        std::size_t peak(c.peak.load());
+        while (total > peak && !c.peak.compare_exchange_weak(peak, total))
+        {
+        }
+        return total;
+    }
+
+    /** 集計から除いて現在のバイト数を返す */
+    static std::size_t remove(Counter& c, std::size_t bytes)
+    {
+        --c.count;
+        return c.bytes.fetch_sub(bytes) - bytes;
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    MemoryStats(const MemoryStats& m);
+
+    /** 代入によるコピー禁止 */
+    MemoryStats& operator=(const MemoryStats& m);
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <GL/glew.h>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Object.h"
+
+/**
+ * @brief Wavefront OBJ 形式のファイルから三角形の頂点属性を読み込む
+ *
+ * v (位置)、vn (法線)、f (面) だけを読み、それ以外の行は無視する。
+ * 多角形の面は扇形に三角形に分割する。法線を持たない面には面の法線を使う。
+ * 三角形ごとに三つの頂点属性を並べるので、VertexWelder で重複する頂点をまとめて使う。
+ *
+ * @param name ファイル名
+ * @param vertex 三角形の頂点属性の格納先
+ * @return true 読み込めた
+ * @return false ファイルが開けないか、範囲外のインデックスがあった
+ */
+inline bool loadObj(const std::string& name, std::vector<Object::Vertex>& vertex)
+{
+    std::ifstream file(name);
+    if (!file)
+    {
+        std::cerr << "Failed to open file: " << name << std::endl;
+        return false;
+    }
+
+    std::vector<GLfloat> position, normal;
+    vertex.clear();
+
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number)
+    {
+        std::istringstream stream(line);
+        std::string command;
+        stream >> command;
+        if (command == "v" || command == "vn")
+        {
+            std::vector<GLfloat>& target(command == "v" ? position : normal);
+            GLfloat x(0.0f), y(0.0f), z(0.0f);
+            stream >> x >> y >> z;
+            target.push_back(x);
+            target.push_back(y);
+            target.push_back(z);
+        }
+        else if (command == "f")
+        {
+            // 頂点ごとに位置と法線の番号を取り出す (負の番号は末尾からの位置)
+            std::vector<long> p, n;
+            std::string token;
+            while (stream >> token)
+            {
+                const long count[] = {static_cast<long>(position.size() / 3),
+                                      static_cast<long>(normal.size() / 3)};
+                const std::string::size_type slash(token.find('/'));
+                const std::string::size_type last(token.rfind('/'));
+                long i(std::strtol(token.c_str(), NULL, 10));
+                long k(slash != last && last + 1 < token.size()
+                           ? std::strtol(token.c_str() + last + 1, NULL, 10)
+                           : 0);
+                i = i < 0 ? count[0] + i : i - 1;
+                k = k < 0 ? count[1] + k : k - 1;
+                if (i < 0 || i >= count[0] || k >= count[1])
+                {
+                    std::cerr << name << ":" << number << ": invalid face index " << token
+                              << std::endl;
+                    return false;
+                }
+                p.push_back(i);
+                n.push_back(k);
+            }
+
+            // 扇形に三角形に分割する
+            for (std::size_t j = 2; j < p.size(); ++j)
+            {
+                const std::size_t corner[] = {0, j - 1, j};
+                const GLfloat* const a(&position[p[0] * 3]);
+                const GLfloat* const b(&position[p[j - 1] * 3]);
+                const GLfloat* const c(&position[p[j] * 3]);
+
+                // 面の法線
+                const GLfloat ab[] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+                const GLfloat ac[] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+                GLfloat f[] = {ab[1] * ac[2] - ab[2] * ac[1],
+                               ab[2] * ac[0] - ab[0] * ac[2],
+                               ab[0] * ac[1] - ab[1] * ac[0]};
+                const GLfloat length(std::sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]));
+                if (length > 0.0f)
+                {
+                    f[0] /= length;
+                    f[1] /= length;
+                    f[2] /= length;
+                }
+
+                for (std::size_t q : corner)
+                {
+                    Object::Vertex v;
+                    for (int e = 0; e < 3; ++e)
+                    {
+                        v.position[e] = position[p[q] * 3 + e];
+                        v.normal[e]   = n[q] >= 0 ? normal[n[q] * 3 + e] : f[e];
+                    }
+                    vertex.push_back(v);
+                }
+            }
+        }
+    }
+
+    return true;
+}
@@ -1,18 +1,55 @@
 #pragma once
 #include <GL/glew.h>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "GlTrace.h"
+#include "MemoryStats.h"
 
 /**
  * 頂点配列オブジェクトのクラス
+ *
+ * バッファオブジェクトはコンテキストの間で共有できるが、頂点配列オブジェクトは共有できないので、
+ * 頂点配列オブジェクトは描画するコンテキストで最初に bind() したときに作る。
+ * したがって、読み込みのスレッドのコンテキストで作成して描画のスレッドで使ってもよい。
  */
 class Object
 {
-    /** 頂点配列オブジェクト名 */
-    GLuint vao;
+    /** 頂点配列オブジェクト名 (最初に結合するまでは 0) */
+    mutable GLuint vao;
     /** 頂点バッファオブジェクト名 */
     GLuint vbo;
     /** インデックスの頂点バッファオブジェクト */
     GLuint ibo;
 
+    /** 頂点の位置の次元 */
+    const GLint size;
+
+    /** 一つの領域に格納する頂点の数 */
+    const GLsizei vertexcount;
+
+    /** 頂点バッファオブジェクトの領域の数 (1 なら静的、2 以上なら動的に更新する) */
+    const GLsizei regions;
+
+    /** インデックスの要素数 */
+    const GLsizei indexcount;
+
+    /** 永続的にマップした頂点バッファオブジェクトの先頭 (使わないときは NULL) */
+    void* persistent;
+
+    /** 各領域の描画の完了を待つフェンス */
+    mutable std::vector<GLsync> fences;
+
+    /** 描画に使う領域 */
+    mutable GLsizei current;
+
+    /** 頂点属性が参照している領域 */
+    mutable GLsizei attached;
+
+    /** 書き込みのときにGPUを待った回数 */
+    mutable unsigned int stalls;
+
 public:
     /**
      * 頂点属性を表す構造体
@@ -33,59 +70,253 @@ public:
      * @param vertex 頂点属性を格納した配列
      * @param indexcount 頂点のインデックスの要素数
      * @param index 頂点のインデックスを格納した配列
+     * @param regions 頂点バッファオブジェクトの領域の数 (2 以上なら動的に更新する)
      */
     Object(GLint size,
            GLsizei vertexcount,
            const Vertex* vertex,
            GLsizei indexcount  = 0,
-           const GLuint* index = NULL)
+           const GLuint* index = NULL,
+           GLsizei regions     = 1) :
+        vao(0), size(size), vertexcount(vertexcount), regions(regions > 1 ? regions : 1),
+        indexcount(indexcount), persistent(NULL), fences(this->regions, static_cast<GLsync>(0)),
+        current(0), attached(0), stalls(0)
     {
-        // 頂点配列オブジェクト
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
         // 頂点バッファオブジェクト
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertexcount * sizeof(Vertex), vertex, GL_STATIC_DRAW);
-
-        // 結合されている頂点バッファオブジェクトをin変数から参照できるようにする
-        glVertexAttribPointer(0,
-                              size,
-                              GL_FLOAT,
-                              GL_FALSE,
-                              sizeof(Vertex),
-                              static_cast<Vertex*>(0)->position);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1,
-                              3,
-                              GL_FLOAT,
-                              GL_FALSE,
-                              sizeof(Vertex),
-                              static_cast<Vertex*>(0)->normal);
-        glEnableVertexAttribArray(1);
+        GlTrace::genBuffers(1, &vbo);
+        GlTrace::bindBuffer(GL_ARRAY_BUFFER, vbo);
+        const GLsizeiptr regionsize(vertexcount * sizeof(Vertex));
+        if (this->regions == 1)
+        {
+            GlTrace::bufferData(GL_ARRAY_BUFFER, regionsize, vertex, GL_STATIC_DRAW);
+        }
+        else
+        {
+            if (GLEW_ARB_buffer_storage)
+            {
+                // 全ての領域を永続的にマップしておく
+                const GLbitfield flags(GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+                                       | GL_MAP_COHERENT_BIT);
+                GlTrace::bufferStorage(GL_ARRAY_BUFFER, this->regions * regionsize, NULL, flags);
+                persistent =
+                    glMapBufferRange(GL_ARRAY_BUFFER, 0, this->regions * regionsize, flags);
+                if (persistent == NULL)
+                {
+                    // 領域の大きさを変えられないので作り直して、マップしない方法で更新する
+                    std::cerr << "Can't map the vertex buffer object persistently" << std::endl;
+                    GlTrace::deleteBuffers(1, &vbo);
+                    GlTrace::genBuffers(1, &vbo);
+                    GlTrace::bindBuffer(GL_ARRAY_BUFFER, vbo);
+                }
+                else if (vertex != NULL)
+                {
+                    std::memcpy(persistent, vertex, regionsize);
+                    GlTrace::mappedData(GL_ARRAY_BUFFER, vbo, 0, regionsize, vertex);
+                }
+            }
+            if (persistent == NULL)
+            {
+                GlTrace::bufferData(
+                    GL_ARRAY_BUFFER, this->regions * regionsize, NULL, GL_STREAM_DRAW);
+                if (vertex != NULL)
+                {
+                    GlTrace::bufferSubData(GL_ARRAY_BUFFER, 0, regionsize, vertex);
+                }
+            }
+        }
 
         // インデックスの頂点バッファオブジェクト
-        glGenBuffers(1, &ibo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexcount * sizeof(GLuint), index, GL_STATIC_DRAW);
+        // (GL_ELEMENT_ARRAY_BUFFER は頂点配列オブジェクトの状態なので GL_ARRAY_BUFFER で転送する)
+        GlTrace::genBuffers(1, &ibo);
+        GlTrace::bindBuffer(GL_ARRAY_BUFFER, ibo);
+        GlTrace::bufferData(
+            GL_ARRAY_BUFFER, indexcount * sizeof(GLuint), index, GL_STATIC_DRAW);
+        GlTrace::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // 確保したメモリを記録する
+        MemoryStats& stats(MemoryStats::get());
+        stats.allocate(MemoryStats::Category::VertexArray, 0);
+        stats.allocate(MemoryStats::Category::VertexBuffer, this->regions * regionsize);
+        stats.allocate(MemoryStats::Category::IndexBuffer, indexcount * sizeof(GLuint));
     }
 
     virtual ~Object()
     {
-        glDeleteVertexArrays(1, &vao);
-        glDeleteBuffers(1, &vbo);
-        glDeleteBuffers(1, &ibo);
+        for (GLsync fence : fences)
+        {
+            glDeleteSync(fence);
+        }
+        if (vao != 0)
+            GlTrace::deleteVertexArrays(1, &vao);
+        GlTrace::deleteBuffers(1, &vbo);
+        GlTrace::deleteBuffers(1, &ibo);
+
+        MemoryStats& stats(MemoryStats::get());
+        stats.release(MemoryStats::Category::VertexArray, 0);
+        stats.release(MemoryStats::Category::VertexBuffer,
+                      regions * vertexcount * sizeof(Vertex));
+        stats.release(MemoryStats::Category::IndexBuffer, indexcount * sizeof(GLuint));
     }
 
     /** 頂点配列オブジェクトを結合する */
     void bind() const
     {
+        // 最初に結合するときに頂点配列オブジェクトを作る
+        if (vao == 0)
+        {
+            GlTrace::genVertexArrays(1, &vao);
+            GlTrace::bindVertexArray(vao);
+
+            // 頂点バッファオブジェクトをin変数から参照できるようにする
+            GlTrace::bindBuffer(GL_ARRAY_BUFFER, vbo);
+            attach(current);
+            GlTrace::enableVertexAttribArray(0);
+            GlTrace::enableVertexAttribArray(1);
+            GlTrace::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+            return;
+        }
+
         // 描画する頂点配列オブジェクトを指定する
-        glBindVertexArray(vao);
+        GlTrace::bindVertexArray(vao);
+
+        // 書き換えた領域を頂点属性から参照する
+        if (attached != current)
+        {
+            GlTrace::bindBuffer(GL_ARRAY_BUFFER, vbo);
+            attach(current);
+        }
+    }
+
+    /**
+     * @brief 次の領域を書き込み用にマップする
+     *
+     * 領域を描画したときのフェンスを待ってから返すので、
+     * 領域の数を 3 にしておけば通常はGPUを待つことはない
+     *
+     * @return Vertex* 書き込む頂点属性の先頭 (静的なら NULL)
+     */
+    Vertex* map() const
+    {
+        if (regions == 1)
+            return NULL;
+
+        current = (current + 1) % regions;
+        wait(current);
+
+        const GLsizeiptr regionsize(vertexcount * sizeof(Vertex));
+        if (persistent != NULL)
+        {
+            return reinterpret_cast<Vertex*>(static_cast<char*>(persistent)
+                                             + current * regionsize);
+        }
+
+        // フェンスで同期しているのでドライバによる同期は行わない
+        GlTrace::bindBuffer(GL_ARRAY_BUFFER, vbo);
+        return static_cast<Vertex*>(glMapBufferRange(GL_ARRAY_BUFFER,
+                                                     current * regionsize,
+                                                     regionsize,
+                                                     GL_MAP_WRITE_BIT
+                                                         | GL_MAP_INVALIDATE_RANGE_BIT
+                                                         | GL_MAP_UNSYNCHRONIZED_BIT));
+    }
+
+    /**
+     * @brief 書き込みを終えた領域のマップを解除する
+     *
+     * マップした領域は書き込み専用なので、書き込んだ内容は GlTrace に記録しない
+     * (記録するときは update() を使う)
+     */
+    void unmap() const
+    {
+        if (regions == 1 || persistent != NULL)
+            return;
+
+        GlTrace::bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    /**
+     * @brief 次の領域に頂点属性を書き込んで描画に使う
+     *
+     * 記録しているときは書き込んだ領域の内容として vertex を記録する。
+     *
+     * @param vertex 頂点属性を格納した配列
+     */
+    void update(const Vertex* vertex) const
+    {
+        Vertex* const p(map());
+        if (p == NULL)
+            return;
+
+        const GLsizeiptr regionsize(vertexcount * sizeof(Vertex));
+        std::memcpy(p, vertex, regionsize);
+        GlTrace::mappedData(GL_ARRAY_BUFFER, vbo, current * regionsize, regionsize, vertex);
+        unmap();
+    }
+
+    /** 描画に使った領域にフェンスを置く */
+    void fence() const
+    {
+        if (regions == 1)
+            return;
+
+        glDeleteSync(fences[current]);
+        fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    /** 頂点バッファオブジェクトの領域の数を返す */
+    GLsizei getRegions() const
+    {
+        return regions;
+    }
+
+    /** 書き込みのときにGPUを待った回数を返す */
+    unsigned int getStalls() const
+    {
+        return stalls;
     }
 
 private:
+    /** 頂点属性に領域を割り当てる */
+    void attach(GLsizei region) const
+    {
+        const GLsizeiptr offset(region * vertexcount * sizeof(Vertex));
+        const char* const base(static_cast<const char*>(0) + offset);
+        GlTrace::vertexAttribPointer(0,
+                                     size,
+                                     GL_FLOAT,
+                                     GL_FALSE,
+                                     sizeof(Vertex),
+                                     base + offsetof(Vertex, position));
+        GlTrace::vertexAttribPointer(1,
+                                     3,
+                                     GL_FLOAT,
+                                     GL_FALSE,
+                                     sizeof(Vertex),
+                                     base + offsetof(Vertex, normal));
+        attached = region;
+    }
+
+    /** 領域の描画が終わるまで待つ */
+    void wait(GLsizei region) const
+    {
+        GLsync& sync(fences[region]);
+        if (sync == 0)
+            return;
+
+        if (glClientWaitSync(sync, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            ++stalls;
+            while (glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000)
+                   == GL_TIMEOUT_EXPIRED)
+            {
+            }
+        }
+
+        glDeleteSync(sync);
+        sync = 0;
+    }
+
     /** コピーコンストラクタによるコピー禁止 */
     Object(const Object& o);
 
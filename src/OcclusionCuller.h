@@ -0,0 +1,437 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "FrameArena.h"
+#include "Matrix.h"
+#include "Object.h"
+#include "TaskPool.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_CULLER_SSE2 1
+#endif
+
+/**
+ * CPU で遮蔽物を低解像度の深度バッファに描き、物体が隠れているかを調べるクラス
+ *
+ * 遮蔽物の三角形をタイルに振り分け、タイルごとに複数のスレッドで
+ * 4 画素ずつ SIMD 命令でラスタライズする。深度バッファからは 2x2 の最も遠い深度を
+ * 一つにまとめた Hi-Z のミップマップを作り、物体の境界の箱を数画素の比較で判定する。
+ *
+ * 判定は保守的で、近くの面より手前に頂点がある遮蔽物の三角形や
+ * 画面の外の余白 (ガードバンド) からはみ出す遮蔽物の三角形は描かず、
+ * 視点の手前の面をまたぐ物体は見えるものとして扱う。
+ * 遮蔽物の三角形は反時計回りを表とし、裏向きのものは描かない。
+ * 遮蔽物の三角形とタイルへの振り分けは clear() で空にするアリーナに置く。
+ * OpenGL は使わない。
+ */
+class OcclusionCuller
+{
+    /** タイルの幅と高さ (画素) */
+    static constexpr int tileSize = 32;
+
+    /**
+     * 画面上に変換した三角形
+     */
+    struct Triangle
+    {
+        /** 辺の関数 a * x + b * y + c の係数 (内側で非負) */
+        GLfloat a[3], b[3], c[3];
+        /** 深度の平面 za * x + zb * y + zc の係数 */
+        GLfloat za, zb, zc;
+        /** 画素の範囲 */
+        int x0, y0, x1, y1;
+    };
+
+    /** 深度バッファの幅と高さ (幅は 4 の倍数) */
+    const int width, height;
+
+    /** 横と縦のタイルの数 */
+    const int tilesX, tilesY;
+
+    /** Hi-Z のミップマップ (0 段目が深度バッファで、0 が近く 1 が遠い) */
+    std::vector<std::vector<GLfloat>> levels;
+
+    /** Hi-Z の各段の幅と高さ */
+    std::vector<int> levelWidth, levelHeight;
+
+    /** 遮蔽物の三角形とタイルごとの番号を置くアリーナ */
+    FrameArena arena;
+
+    /** 遮蔽物の三角形 */
+    FrameVector<Triangle> triangles;
+
+    /** タイルごとの三角形の番号 */
+    std::vector<FrameVector<GLuint>> bins;
+
+    /** クリップ座標系に変換した頂点 (作業用) */
+    std::vector<GLfloat> clip;
+
+    /** タイルを分担するスレッド */
+    TaskPool pool;
+
+    /** 判定した物体の数 */
+    mutable unsigned long tested;
+
+    /** 隠れていると判定した物体の数 */
+    mutable unsigned long culled;
+
+public:
+    /**
+     * @brief Construct a new OcclusionCuller object
+     *
+     * @param width 深度バッファの幅 (4 の倍数に切り上げる)
+     * @param height 深度バッファの高さ
+     * @param threads ラスタライズを分担するスレッドの数 (0 ならコアの数)
+     */
+    OcclusionCuller(int width = 256, int height = 128, unsigned int threads = 0) :
+        width((std::max(width, 4) + 3) & ~3), height(std::max(height, 1)),
+        tilesX((this->width + tileSize - 1) / tileSize),
+        tilesY((this->height + tileSize - 1) / tileSize),
+        arena(16 * 1024), triangles(FrameAllocator<Triangle>(arena)),
+        bins(tilesX * tilesY, FrameVector<GLuint>(FrameAllocator<GLuint>(arena))), pool(threads),
+        tested(0), culled(0)
+    {
+        // Hi-Z の各段を確保する
+        int w(this->width), h(this->height);
+        for (;;)
+        {
+            levels.emplace_back(w * h, 1.0f);
+            levelWidth.push_back(w);
+            levelHeight.push_back(h);
+            if (w == 1 && h == 1)
+                break;
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+        }
+    }
+
+    /** 遮蔽物を全て取り除く */
+    void clear()
+    {
+        // 三角形を容量ごと捨ててからアリーナを空にする
+        const FrameAllocator<GLuint> allocator(arena);
+        triangles = FrameVector<Triangle>(allocator);
+        bins.clear();
+        bins.assign(tilesX * tilesY, FrameVector<GLuint>(allocator));
+        arena.reset();
+    }
+
+    /**
+     * @brief 遮蔽物を加える
+     *
+     * @param mvp モデル座標系からクリップ座標系への変換行列
+     * @param vertexcount 頂点の数
+     * @param vertex 頂点属性を格納した配列
+     * @param indexcount 三角形の頂点のインデックスの要素数
+     * @param index 三角形の頂点のインデックスを格納した配列
+     */
+    void addOccluder(const Matrix& mvp,
+                     GLsizei vertexcount,
+                     const Object::Vertex* vertex,
+                     GLsizei indexcount,
+                     const GLuint* index)
+    {
+        // 頂点をクリップ座標系に変換する
+        clip.resize(vertexcount * 4);
+        for (GLsizei i = 0; i < vertexcount; ++i)
+        {
+            const GLfloat* const p(vertex[i].position);
+            for (int r = 0; r < 4; ++r)
+            {
+                clip[i * 4 + r] =
+                    mvp[r] * p[0] + mvp[4 + r] * p[1] + mvp[8 + r] * p[2] + mvp[12 + r];
+            }
+        }
+
+        for (GLsizei i = 0; i + 2 < indexcount; i += 3)
+        {
+            setup(&clip[index[i] * 4], &clip[index[i + 1] * 4], &clip[index[i + 2] * 4]);
+        }
+    }
+
+    /** 遮蔽物を深度バッファに描いて Hi-Z のミップマップを作る */
+    void rasterize()
+    {
+        pool.run(tilesX * tilesY, [this](int tile) { rasterizeTile(tile); });
+
+        // 2x2 の最も遠い深度を一つにまとめる
+        for (std::size_t l = 1; l < levels.size(); ++l)
+        {
+            const std::vector<GLfloat>& src(levels[l - 1]);
+            const int sw(levelWidth[l - 1]), sh(levelHeight[l - 1]);
+            std::vector<GLfloat>& dst(levels[l]);
+            for (int y = 0; y < levelHeight[l]; ++y)
+            {
+                const int y0(y * 2), y1(std::min(y * 2 + 1, sh - 1));
+                for (int x = 0; x < levelWidth[l]; ++x)
+                {
+                    const int x0(x * 2), x1(std::min(x * 2 + 1, sw - 1));
+                    const GLfloat top(std::max(src[y0 * sw + x0], src[y0 * sw + x1]));
+                    const GLfloat bottom(std::max(src[y1 * sw + x0], src[y1 * sw + x1]));
+                    dst[y * levelWidth[l] + x] = std::max(top, bottom);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief 境界の箱が見える可能性があるかを調べる
+     *
+     * @param mvp モデル座標系からクリップ座標系への変換行列
+     * @param min 境界の箱のモデル座標系での最小の座標
+     * @param max 境界の箱のモデル座標系での最大の座標
+     * @return true 見える可能性がある
+     * @return false 遮蔽物に隠れているか画面の外にある
+     */
+    bool isVisible(const Matrix& mvp, const GLfloat* min, const GLfloat* max) const
+    {
+        ++tested;
+
+        // 箱の八つの頂点を正規化デバイス座標系に変換して範囲を求める
+        GLfloat lo[3] = {1.0e30f, 1.0e30f, 1.0e30f}, hi[2] = {-1.0e30f, -1.0e30f};
+        for (int i = 0; i < 8; ++i)
+        {
+            const GLfloat p[] = {
+                i & 1 ? max[0] : min[0], i & 2 ? max[1] : min[1], i & 4 ? max[2] : min[2]};
+            GLfloat q[4];
+            for (int r = 0; r < 4; ++r)
+            {
+                q[r] = mvp[r] * p[0] + mvp[4 + r] * p[1] + mvp[8 + r] * p[2] + mvp[12 + r];
+            }
+
+            // 視点の手前の面をまたぐなら見えるものとする
+            if (q[3] <= nearW)
+                return true;
+
+            const GLfloat x(q[0] / q[3]), y(q[1] / q[3]), z(q[2] / q[3]);
+            lo[0] = std::min(lo[0], x);
+            lo[1] = std::min(lo[1], y);
+            lo[2] = std::min(lo[2], z);
+            hi[0] = std::max(hi[0], x);
+            hi[1] = std::max(hi[1], y);
+        }
+
+        // 画面の外か遠くの面より遠い
+        if (hi[0] < -1.0f || lo[0] > 1.0f || hi[1] < -1.0f || lo[1] > 1.0f || lo[2] > 1.0f)
+        {
+            ++culled;
+            return false;
+        }
+
+        // 箱が 2x2 程度の画素に収まる段を選ぶ
+        int x0(toPixel(lo[0], width)), x1(toPixel(hi[0], width));
+        int y0(toPixel(lo[1], height)), y1(toPixel(hi[1], height));
+        std::size_t level(0);
+        while (std::max(x1 - x0, y1 - y0) > 1 && level + 1 < levels.size())
+        {
+            x0 >>= 1;
+            x1 >>= 1;
+            y0 >>= 1;
+            y1 >>= 1;
+            ++level;
+        }
+
+        // 箱の最も近い深度より遠いところが一つでもあれば見える
+        const GLfloat nearest(lo[2] * 0.5f + 0.5f);
+        const std::vector<GLfloat>& hiZ(levels[level]);
+        for (int y = y0; y <= y1; ++y)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                if (hiZ[y * levelWidth[level] + x] >= nearest)
+                    return true;
+            }
+        }
+
+        ++culled;
+        return false;
+    }
+
+    /** 深度バッファの幅を返す */
+    int getWidth() const
+    {
+        return width;
+    }
+
+    /** 深度バッファの高さを返す */
+    int getHeight() const
+    {
+        return height;
+    }
+
+    /** 深度バッファを返す */
+    const GLfloat* getDepth() const
+    {
+        return levels[0].data();
+    }
+
+    /** 描いた遮蔽物の三角形の数を返す */
+    GLsizei getOccluderTriangles() const
+    {
+        return static_cast<GLsizei>(triangles.size());
+    }
+
+    /** 判定した物体の数を返す */
+    unsigned long getTested() const
+    {
+        return tested;
+    }
+
+    /** 隠れていると判定した物体の数を返す */
+    unsigned long getCulled() const
+    {
+        return culled;
+    }
+
+private:
+    /** 視点の手前の面とみなすクリップ座標の w */
+    static constexpr GLfloat nearW = 1.0e-5f;
+
+    /** 遮蔽物の三角形を描く画面の外の余白 (画素、辺の関数を float で正確に求められる範囲) */
+    static constexpr GLfloat guardBand = 4096.0f;
+
+    /** 画素の位置を範囲内に収めてから整数にする (範囲外の float の変換は未定義なので先に収める) */
+    static int toInt(GLfloat p, int size)
+    {
+        return static_cast<int>(std::min(std::max(p, 0.0f), static_cast<GLfloat>(size - 1)));
+    }
+
+    /** 正規化デバイス座標を範囲内の画素の位置にする */
+    static int toPixel(GLfloat ndc, int size)
+    {
+        return toInt(std::floor((ndc * 0.5f + 0.5f) * static_cast<GLfloat>(size)), size);
+    }
+
+    /** クリップ座標系の三角形を画面上に変換してタイルに振り分ける */
+    void setup(const GLfloat* p0, const GLfloat* p1, const GLfloat* p2)
+    {
+        const GLfloat* const p[] = {p0, p1, p2};
+        GLfloat x[3], y[3], z[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            // 近くの面より手前に頂点がある三角形は描かない
+            if (p[i][3] <= nearW || p[i][2] < -p[i][3])
+                return;
+
+            x[i] = (p[i][0] / p[i][3] * 0.5f + 0.5f) * static_cast<GLfloat>(width);
+            y[i] = (p[i][1] / p[i][3] * 0.5f + 0.5f) * static_cast<GLfloat>(height);
+            z[i] = p[i][2] / p[i][3] * 0.5f + 0.5f;
+
+            // ガードバンドからはみ出す三角形は辺の関数の精度が足りないので描かない
+            if (!(x[i] >= -guardBand && x[i] <= static_cast<GLfloat>(width) + guardBand
+                  && y[i] >= -guardBand && y[i] <= static_cast<GLfloat>(height) + guardBand))
+                return;
+        }
+
+        // 裏向きか面積のない三角形は描かない
+        const GLfloat area((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]));
+        if (!(area > 0.0f))
+            return;
+
+        const GLfloat left(std::floor(std::min({x[0], x[1], x[2]})));
+        const GLfloat bottom(std::floor(std::min({y[0], y[1], y[2]})));
+        const GLfloat right(std::ceil(std::max({x[0], x[1], x[2]})));
+        const GLfloat top(std::ceil(std::max({y[0], y[1], y[2]})));
+        if (right < 0.0f || left > static_cast<GLfloat>(width - 1) || top < 0.0f
+            || bottom > static_cast<GLfloat>(height - 1))
+            return;
+
+        Triangle t;
+        t.x0 = toInt(left, width);
+        t.y0 = toInt(bottom, height);
+        t.x1 = toInt(right, width);
+        t.y1 = toInt(top, height);
+
+        // 辺 i は頂点 i から頂点 i + 1 へ向かう
+        for (int i = 0; i < 3; ++i)
+        {
+            const int j((i + 1) % 3);
+            t.a[i] = y[i] - y[j];
+            t.b[i] = x[j] - x[i];
+            t.c[i] = x[i] * y[j] - x[j] * y[i];
+        }
+
+        // 重心座標で深度を補間する平面を求める (辺 i の向かいは頂点 i + 2)
+        const GLfloat inv(1.0f / area);
+        t.za = (t.a[1] * z[0] + t.a[2] * z[1] + t.a[0] * z[2]) * inv;
+        t.zb = (t.b[1] * z[0] + t.b[2] * z[1] + t.b[0] * z[2]) * inv;
+        t.zc = (t.c[1] * z[0] + t.c[2] * z[1] + t.c[0] * z[2]) * inv;
+
+        const GLuint id(static_cast<GLuint>(triangles.size()));
+        triangles.push_back(t);
+        for (int ty = t.y0 / tileSize; ty <= t.y1 / tileSize; ++ty)
+        {
+            for (int tx = t.x0 / tileSize; tx <= t.x1 / tileSize; ++tx)
+            {
+                bins[ty * tilesX + tx].push_back(id);
+            }
+        }
+    }
+
+    /** 一つのタイルを消去して振り分けた三角形を描く */
+    void rasterizeTile(int tile)
+    {
+        const int tx0((tile % tilesX) * tileSize), ty0((tile / tilesX) * tileSize);
+        const int tx1(std::min(tx0 + tileSize, width) - 1);
+        const int ty1(std::min(ty0 + tileSize, height) - 1);
+        std::vector<GLfloat>& depth(levels[0]);
+        for (int y = ty0; y <= ty1; ++y)
+        {
+            std::fill(&depth[y * width + tx0], &depth[y * width + tx1] + 1, 1.0f);
+        }
+
+        for (GLuint id : bins[tile])
+        {
+            const Triangle& t(triangles[id]);
+
+            // タイルと三角形の範囲の重なり (横は 4 画素単位)
+            const int x0(std::max(t.x0, tx0) & ~3), x1(std::min(t.x1, tx1));
+            const int y0(std::max(t.y0, ty0)), y1(std::min(t.y1, ty1));
+            for (int y = y0; y <= y1; ++y)
+            {
+                GLfloat* const row(&depth[y * width]);
+                const GLfloat py(static_cast<GLfloat>(y) + 0.5f);
+                for (int x = x0; x <= x1; x += 4)
+                {
+                    span(t, row + x, static_cast<GLfloat>(x) + 0.5f, py);
+                }
+            }
+        }
+    }
+
+    /** 画素の中心 (px, py) から横に並んだ 4 画素を描く */
+    static void span(const Triangle& t, GLfloat* d, GLfloat px, GLfloat py)
+    {
+#ifdef OCCLUSION_CULLER_SSE2
+        const __m128 x(_mm_add_ps(_mm_set1_ps(px), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f)));
+        const __m128 y(_mm_set1_ps(py));
+        __m128 inside(_mm_castsi128_ps(_mm_set1_epi32(-1)));
+        for (int i = 0; i < 3; ++i)
+        {
+            const __m128 e(_mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.a[i]), x), _mm_mul_ps(_mm_set1_ps(t.b[i]), y)),
+                _mm_set1_ps(t.c[i])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(e, _mm_setzero_ps()));
+        }
+        const __m128 z(_mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.za), x), _mm_mul_ps(_mm_set1_ps(t.zb), y)),
+            _mm_set1_ps(t.zc)));
+        const __m128 old(_mm_loadu_ps(d));
+        const __m128 nearer(_mm_min_ps(old, z));
+        _mm_storeu_ps(d, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+#else
+        for (int k = 0; k < 4; ++k)
+        {
+            const GLfloat x(px + static_cast<GLfloat>(k));
+            if (t.a[0] * x + t.b[0] * py + t.c[0] >= 0.0f
+                && t.a[1] * x + t.b[1] * py + t.c[1] >= 0.0f
+                && t.a[2] * x + t.b[2] * py + t.c[2] >= 0.0f)
+            {
+                d[k] = std::min(d[k], t.za * x + t.zb * py + t.zc);
+            }
+        }
+#endif
+    }
+};
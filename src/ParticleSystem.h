@@ -0,0 +1,389 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Matrix.h"
+#include "MemoryStats.h"
+#include "Shader.h"
+
+/**
+ * 粒子の状態を GPU のバッファオブジェクトだけに置いて動かすクラス
+ *
+ * 二つの頂点バッファオブジェクトを交互に読み書きし、トランスフォームフィードバックで
+ * 粒子を一つのバーテックスシェーダ (particle_update.vert) で進める。
+ * 粒子の放出も CPU では範囲と放出源の値を uniform 変数で渡すだけなので、
+ * 粒子の数によらず CPU の処理は一定になる。
+ * 粒子は環状に並べ、放出するたびに古い粒子の場所から順に使う。
+ * 描画はポイントスプライト (particle.vert, particle.frag) で行う。
+ * OpenGL の関数を直接呼び出すので、GlTrace には記録されない。
+ */
+class ParticleSystem
+{
+public:
+    /**
+     * 一つの粒子 (バッファオブジェクトの中の並び)
+     */
+    struct Particle
+    {
+        /** 位置と残りの寿命 (秒、0 以下なら消えている) */
+        GLfloat position[4];
+        /** 速度と放出したときの寿命 */
+        GLfloat velocity[4];
+    };
+
+    /**
+     * 粒子を放出する源
+     */
+    struct Emitter
+    {
+        /** 位置 */
+        GLfloat position[3];
+        /** 初速度 */
+        GLfloat velocity[3];
+        /** 初速度の各成分に加える乱数の幅 */
+        GLfloat spread;
+        /** 一秒あたりに放出する粒子の数 */
+        GLfloat rate;
+        /** 粒子の寿命 (秒) */
+        GLfloat life;
+        /** これまでに放出しきれなかった端数 */
+        GLfloat pending;
+    };
+
+    /** 一回の更新で放出できる範囲の数 (particle_update.vert に合わせる) */
+    static constexpr int maxBatches = 16;
+
+private:
+    /**
+     * 一回の更新で放出する粒子の範囲
+     */
+    struct Batch
+    {
+        /** 先頭の粒子と粒子の数 */
+        GLint first, count;
+        /** 放出源の位置と寿命 */
+        GLfloat position[4];
+        /** 初速度と乱数の幅 */
+        GLfloat velocity[4];
+    };
+
+    /** 粒子の数 */
+    const GLsizei capacity;
+
+    /** 粒子を格納する二つの頂点バッファオブジェクト */
+    GLuint vbo[2];
+
+    /** それぞれのバッファオブジェクトを読み出す頂点配列オブジェクト */
+    GLuint vao[2];
+
+    /** 最新の粒子を格納しているバッファオブジェクトの番号 */
+    int current;
+
+    /** 粒子を進めるプログラムオブジェクトと描画するプログラムオブジェクト */
+    GLuint updateProgram, drawProgram;
+
+    /** 粒子を進めるプログラムオブジェクトの uniform 変数の場所 */
+    GLint dtLocation, gravityLocation, groundLocation, seedLocation, batchesLocation,
+        emitFirstLocation, emitCountLocation, emitPositionLocation, emitVelocityLocation;
+
+    /** 描画するプログラムオブジェクトの uniform 変数の場所 */
+    GLint modelViewLocation, projectionLocation, pointScaleLocation;
+
+    /** 次の更新で放出する範囲 */
+    std::vector<Batch> batches;
+
+    /** 次に放出する粒子の位置 */
+    GLint next;
+
+    /** 重力加速度 */
+    GLfloat gravity[3];
+
+    /** 地面の高さと跳ね返り係数 */
+    GLfloat ground[2];
+
+    /** 更新の回数 (乱数の種に使う) */
+    GLuint frame;
+
+    /** 放出した粒子の数 */
+    unsigned long long emitted;
+
+    /** 範囲の数が足りずに放出できなかった粒子の数 */
+    unsigned long long dropped;
+
+public:
+    /**
+     * @brief Construct a new ParticleSystem object
+     *
+     * @param capacity 粒子の数の上限
+     * @param resources シェーダのソースファイルを置いたディレクトリ
+     */
+    ParticleSystem(GLsizei capacity, const std::string& resources = "resources") :
+        capacity(std::max(capacity, 1)), current(0), next(0),
+        gravity {0.0f, -9.8f, 0.0f}, ground {-1.0e30f, 0.5f}, frame(0), emitted(0), dropped(0)
+    {
+        updateProgram = loadFeedbackProgram(resources + "/particle_update.vert",
+                                             {"outPosition", "outVelocity"});
+        drawProgram =
+            loadProgram(resources + "/particle.vert", resources + "/particle.frag");
+
+        dtLocation           = glGetUniformLocation(updateProgram, "dt");
+        gravityLocation      = glGetUniformLocation(updateProgram, "gravity");
+        groundLocation       = glGetUniformLocation(updateProgram, "ground");
+        seedLocation         = glGetUniformLocation(updateProgram, "seed");
+        batchesLocation      = glGetUniformLocation(updateProgram, "batches");
+        emitFirstLocation    = glGetUniformLocation(updateProgram, "emitFirst");
+        emitCountLocation    = glGetUniformLocation(updateProgram, "emitCount");
+        emitPositionLocation = glGetUniformLocation(updateProgram, "emitPosition");
+        emitVelocityLocation = glGetUniformLocation(updateProgram, "emitVelocity");
+        modelViewLocation    = glGetUniformLocation(drawProgram, "modelView");
+        projectionLocation   = glGetUniformLocation(drawProgram, "projection");
+        pointScaleLocation   = glGetUniformLocation(drawProgram, "pointScale");
+
+        // 全ての粒子を寿命の尽きた状態にしておく
+        const std::vector<Particle> dead(this->capacity, Particle {});
+        const GLsizeiptr size(this->capacity * sizeof(Particle));
+        glGenBuffers(2, vbo);
+        glGenVertexArrays(2, vao);
+        const char* const base(static_cast<const char*>(0));
+        for (int i = 0; i < 2; ++i)
+        {
+            glBindVertexArray(vao[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo[i]);
+            glBufferData(GL_ARRAY_BUFFER, size, dead.data(), GL_DYNAMIC_COPY);
+            glVertexAttribPointer(0,
+                                  4,
+                                  GL_FLOAT,
+                                  GL_FALSE,
+                                  sizeof(Particle),
+                                  base + offsetof(Particle, position));
+            glVertexAttribPointer(1,
+                                  4,
+                                  GL_FLOAT,
+                                  GL_FALSE,
+                                  sizeof(Particle),
+                                  base + offsetof(Particle, velocity));
+            glEnableVertexAttribArray(0);
+            glEnableVertexAttribArray(1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        MemoryStats& stats(MemoryStats::get());
+        for (int i = 0; i < 2; ++i)
+        {
+            stats.allocate(MemoryStats::Category::VertexArray, 0);
+            stats.allocate(MemoryStats::Category::VertexBuffer, size);
+        }
+    }
+
+    virtual ~ParticleSystem()
+    {
+        glDeleteVertexArrays(2, vao);
+        glDeleteBuffers(2, vbo);
+        deleteProgram(updateProgram);
+        deleteProgram(drawProgram);
+
+        MemoryStats& stats(MemoryStats::get());
+        for (int i = 0; i < 2; ++i)
+        {
+            stats.release(MemoryStats::Category::VertexArray, 0);
+            stats.release(MemoryStats::Category::VertexBuffer, capacity * sizeof(Particle));
+        }
+    }
+
+    /** シェーダを読み込めたかどうかを返す */
+    explicit operator bool() const
+    {
+        return updateProgram != 0 && drawProgram != 0;
+    }
+
+    /** 重力加速度を設定する */
+    void setGravity(GLfloat x, GLfloat y, GLfloat z)
+    {
+        gravity[0] = x;
+        gravity[1] = y;
+        gravity[2] = z;
+    }
+
+    /**
+     * @brief 粒子が跳ね返る地面を設定する
+     *
+     * @param height 地面の高さ (y 座標)
+     * @param restitution 跳ね返り係数
+     */
+    void setGround(GLfloat height, GLfloat restitution)
+    {
+        ground[0] = height;
+        ground[1] = restitution;
+    }
+
+    /**
+     * @brief 放出源から時間に応じた数の粒子を次の更新で放出する
+     *
+     * @param emitter 放出源 (放出しきれなかった端数を次に持ち越す)
+     * @param dt 経過時間 (秒)
+     */
+    void emit(Emitter& emitter, GLfloat dt)
+    {
+        const GLfloat amount(emitter.rate * dt + emitter.pending);
+        const GLfloat whole(std::floor(amount));
+        emitter.pending = amount - whole;
+        burst(emitter, static_cast<GLsizei>(std::min(whole, static_cast<GLfloat>(capacity))));
+    }
+
+    /**
+     * @brief 放出源から指定した数の粒子を次の更新で放出する
+     *
+     * 古い粒子の場所から順に使うので、寿命の残っている粒子を上書きすることがある
+     *
+     * @param emitter 放出源
+     * @param count 粒子の数
+     */
+    void burst(const Emitter& emitter, GLsizei count)
+    {
+        count = std::min(count, capacity);
+        while (count > 0)
+        {
+            // 環状の並びの終わりで範囲を分ける
+            if (static_cast<int>(batches.size()) == maxBatches)
+            {
+                dropped += count;
+                return;
+            }
+            const GLint n(std::min(count, capacity - next));
+            Batch b;
+            b.first = next;
+            b.count = n;
+            std::copy(emitter.position, emitter.position + 3, b.position);
+            b.position[3] = emitter.life;
+            std::copy(emitter.velocity, emitter.velocity + 3, b.velocity);
+            b.velocity[3] = emitter.spread;
+            batches.push_back(b);
+
+            next = (next + n) % capacity;
+            emitted += n;
+            count -= n;
+        }
+    }
+
+    /**
+     * @brief 全ての粒子を進めて、放出を要求された範囲に新しい粒子を置く
+     *
+     * @param dt 経過時間 (秒)
+     */
+    void update(GLfloat dt)
+    {
+        glUseProgram(updateProgram);
+        glUniform1f(dtLocation, dt);
+        glUniform3fv(gravityLocation, 1, gravity);
+        glUniform2fv(groundLocation, 1, ground);
+        glUniform1ui(seedLocation, ++frame);
+
+        // 放出する範囲を渡す
+        GLint first[maxBatches], count[maxBatches];
+        GLfloat position[maxBatches][4], velocity[maxBatches][4];
+        const GLsizei n(static_cast<GLsizei>(batches.size()));
+        for (GLsizei i = 0; i < n; ++i)
+        {
+            first[i] = batches[i].first;
+            count[i] = batches[i].count;
+            std::copy(batches[i].position, batches[i].position + 4, position[i]);
+            std::copy(batches[i].velocity, batches[i].velocity + 4, velocity[i]);
+        }
+        glUniform1i(batchesLocation, n);
+        if (n > 0)
+        {
+            glUniform1iv(emitFirstLocation, n, first);
+            glUniform1iv(emitCountLocation, n, count);
+            glUniform4fv(emitPositionLocation, n, position[0]);
+            glUniform4fv(emitVelocityLocation, n, velocity[0]);
+        }
+        batches.clear();
+
+        // 読み出すバッファオブジェクトと違うほうに書き出す
+        glBindVertexArray(vao[current]);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, vbo[1 - current]);
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, capacity);
+        glEndTransformFeedback();
+        glDisable(GL_RASTERIZER_DISCARD);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindVertexArray(0);
+
+        current = 1 - current;
+    }
+
+    /**
+     * @brief 粒子を半透明の点として描画する
+     *
+     * デプスバッファには書き込まず、描画した後は混合を無効にする
+     *
+     * @param projection 透視投影変換行列
+     * @param modelView モデルビュー変換行列
+     * @param height フレームバッファの高さ
+     * @param size 粒子の直径 (モデル座標系の長さ)
+     */
+    void draw(const Matrix& projection, const Matrix& modelView, GLsizei height, GLfloat size)
+    {
+        glUseProgram(drawProgram);
+        glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, projection.data());
+        glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE, modelView.data());
+        glUniform1f(pointScaleLocation,
+                    size * projection[5] * static_cast<GLfloat>(height) * 0.5f);
+
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+
+        glBindVertexArray(vao[current]);
+        glDrawArrays(GL_POINTS, 0, capacity);
+        glBindVertexArray(0);
+
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+
+    /**
+     * @brief 最新の粒子を読み出す (確認用で、GPU の処理の完了を待つ)
+     *
+     * @param particles 粒子の格納先
+     */
+    void read(std::vector<Particle>& particles) const
+    {
+        particles.resize(capacity);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo[current]);
+        glGetBufferSubData(GL_ARRAY_BUFFER, 0, capacity * sizeof(Particle), particles.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    /** 粒子の数の上限を返す */
+    GLsizei getCapacity() const
+    {
+        return capacity;
+    }
+
+    /** 放出した粒子の数を返す */
+    unsigned long long getEmitted() const
+    {
+        return emitted;
+    }
+
+    /** 放出できなかった粒子の数を返す */
+    unsigned long long getDropped() const
+    {
+        return dropped;
+    }
+
+private:
+    /** コピーコンストラクタによるコピー禁止 */
+    ParticleSystem(const ParticleSystem& p);
+
+    /** 代入によるコピー禁止 */
+    ParticleSystem& operator=(const ParticleSystem& p);
+};
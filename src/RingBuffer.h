@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+/**
+ * 一つのスレッドが書き込み、一つのスレッドが読み出すロックフリーのリングバッファ
+ *
+ * @tparam T 要素の型
+ * @tparam N 要素の数 (2 の累乗)
+ */
+template<typename T, std::size_t N>
+class RingBuffer
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+    /** 次に読み出す位置 (読み出す側だけが書き換える) */
+    alignas(64) std::atomic<std::size_t> head;
+
+    /** 次に書き込む位置 (書き込む側だけが書き換える) */
+    alignas(64) std::atomic<std::size_t> tail;
+
+    /** 満杯で書き込めなかった要素の数 */
+    std::atomic<std::size_t> dropped;
+
+    /** 要素 */
+    alignas(64) T buffer[N];
+
+public:
+    RingBuffer() : head(0), tail(0), dropped(0) {}
+
+    /**
+     * @brief 要素を書き込む (書き込む側のスレッドから呼ぶ)
+     *
+     * @param value 書き込む要素
+     * @return true 書き込めた
+     * @return false 満杯だった
+     */
+    bool push(const T& value)
+    {
+        const std::size_t t(tail.load(std::memory_order_relaxed));
+        if (t - head.load(std::memory_order_acquire) == N)
+        {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        buffer[t & (N - 1)] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief 要素を読み出す (読み出す側のスレッドから呼ぶ)
+     *
+     * @param value 読み出した要素の格納先
+     * @return true 読み出せた
+     * @return false 空だった
+     */
+    bool pop(T& value)
+    {
+        const std::size_t h(head.load(std::memory_order_relaxed));
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+
+        value = buffer[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** 格納されている要素の数の目安を返す */
+    std::size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    /** 要素の数の上限を返す */
+    static constexpr std::size_t capacity()
+    {
+        return N;
+    }
+
+    /** 満杯で書き込めなかった要素の数を返す */
+    std::size_t getDropped() const
+    {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    /** コピーコンストラクタによるコピー禁止 */
+    RingBuffer(const RingBuffer& o);
+
+    /** 代入によるコピー禁止 */
+    RingBuffer& operator=(const RingBuffer& o);
+};
@@ -0,0 +1,269 @@
+#pragma once
+#include <GL/glew.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "GlTrace.h"
+#include "MemoryStats.h"
+
+/**
+ * @brief print the error log of shader compile
+ *
+ * @param shader
+ * @param str
+ * @return GLboolean
+ */
+inline GLboolean printShaderInfoLog(GLuint shader, const char* str)
+{
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status == GL_FALSE)
+        std::cerr << "Compile Error in " << str << std::endl;
+
+    GLsizei bufSize;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &bufSize);
+    if (bufSize > 1)
+    {
+        std::vector<GLchar> infoLog(bufSize);
+        GLsizei length;
+        glGetShaderInfoLog(shader, bufSize, &length, &infoLog[0]);
+        std::cerr << &infoLog[0] << std::endl;
+    }
+    return static_cast<GLboolean>(status);
+}
+
+/**
+ * @brief print the error log of shader compile
+ *
+ * @param program
+ * @return GLboolean
+ */
+inline GLboolean printProgramInfoLog(GLuint program)
+{
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE)
+        std::cerr << "Link Error." << std::endl;
+
+    GLsizei bufSize;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &bufSize);
+    if (bufSize > 1)
+    {
+        std::vector<GLchar> infoLog(bufSize);
+        GLsizei length;
+        glGetProgramInfoLog(program, bufSize, &length, &infoLog[0]);
+        std::cerr << &infoLog[0] << std::endl;
+    }
+    return static_cast<GLboolean>(status);
+}
+
+/**
+ * @brief プログラムオブジェクトのバイナリの大きさを求める (取得できなければ 0)
+ *
+ * @param program
+ * @return GLint
+ */
+inline GLint getProgramBytes(GLuint program)
+{
+    GLint length(0);
+    if (GLEW_ARB_get_program_binary)
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    return length;
+}
+
+/**
+ * @brief Create a Program object
+ *
+ * @param vsrc
+ * @param fsrc
+ * @return GLuint
+ */
+inline GLuint createProgram(const std::string& vsrc, const std::string& fsrc)
+{
+    const GLuint program(glCreateProgram());
+
+    const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
+    auto charVsrc = vsrc.c_str();
+    glShaderSource(vobj, 1, &charVsrc, NULL);
+    glCompileShader(vobj);
+
+    if (printShaderInfoLog(vobj, "vertex shader"))
+    {
+        glAttachShader(program, vobj);
+    }
+    glDeleteShader(vobj);
+
+    const GLuint fobj(glCreateShader(GL_FRAGMENT_SHADER));
+    auto charFsrc = fsrc.c_str();
+    glShaderSource(fobj, 1, &charFsrc, NULL);
+    glCompileShader(fobj);
+
+    if (printShaderInfoLog(fobj, "fragment shader"))
+    {
+        glAttachShader(program, fobj);
+    }
+    glDeleteShader(fobj);
+
+    glBindAttribLocation(program, 0, "position");
+    glBindAttribLocation(program, 1, "normal");
+    // 粒子の速度も 1 番に結びつける (一つのシェーダで normal と同時には使わない)
+    glBindAttribLocation(program, 1, "velocity");
+    glBindFragDataLocation(program, 0, "fragment");
+    glLinkProgram(program);
+
+    if (printProgramInfoLog(program))
+    {
+        MemoryStats::get().allocate(MemoryStats::Category::Program, getProgramBytes(program));
+        GlTrace::createProgram(program, vsrc, fsrc);
+        return program;
+    }
+
+    glDeleteProgram(program);
+    return 0;
+}
+
+/**
+ * @brief Create a Program object that captures vertex shader outputs with transform feedback
+ *
+ * フラグメントシェーダは持たないので、GL_RASTERIZER_DISCARD を有効にして使う。
+ * in 変数 position と velocity はそれぞれ 0 番と 1 番の頂点属性に結びつける。
+ *
+ * @param vsrc
+ * @param varyings 一つのバッファに交互に書き出す out 変数の名前
+ * @return GLuint
+ */
+inline GLuint createFeedbackProgram(const std::string& vsrc,
+                                    const std::vector<const char*>& varyings)
+{
+    const GLuint program(glCreateProgram());
+
+    const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
+    auto charVsrc = vsrc.c_str();
+    glShaderSource(vobj, 1, &charVsrc, NULL);
+    glCompileShader(vobj);
+
+    if (printShaderInfoLog(vobj, "vertex shader"))
+    {
+        glAttachShader(program, vobj);
+    }
+    glDeleteShader(vobj);
+
+    glBindAttribLocation(program, 0, "position");
+    glBindAttribLocation(program, 1, "velocity");
+    glTransformFeedbackVaryings(program,
+                                static_cast<GLsizei>(varyings.size()),
+                                varyings.data(),
+                                GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(program);
+
+    if (printProgramInfoLog(program))
+    {
+        MemoryStats::get().allocate(MemoryStats::Category::Program, getProgramBytes(program));
+        return program;
+    }
+
+    glDeleteProgram(program);
+    return 0;
+}
+
+/**
+ * @brief read shader file
+ *
+ * @param name
+ * @param result
+ * @return true
+ * @return false
+ */
+inline bool readShaderSource(const std::string name, std::string& result)
+{
+    std::ifstream file(name);
+    std::stringstream ss;
+
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open file: " << name << std::endl;
+        file.close();
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        ss << line << std::endl;
+    }
+
+    result = ss.str();
+    file.close();
+    return true;
+}
+
+/**
+ * @brief ソースプログラムの #version の行の後にマクロの定義を差し込む
+ *
+ * @param source ソースプログラム
+ * @param defines 差し込む #define の行
+ */
+inline void insertDefines(std::string& source, const std::string& defines)
+{
+    if (defines.empty())
+        return;
+
+    // #version の行があればその次の行の先頭に差し込む
+    std::size_t position(0);
+    if (source.compare(0, 8, "#version") == 0)
+    {
+        const std::size_t end(source.find('\n'));
+        position = end == std::string::npos ? source.size() : end + 1;
+    }
+    source.insert(position, defines);
+}
+
+/**
+ * @brief load shader program from file
+ *
+ * @param vert
+ * @param frag
+ * @param defines 両方のソースプログラムの #version の行の後に差し込む #define の行
+ * @return GLuint
+ */
+inline GLuint loadProgram(std::string vert, std::string frag, const std::string& defines = "")
+{
+    std::string vsrc;
+    const bool vstat(readShaderSource(vert, vsrc));
+    insertDefines(vsrc, defines);
+
+    std::string fsrc;
+    const bool fstat(readShaderSource(frag, fsrc));
+    insertDefines(fsrc, defines);
+
+    return vstat && fstat ? createProgram(vsrc, fsrc) : 0;
+}
+
+/**
+ * @brief load transform feedback program from file
+ *
+ * @param vert
+ * @param varyings 一つのバッファに交互に書き出す out 変数の名前
+ * @return GLuint
+ */
+inline GLuint loadFeedbackProgram(std::string vert, const std::vector<const char*>& varyings)
+{
+    std::string vsrc;
+    return readShaderSource(vert, vsrc) ? createFeedbackProgram(vsrc, varyings) : 0;
+}
+
+/**
+ * @brief delete a program object created by createProgram() or createFeedbackProgram()
+ *
+ * @param program
+ */
+inline void deleteProgram(GLuint program)
+{
+    if (program == 0)
+        return;
+
+    MemoryStats::get().release(MemoryStats::Category::Program, getProgramBytes(program));
+    GlTrace::deleteProgram(program);
+}
@@ -23,28 +23,61 @@ public:
      * @param vertex 頂点属性を格納した配列
      * @param indexcount 頂点のインデックスの要素数
      * @param index 頂点のインデックスを格納した配列
+     * @param regions 頂点バッファオブジェクトの領域の数 (2 以上なら動的に更新する)
      */
     Shape(GLint size,
           GLsizei vertexcount,
           const Object::Vertex* vertex,
           GLsizei indexcount  = 0,
-          const GLuint* index = NULL) :
-        object(new Object(size, vertexcount, vertex, indexcount, index)),
+          const GLuint* index = NULL,
+          GLsizei regions     = 1) :
+        object(new Object(size, vertexcount, vertex, indexcount, index, regions)),
         vertexcount(vertexcount)
     {
     }
 
+    virtual ~Shape() {}
+
     /** 描画する */
     void draw() const
     {
         object->bind();
         execute();
+        object->fence();
+    }
+
+    /**
+     * @brief 詳細度を指定して描画する
+     *
+     * @param level 詳細度 (詳細度を持たない図形では無視する)
+     */
+    void draw(GLsizei level) const
+    {
+        object->bind();
+        executeLevel(level);
+        object->fence();
+    }
+
+    /**
+     * @brief 頂点属性を更新する
+     *
+     * @param vertex 頂点属性を格納した配列
+     */
+    void update(const Object::Vertex* vertex) const
+    {
+        object->update(vertex);
     }
 
     /** 描画を実行する */
     virtual void execute() const
     {
         // 折線で描画する
-        glDrawArrays(GL_LINE_LOOP, 0, vertexcount);
+        GlTrace::drawArrays(GL_LINE_LOOP, 0, vertexcount);
+    }
+
+    /** 詳細度を指定した描画の実行 */
+    virtual void executeLevel(GLsizei /*level*/) const
+    {
+        execute();
     }
 };
@@ -19,13 +19,15 @@ public:
      * @param vertex 頂点属性を格納した配列
      * @param indexcount 頂点のインデックスの要素数
      * @param index 頂点のインデックスを格納した配列
+     * @param regions 頂点バッファオブジェクトの領域の数 (2 以上なら動的に更新する)
      */
     ShapeIndex(GLint size,
                GLsizei vertexcount,
                const Object::Vertex* vertex,
                GLsizei indexcount,
-               const GLuint* index) :
-        Shape(size, vertexcount, vertex, indexcount, index),
+               const GLuint* index,
+               GLsizei regions = 1) :
+        Shape(size, vertexcount, vertex, indexcount, index, regions),
         indexcount(indexcount)
     {
     }
@@ -34,6 +36,6 @@ public:
     virtual void execute() const
     {
         // 線分群で描画する
-        glDrawElements(GL_LINES, indexcount, GL_UNSIGNED_INT, 0);
+        GlTrace::drawElements(GL_LINES, indexcount, GL_UNSIGNED_INT, 0);
     }
 };
@@ -0,0 +1,566 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "LevelOfDetail.h"
+#include "Object.h"
+
+/**
+ * 二次誤差による辺の縮約で三角形の数を減らすクラス
+ *
+ * 辺の一方の頂点をもう一方の頂点に寄せるので新しい頂点は作らず、
+ * 結果のインデックスは元の頂点配列をそのまま参照する。
+ * そのため法線などの頂点属性は保たれ、詳細度ごとのインデックスを一つの頂点配列で共有できる。
+ * 穴の縁 (一つの三角形にしか使われていない辺) の頂点は動かさない。
+ *
+ * simplify() は続けて呼び出せるので、細かい順に詳細度を作ることができる。
+ * OpenGL は使わないので、読み込みのときにも事前の変換にも使える。
+ */
+class Simplifier
+{
+    /**
+     * 平面からの距離の二乗を表す二次形式
+     */
+    struct Quadric
+    {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+        /** 加えた平面の重みの和 */
+        double w;
+
+        /** 平面 ax + by + cz + d = 0 に重み w を掛けたものを加える */
+        void add(double a, double b, double c, double d, double w)
+        {
+            a2 += w * a * a;
+            ab += w * a * b;
+            ac += w * a * c;
+            ad += w * a * d;
+            b2 += w * b * b;
+            bc += w * b * c;
+            bd += w * b * d;
+            c2 += w * c * c;
+            cd += w * c * d;
+            d2 += w * d * d;
+            this->w += w;
+        }
+
+        /** 二次形式を加える */
+        void add(const Quadric& q)
+        {
+            a2 += q.a2;
+            ab += q.ab;
+            ac += q.ac;
+            ad += q.ad;
+            b2 += q.b2;
+            bc += q.bc;
+            bd += q.bd;
+            c2 += q.c2;
+            cd += q.cd;
+            d2 += q.d2;
+            w += q.w;
+        }
+
+        /** 点 (x, y, z) での値を求める */
+        double evaluate(double x, double y, double z) const
+        {
+            return x * (a2 * x + 2.0 * (ab * y + ac * z + ad)) + y * (b2 * y + 2.0 * (bc * z + bd))
+                   + z * (c2 * z + 2.0 * cd) + d2;
+        }
+    };
+
+    /**
+     * 縮約の候補 (from を to に寄せる)
+     */
+    struct Candidate
+    {
+        /** 縮約による誤差 */
+        float cost;
+        /** 取り除く頂点 */
+        GLuint from;
+        /** 残す頂点 */
+        GLuint to;
+        /** 候補を作ったときの二つの頂点の更新回数の和 */
+        GLuint stamp;
+
+        bool operator<(const Candidate& other) const
+        {
+            // 誤差の小さいものを先に取り出す
+            return cost > other.cost;
+        }
+    };
+
+    /** 頂点属性 */
+    const std::vector<Object::Vertex>& vertex;
+
+    /**
+     * 三角形の頂点のインデックス
+     *
+     * 縮約のたびに取り除いた頂点を寄せた先の頂点に書き換えるので、
+     * 残っている三角形は常に残っている頂点を参照する。
+     */
+    std::vector<GLuint> triangles;
+
+    /** 頂点ごとの二次形式 */
+    std::vector<Quadric> quadrics;
+
+    /**
+     * 頂点を使う三角形の番号 (頂点 v の分は faceStart[v] から faceCount[v] 個)
+     *
+     * 頂点ごとの領域は作ったときから動かさず、縮約で消えた三角形を除いて前に詰める。
+     */
+    std::vector<GLuint> faces;
+
+    /** faces の中で頂点を使う三角形が始まる位置 */
+    std::vector<GLuint> faceStart;
+
+    /** 頂点を使う残っている三角形の数 */
+    std::vector<GLuint> faceCount;
+
+    /**
+     * 同じ頂点に寄せた頂点をつなぐ環状のリストの次の頂点
+     *
+     * 残っている頂点を使う三角形は、このリストの頂点の faces の領域を合わせたものになる。
+     */
+    std::vector<GLuint> cluster;
+
+    /** 寄せた先の頂点 (残っている頂点は自分自身) */
+    std::vector<GLuint> remap;
+
+    /** 頂点の二次形式を更新した回数 */
+    std::vector<GLuint> version;
+
+    /** 動かさない頂点 */
+    std::vector<bool> locked;
+
+    /** 縮約の候補 (std::push_heap() で誤差の最も小さいものを先頭に置く) */
+    std::vector<Candidate> heap;
+
+    /** 最後に heap から無効な候補を除いたときの候補の数 */
+    std::size_t compacted;
+
+    /** 縮約した頂点と隣り合う頂点 (作業用) */
+    std::vector<GLuint> neighbors;
+
+    /** 法線の違いに対する誤差の重み (辺の平均の長さの二乗を掛けて使う) */
+    double normalWeight;
+
+    /** 残っている三角形の数 */
+    GLsizei live;
+
+    /** これまでに行った縮約の最大の幾何学的な誤差の二乗 */
+    double maxError;
+
+public:
+    /**
+     * @brief Construct a new Simplifier object
+     *
+     * @param vertex 頂点属性 (Simplifier より長く保持しておくこと)
+     * @param index 三角形の頂点のインデックス
+     * @param normalWeight 法線の違いに対する誤差の重み
+     */
+    Simplifier(const std::vector<Object::Vertex>& vertex,
+               const std::vector<GLuint>& index,
+               double normalWeight = 1.0) :
+        vertex(vertex), triangles(index.begin(), index.end() - index.size() % 3),
+        quadrics(vertex.size(), Quadric {}), faces(triangles.size()), faceStart(vertex.size()),
+        faceCount(vertex.size(), 0), cluster(vertex.size()), remap(vertex.size()),
+        version(vertex.size(), 0),
+        locked(vertex.size(), false), compacted(0), normalWeight(0.0),
+        live(static_cast<GLsizei>(triangles.size() / 3)), maxError(0.0)
+    {
+        const GLuint count(static_cast<GLuint>(vertex.size()));
+        for (GLuint v = 0; v < count; ++v)
+        {
+            remap[v]   = v;
+            cluster[v] = v;
+        }
+
+        // 頂点を使う三角形の一覧を作り、三角形の平面を頂点の二次形式に加える
+        for (GLuint i : triangles)
+        {
+            ++faceCount[i];
+        }
+        GLuint start(0);
+        for (GLuint v = 0; v < count; ++v)
+        {
+            faceStart[v] = start;
+            start += faceCount[v];
+            faceCount[v] = 0;
+        }
+        double edgeLength(0.0);
+        for (GLuint t = 0; t < triangles.size() / 3; ++t)
+        {
+            const GLuint* const corner(&triangles[t * 3]);
+            for (int k = 0; k < 3; ++k)
+            {
+                faces[faceStart[corner[k]] + faceCount[corner[k]]++] = t;
+            }
+
+            double n[3];
+            const double area(getNormal(corner[0], corner[1], corner[2], n));
+            edgeLength += distance(corner[0], corner[1]);
+            if (area <= 0.0)
+                continue;
+
+            const GLfloat* const p(vertex[corner[0]].position);
+            const double d(-(n[0] * p[0] + n[1] * p[1] + n[2] * p[2]));
+            for (int k = 0; k < 3; ++k)
+            {
+                quadrics[corner[k]].add(n[0], n[1], n[2], d, area);
+            }
+        }
+        if (live > 0)
+        {
+            edgeLength /= live;
+            this->normalWeight = normalWeight * edgeLength * edgeLength;
+        }
+
+        // 辺を数えて、一つの三角形にしか使われていない辺の頂点は動かさない
+        std::vector<std::uint64_t> edges;
+        edges.reserve(triangles.size());
+        for (std::size_t t = 0; t < triangles.size(); t += 3)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                const GLuint a(triangles[t + k]), b(triangles[t + (k + 1) % 3]);
+                edges.push_back(static_cast<std::uint64_t>(std::min(a, b)) << 32 | std::max(a, b));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (std::size_t i = 0; i < edges.size();)
+        {
+            std::size_t j(i + 1);
+            while (j < edges.size() && edges[j] == edges[i])
+                ++j;
+
+            const GLuint a(static_cast<GLuint>(edges[i] >> 32));
+            const GLuint b(static_cast<GLuint>(edges[i] & 0xffffffffu));
+            if (j - i == 1)
+            {
+                locked[a] = locked[b] = true;
+            }
+            else
+            {
+                push(a, b);
+            }
+            i = j;
+        }
+        compacted = heap.size();
+    }
+
+    /**
+     * @brief 三角形の数が目標以下になるまで辺を縮約する
+     *
+     * 縮約できる辺がなくなれば目標に届かなくても終わる
+     *
+     * @param target 目標の三角形の数
+     * @return GLsizei 残った三角形の数
+     */
+    GLsizei simplify(GLsizei target)
+    {
+        while (live > target && !heap.empty())
+        {
+            if (heap.size() > 2 * compacted)
+                compact();
+            std::pop_heap(heap.begin(), heap.end());
+            const Candidate c(heap.back());
+            heap.pop_back();
+            if (!isValid(c))
+                continue;
+
+            collapse(c.from, c.to);
+        }
+        return live;
+    }
+
+    /**
+     * @brief 三角形の数を元の割合に減らす
+     *
+     * @param ratio 元の三角形の数に対する割合
+     * @return GLsizei 残った三角形の数
+     */
+    GLsizei simplifyRatio(double ratio)
+    {
+        return simplify(static_cast<GLsizei>(static_cast<double>(triangles.size() / 3) * ratio));
+    }
+
+    /**
+     * @brief 残っている三角形の頂点のインデックスを取り出す
+     *
+     * @param index 三角形の頂点のインデックスの格納先
+     */
+    void getIndex(std::vector<GLuint>& index)
+    {
+        index.clear();
+        index.reserve(live * 3);
+        for (std::size_t t = 0; t < triangles.size(); t += 3)
+        {
+            const GLuint a(triangles[t]), b(triangles[t + 1]), c(triangles[t + 2]);
+            if (a != b && b != c && c != a)
+            {
+                index.push_back(a);
+                index.push_back(b);
+                index.push_back(c);
+            }
+        }
+    }
+
+    /** 残っている三角形の数を返す */
+    GLsizei getTriangles() const
+    {
+        return live;
+    }
+
+    /** これまでに行った縮約の最大の幾何学的な誤差 (長さ) を返す */
+    GLfloat getError() const
+    {
+        return static_cast<GLfloat>(std::sqrt(maxError));
+    }
+
+private:
+    /** 二つの頂点の距離を求める */
+    double distance(GLuint a, GLuint b) const
+    {
+        const GLfloat* const p(vertex[a].position);
+        const GLfloat* const q(vertex[b].position);
+        const double x(q[0] - p[0]), y(q[1] - p[1]), z(q[2] - p[2]);
+        return std::sqrt(x * x + y * y + z * z);
+    }
+
+    /**
+     * @brief 三角形の単位法線ベクトルを求める
+     *
+     * @return double 三角形の面積 (縮退していれば 0)
+     */
+    double getNormal(GLuint a, GLuint b, GLuint c, double* n) const
+    {
+        return getNormal(vertex[a].position, vertex[b].position, vertex[c].position, n);
+    }
+
+    static double getNormal(const GLfloat* p0, const GLfloat* p1, const GLfloat* p2, double* n)
+    {
+        const double u[] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        const double v[] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        n[0] = u[1] * v[2] - u[2] * v[1];
+        n[1] = u[2] * v[0] - u[0] * v[2];
+        n[2] = u[0] * v[1] - u[1] * v[0];
+        const double length(std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]));
+        if (length <= 0.0)
+            return 0.0;
+
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        return length * 0.5;
+    }
+
+    /** from を to に寄せたときの幾何学的な誤差の二乗 (面積で重み付けした平均) を求める */
+    double getGeometricError(GLuint from, GLuint to) const
+    {
+        Quadric q(quadrics[from]);
+        q.add(quadrics[to]);
+        const GLfloat* const p(vertex[to].position);
+        return q.w > 0.0 ? std::max(q.evaluate(p[0], p[1], p[2]), 0.0) / q.w : 0.0;
+    }
+
+    /**
+     * @brief 辺 ab を縮約の候補に加える (誤差の小さい向きを選ぶ)
+     *
+     * 面積の小さいところから縮約するように誤差は重み付けした和のまま比べ、法線の違いも加える
+     */
+    void push(GLuint a, GLuint b)
+    {
+        const bool fromA(!locked[a]), fromB(!locked[b]);
+        if (!fromA && !fromB)
+            return;
+
+        Quadric q(quadrics[a]);
+        q.add(quadrics[b]);
+        const GLfloat* const n(vertex[a].normal);
+        const GLfloat* const m(vertex[b].normal);
+        const double cosine(n[0] * m[0] + n[1] * m[1] + n[2] * m[2]);
+        const double penalty(normalWeight * q.w * std::max(1.0 - cosine, 0.0));
+
+        const GLfloat* const pa(vertex[a].position);
+        const GLfloat* const pb(vertex[b].position);
+        const double costA(fromA ? q.evaluate(pb[0], pb[1], pb[2]) : 0.0);
+        const double costB(fromB ? q.evaluate(pa[0], pa[1], pa[2]) : 0.0);
+        if (fromA && (!fromB || costA <= costB))
+        {
+            heap.push_back({static_cast<float>(costA + penalty), a, b, version[a] + version[b]});
+        }
+        else
+        {
+            heap.push_back({static_cast<float>(costB + penalty), b, a, version[a] + version[b]});
+        }
+        std::push_heap(heap.begin(), heap.end());
+    }
+
+    /** 候補がまだ使えるか */
+    bool isValid(const Candidate& c) const
+    {
+        // 既に取り除いた頂点を含む候補や、二次形式が変わって入れ直した候補は使えない
+        return remap[c.from] == c.from && remap[c.to] == c.to
+               && c.stamp == version[c.from] + version[c.to];
+    }
+
+    /**
+     * @brief 使えなくなった候補を heap から除く
+     *
+     * 縮約のたびに候補を入れ直すので、除かなければ heap は残っている辺の数倍に膨らむ。
+     * 前に除いたときの倍になったら除くので、一回の縮約あたりの手間は定数で済む。
+     */
+    void compact()
+    {
+        heap.erase(std::remove_if(heap.begin(),
+                                  heap.end(),
+                                  [this](const Candidate& c) { return !isValid(c); }),
+                   heap.end());
+        std::make_heap(heap.begin(), heap.end());
+        compacted = std::max(heap.size(), static_cast<std::size_t>(1024));
+    }
+
+    /**
+     * @brief from を to に寄せる
+     *
+     * 周りの三角形が裏返るなら何もしない
+     */
+    void collapse(GLuint from, GLuint to)
+    {
+        // 縮約で消える三角形を数え、残る三角形が裏返らないか確かめる
+        GLsizei removed(0);
+        GLuint u(from);
+        do
+        {
+            const GLuint* const list(&faces[faceStart[u]]);
+            for (GLuint k = 0; k < faceCount[u]; ++k)
+            {
+                const GLuint* const corner(&triangles[list[k] * 3]);
+                const GLuint a(corner[0]), b(corner[1]), c(corner[2]);
+                if (a == b || b == c || c == a)
+                    continue;
+                if (a == to || b == to || c == to)
+                {
+                    ++removed;
+                    continue;
+                }
+
+                const GLfloat* p[] = {vertex[a].position, vertex[b].position, vertex[c].position};
+                double before[3], after[3];
+                getNormal(p[0], p[1], p[2], before);
+                p[a == from ? 0 : b == from ? 1 : 2] = vertex[to].position;
+                if (getNormal(p[0], p[1], p[2], after) <= 0.0
+                    || before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0)
+                    return;
+            }
+            u = cluster[u];
+        } while (u != from);
+
+        // 頂点を寄せて二次形式を引き継ぐ
+        maxError = std::max(maxError, getGeometricError(from, to));
+        remap[from] = to;
+        quadrics[to].add(quadrics[from]);
+        ++version[to];
+        live -= removed;
+
+        // 二つのリストをつないで残った三角形を引き継ぎ、三角形の頂点を寄せた先に書き換えて、
+        // 消えた三角形を一覧から除く
+        std::swap(cluster[from], cluster[to]);
+        neighbors.clear();
+        GLuint previous(to);
+        u = to;
+        do
+        {
+            GLuint* const list(&faces[faceStart[u]]);
+            GLuint n(0);
+            for (GLuint k = 0; k < faceCount[u]; ++k)
+            {
+                const GLuint t(list[k]);
+                GLuint* const corner(&triangles[t * 3]);
+                for (int j = 0; j < 3; ++j)
+                {
+                    if (corner[j] == from)
+                        corner[j] = to;
+                }
+                const GLuint a(corner[0]), b(corner[1]), c(corner[2]);
+                if (a == b || b == c || c == a)
+                    continue;
+
+                list[n++] = t;
+                neighbors.push_back(a == to ? b : a);
+                neighbors.push_back(c == to ? b : c);
+            }
+            faceCount[u] = n;
+
+            // 使う三角形がなくなった頂点はリストから外す
+            const GLuint following(cluster[u]);
+            if (n == 0 && u != to)
+            {
+                cluster[previous] = following;
+                cluster[u]        = u;
+            }
+            else
+            {
+                previous = u;
+            }
+            u = following;
+        } while (u != to);
+
+        // 寄せた頂点と隣り合う頂点の辺を候補に加え直す
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (GLuint v : neighbors)
+        {
+            push(to, v);
+        }
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    Simplifier(const Simplifier& s);
+
+    /** 代入によるコピー禁止 */
+    Simplifier& operator=(const Simplifier& s);
+};
+
+/**
+ * @brief 三角形の数を一定の割合で減らした詳細度を作成する
+ *
+ * 詳細度 0 は元のインデックスそのままで、全ての詳細度が同じ頂点配列を参照する
+ *
+ * @param vertex 頂点属性
+ * @param index 三角形の頂点のインデックス
+ * @param levels 詳細度の数
+ * @param ratio 一つ前の詳細度に対する三角形の数の割合
+ * @param lodIndex 全ての詳細度の三角形の頂点のインデックスの格納先
+ * @param lod 詳細度ごとのインデックスの範囲の格納先
+ */
+inline void createSimplifiedLod(const std::vector<Object::Vertex>& vertex,
+                                const std::vector<GLuint>& index,
+                                int levels,
+                                double ratio,
+                                std::vector<GLuint>& lodIndex,
+                                LevelOfDetail& lod)
+{
+    lodIndex.assign(index.begin(), index.end());
+    lod.add(0, static_cast<GLsizei>(index.size()), 0.0f);
+
+    Simplifier simplifier(vertex, index);
+    std::vector<GLuint> levelIndex;
+    GLsizei triangles(static_cast<GLsizei>(index.size() / 3));
+    for (int level = 1; level < levels; ++level)
+    {
+        // 目標に届かなくなったらそれ以上は作らない
+        const GLsizei target(static_cast<GLsizei>(triangles * ratio));
+        if (simplifier.simplify(target) >= triangles)
+            break;
+
+        triangles = simplifier.getTriangles();
+        simplifier.getIndex(levelIndex);
+        lod.add(static_cast<GLsizei>(lodIndex.size()),
+                static_cast<GLsizei>(levelIndex.size()),
+                simplifier.getError());
+        lodIndex.insert(lodIndex.end(), levelIndex.begin(), levelIndex.end());
+    }
+}
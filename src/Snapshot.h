@@ -0,0 +1,50 @@
+#pragma once
+#include <GL/glew.h>
+#include <vector>
+#include "Matrix.h"
+#include "Shape.h"
+#include "Vector.h"
+
+/**
+ * 一回の描画に必要なデータ
+ */
+struct DrawPacket
+{
+    /** 描画する図形 */
+    const Shape* shape;
+
+    /** 材質の番号 */
+    unsigned int material;
+
+    /** 詳細度 */
+    GLsizei level;
+
+    /** モデルビュー変換行列 */
+    Matrix modelView;
+
+    /** 法線ベクトルの変換行列 */
+    GLfloat normalMatrix[9];
+};
+
+/**
+ * シミュレーションのスレッドが作成し、描画のスレッドが読み出す一フレーム分のデータ
+ *
+ * 領域ごとに使い回すので、配列の容量は一度確保したら解放しない
+ */
+struct Snapshot
+{
+    /** フレームバッファのサイズ */
+    GLsizei viewport[2];
+
+    /** 透視投影変換行列 */
+    Matrix projection;
+
+    /** 視点座標系における光源の位置 */
+    std::vector<Vector> lights;
+
+    /** 描画するもの */
+    std::vector<DrawPacket> draws;
+
+    /** このフレームに反映した最初の入力の時刻 (なければ負) */
+    double inputTime;
+};
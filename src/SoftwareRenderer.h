@@ -0,0 +1,863 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FrameArena.h"
+#include "Image.h"
+#include "LevelOfDetail.h"
+#include "Material.h"
+#include "Matrix.h"
+#include "MemoryStats.h"
+#include "Object.h"
+#include "Shape.h"
+#include "Snapshot.h"
+#include "TaskPool.h"
+#include "Vector.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOFTWARE_RENDERER_SSE2 1
+#endif
+
+/**
+ * OpenGL を使わずに CPU でフレームを描画するクラス
+ *
+ * point.vert と point.frag と同じ Blinn-Phong の陰影付けを画素ごとに行い、
+ * メモリ上のカラーバッファとデプスバッファに描く。
+ * 頂点の変換と三角形の準備は描画の単位に分けて、ラスタライズは画面を分割したタイルごとに
+ * 複数のスレッドで分担する。画素は横に 4 個ずつ SIMD 命令で内外と深度を判定する。
+ *
+ * 背面カリング (反時計回りが表)、GL_LESS のデプステスト、視点の手前の面でのクリッピングは
+ * main() の OpenGL の設定に合わせている。カラーバッファは glReadPixels() と同じく
+ * 下の行から順に並べる。
+ * フレームごとに作りなおす表と準備した三角形は FrameArena に置くので、
+ * 描く量が前のフレームを超えなければヒープから確保しない。
+ * finish() は呼び出したスレッドの FrameArena::local() を使うので、
+ * フレームの終わりにそれを reset() すること。
+ */
+class SoftwareRenderer
+{
+public:
+    /**
+     * 描画する図形の頂点属性とインデックス
+     */
+    struct Mesh
+    {
+        /** 頂点の数 */
+        GLsizei vertexcount;
+        /** 頂点属性を格納した配列 */
+        const Object::Vertex* vertex;
+        /** 三角形の頂点のインデックスの要素数 */
+        GLsizei indexcount;
+        /** 三角形の頂点のインデックスを格納した配列 */
+        const GLuint* index;
+        /** 詳細度 (なければ NULL) */
+        const LevelOfDetail* lod;
+    };
+
+private:
+    /** タイルの幅と高さ (画素) */
+    static constexpr int tileSize = 32;
+
+    /** 一つの準備の仕事で扱う三角形の数 */
+    static constexpr GLsizei batchSize = 2048;
+
+    /** 光源の数の上限 */
+    static constexpr int maxLights = 8;
+
+    /**
+     * 頂点の変換の結果
+     */
+    struct Varying
+    {
+        /** クリップ座標 */
+        GLfloat clip[4];
+        /** 視点座標系の位置 */
+        GLfloat p[3];
+        /** 視点座標系の法線ベクトル */
+        GLfloat n[3];
+    };
+
+    /**
+     * 画面上に変換した三角形
+     */
+    struct Triangle
+    {
+        /** 辺の関数 a * x + b * y + c の係数 (内側で非負) */
+        GLfloat a[3], b[3], c[3];
+        /** 平面の原点 (頂点 0 の画面上の位置) */
+        GLfloat ox, oy;
+        /** 深度の平面 (原点からの差で求める) */
+        GLfloat z[3];
+        /** 1 / w の平面 */
+        GLfloat w[3];
+        /** 視点座標系の位置と法線ベクトルを w で割ったものの平面 */
+        GLfloat attribute[6][3];
+        /** 材質の番号 */
+        unsigned int material;
+        /** 画素の範囲 */
+        int x0, y0, x1, y1;
+    };
+
+    /**
+     * 描画の単位
+     */
+    struct Draw
+    {
+        /** 頂点属性とインデックス */
+        const Mesh* mesh;
+        /** 描く三角形のインデックスの範囲 */
+        GLsizei first, count;
+        /** 材質の番号 */
+        unsigned int material;
+        /** モデルビュー変換行列 */
+        Matrix modelView;
+        /** 法線ベクトルの変換行列 */
+        GLfloat normalMatrix[9];
+        /** インデックスが参照する頂点の範囲 */
+        GLuint base, vertices;
+        /** 変換した頂点の先頭の位置 */
+        std::size_t varying;
+    };
+
+    /**
+     * インデックスの範囲が参照する頂点の範囲
+     */
+    struct Range
+    {
+        /** インデックスの要素数 */
+        GLsizei count;
+        /** 頂点の範囲 */
+        GLuint base, vertices;
+    };
+
+    /** インデックスの範囲の先頭から参照する頂点の範囲を引く表 */
+    using RangeMap = std::unordered_map<const GLuint*,
+                                        Range,
+                                        std::hash<const GLuint*>,
+                                        std::equal_to<const GLuint*>,
+                                        FrameAllocator<std::pair<const GLuint* const, Range>>>;
+
+    /**
+     * 三角形の準備の仕事 (描画の順に並べ、小さな描画の単位はまとめる)
+     *
+     * 準備はどのスレッドが受け持つかわからないので、仕事ごとにアリーナを持つ
+     */
+    struct Batch
+    {
+        /** 最初の描画の単位の番号 */
+        std::size_t draw;
+        /** 最初の描画の単位で描く三角形のインデックスの先頭 */
+        GLsizei first;
+        /** 描画の単位をまたいで描く三角形のインデックスの要素数 */
+        GLsizei count;
+        /** 準備した三角形とタイルごとの番号を置くアリーナ */
+        FrameArena arena;
+        /** 準備した三角形 */
+        FrameVector<Triangle> triangles;
+        /** タイルごとの三角形の番号 */
+        std::vector<FrameVector<GLuint>> bins;
+
+        Batch() :
+            draw(0), first(0), count(0), arena(16 * 1024),
+            triangles(FrameAllocator<Triangle>(arena))
+        {
+        }
+    };
+
+    /** フレームバッファの幅と高さ */
+    const int width, height;
+
+    /** バッファの一行の画素数 (4 の倍数) */
+    const int stride;
+
+    /** 横と縦のタイルの数 */
+    const int tilesX, tilesY;
+
+    /** カラーバッファ (RGBA8 を一つの値にしたもの) */
+    std::vector<std::uint32_t> color;
+
+    /** デプスバッファ */
+    std::vector<GLfloat> depth;
+
+    /** 詰めて並べた RGBA の画素 */
+    std::vector<unsigned char> pixels;
+
+    /** 消去する色 */
+    std::uint32_t clearColor;
+
+    /** 材質 */
+    std::vector<Material> materials;
+
+    /** 光源の数 */
+    int lightCount;
+
+    /** 光源の位置 (視点座標系) と環境光・拡散反射光・鏡面反射光成分 */
+    GLfloat lightPosition[maxLights][4], lightAmbient[maxLights][3],
+        lightDiffuse[maxLights][3], lightSpecular[maxLights][3];
+
+    /** 透視投影変換行列 */
+    Matrix projection;
+
+    /** 図形ごとの頂点属性とインデックス */
+    std::unordered_map<const Shape*, Mesh> meshes;
+
+    /** このフレームの描画の単位 */
+    std::vector<Draw> draws;
+
+    /** このフレームで変換した頂点 */
+    std::vector<Varying> varyings;
+
+    /** 三角形の準備の仕事 (アリーナを使い回すので追加しても移動しない) */
+    std::deque<Batch> batches;
+
+    /** 使っている準備の仕事の数 */
+    std::size_t batchCount;
+
+    /** 仕事を分担するスレッド */
+    TaskPool pool;
+
+public:
+    /**
+     * @brief Construct a new SoftwareRenderer object
+     *
+     * @param width フレームバッファの幅
+     * @param height フレームバッファの高さ
+     * @param threads 仕事を分担するスレッドの数 (0 ならコアの数)
+     */
+    SoftwareRenderer(int width, int height, unsigned int threads = 0) :
+        width(std::max(width, 1)), height(std::max(height, 1)),
+        stride((this->width + 3) & ~3), tilesX((this->width + tileSize - 1) / tileSize),
+        tilesY((this->height + tileSize - 1) / tileSize), color(stride * this->height, 0),
+        depth(stride * this->height, 1.0f), pixels(this->width * this->height * 4, 0),
+        clearColor(0), lightCount(0), projection(Matrix::identity()), batchCount(0),
+        pool(threads)
+    {
+        MemoryStats::get().allocate(MemoryStats::Category::Framebuffer, getFramebufferBytes());
+    }
+
+    virtual ~SoftwareRenderer()
+    {
+        MemoryStats::get().release(MemoryStats::Category::Framebuffer, getFramebufferBytes());
+    }
+
+    /** フレームバッファの幅を返す */
+    int getWidth() const
+    {
+        return width;
+    }
+
+    /** フレームバッファの高さを返す */
+    int getHeight() const
+    {
+        return height;
+    }
+
+    /** カラーバッファとデプスバッファと詰めて並べた画素のバイト数を返す */
+    std::size_t getFramebufferBytes() const
+    {
+        return color.size() * sizeof(std::uint32_t) + depth.size() * sizeof(GLfloat)
+               + pixels.size();
+    }
+
+    /** 仕事を分担するスレッドの数を返す */
+    unsigned int getThreads() const
+    {
+        return pool.getThreads();
+    }
+
+    /** 消去する色を設定する (glClearColor() と同じ) */
+    void setClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+    {
+        clearColor = pack(r, g, b, a);
+    }
+
+    /**
+     * @brief 材質を設定する (MaterialTable に格納したものと同じ番号で引く)
+     *
+     * @param data 材質を格納した配列
+     * @param count 材質の数
+     */
+    void setMaterials(const Material* data, unsigned int count)
+    {
+        materials.assign(data, data + count);
+    }
+
+    /**
+     * @brief 光源の成分を設定する (uniform 変数の Lamb, Ldiff, Lspec と同じ並び)
+     *
+     * @param count 光源の数
+     * @param ambient 環境光成分
+     * @param diffuse 拡散反射光成分
+     * @param specular 鏡面反射光成分
+     */
+    void setLights(int count,
+                   const GLfloat* ambient,
+                   const GLfloat* diffuse,
+                   const GLfloat* specular)
+    {
+        lightCount = std::min(std::max(count, 0), maxLights);
+        for (int i = 0; i < lightCount; ++i)
+        {
+            std::copy(ambient + i * 3, ambient + i * 3 + 3, lightAmbient[i]);
+            std::copy(diffuse + i * 3, diffuse + i * 3 + 3, lightDiffuse[i]);
+            std::copy(specular + i * 3, specular + i * 3 + 3, lightSpecular[i]);
+        }
+    }
+
+    /**
+     * @brief 図形に頂点属性とインデックスを対応づける
+     *
+     * render() は DrawPacket の図形からここで対応づけたものを探して描く。
+     * 頂点属性とインデックスは描画が終わるまで保持しておくこと。
+     *
+     * @param shape 図形
+     * @param mesh 図形の頂点属性とインデックス
+     */
+    void addShape(const Shape* shape, const Mesh& mesh)
+    {
+        meshes[shape] = mesh;
+    }
+
+    /**
+     * @brief フレームの描画を始める
+     *
+     * @param projection 透視投影変換行列
+     * @param lights 視点座標系における光源の位置 (setLights() で設定した数)
+     */
+    void begin(const Matrix& projection, const Vector* lights)
+    {
+        this->projection = projection;
+        for (int i = 0; i < lightCount; ++i)
+        {
+            std::copy(lights[i].begin(), lights[i].end(), lightPosition[i]);
+        }
+        draws.clear();
+    }
+
+    /**
+     * @brief 図形の描画を加える
+     *
+     * 材質は setMaterials() で設定しておくこと。
+     *
+     * @param mesh 図形の頂点属性とインデックス (finish() まで保持しておくこと)
+     * @param level 詳細度 (詳細度を持たない図形では無視する)
+     * @param material 材質の番号
+     * @param modelView モデルビュー変換行列
+     * @param normalMatrix 法線ベクトルの変換行列
+     */
+    void draw(const Mesh& mesh,
+              GLsizei level,
+              unsigned int material,
+              const Matrix& modelView,
+              const GLfloat* normalMatrix)
+    {
+        // 材質がなければ描けない
+        if (materials.empty())
+            return;
+
+        Draw d;
+        d.mesh  = &mesh;
+        d.first = 0;
+        d.count = mesh.indexcount;
+        if (mesh.lod != NULL && level >= 0 && level < mesh.lod->getLevels())
+        {
+            const LevelOfDetail::Level& l(mesh.lod->getLevel(level));
+            d.first = l.first;
+            d.count = l.count;
+        }
+
+        d.material  = std::min(material, static_cast<unsigned int>(materials.size()) - 1);
+        d.modelView = modelView;
+        std::copy(normalMatrix, normalMatrix + 9, d.normalMatrix);
+        draws.push_back(d);
+    }
+
+    /** 加えた描画をフレームバッファに描く */
+    void finish()
+    {
+        // 詳細度ごとに頂点を分けた図形では使う頂点だけを変換する
+        // (表はこのフレームの間だけ使うので呼び出したスレッドのアリーナに置く)
+        RangeMap ranges;
+        for (Draw& d : draws)
+        {
+            const GLuint* const index(d.mesh->index);
+            Range& range(ranges[index + d.first]);
+            if (range.count != d.count || d.count == 0)
+            {
+                GLuint low(d.count > 0 ? index[d.first] : 0), high(low);
+                for (GLsizei i = d.first; i < d.first + d.count; ++i)
+                {
+                    low  = std::min(low, index[i]);
+                    high = std::max(high, index[i]);
+                }
+                range = {d.count, low, d.count > 0 ? high - low + 1 : 0};
+            }
+            d.base     = range.base;
+            d.vertices = range.vertices;
+        }
+
+        // 頂点を描画の単位ごとに変換する
+        std::size_t total(0);
+        for (Draw& d : draws)
+        {
+            d.varying = total;
+            total += d.vertices;
+        }
+        varyings.resize(total);
+        pool.run(static_cast<int>(draws.size()), [this](int i) { transform(draws[i]); });
+
+        // 三角形を描画の順に区切って準備する仕事に分ける (小さな描画の単位はまとめる)
+        batchCount = 0;
+        GLsizei filled(batchSize);
+        for (std::size_t i = 0; i < draws.size(); ++i)
+        {
+            const GLsizei triangles(draws[i].count / 3);
+            for (GLsizei t = 0; t < triangles;)
+            {
+                if (filled == batchSize)
+                {
+                    if (batchCount == batches.size())
+                        batches.emplace_back();
+                    Batch& batch(batches[batchCount++]);
+                    batch.draw  = i;
+                    batch.first = draws[i].first + t * 3;
+                    batch.count = 0;
+                    filled      = 0;
+                }
+                const GLsizei n(std::min(batchSize - filled, triangles - t));
+                batches[batchCount - 1].count += n * 3;
+                filled += n;
+                t += n;
+            }
+        }
+        pool.run(static_cast<int>(batchCount), [this](int i) { setup(batches[i]); });
+
+        // タイルごとに描いてから画素を詰めて並べる
+        pool.run(tilesX * tilesY, [this](int tile) { rasterizeTile(tile); });
+        for (int y = 0; y < height; ++y)
+        {
+            std::memcpy(&pixels[y * width * 4], &color[y * stride], width * 4);
+        }
+    }
+
+    /**
+     * @brief 描画のスレッドが受け取るフレームを描く
+     *
+     * @param frame フレーム (図形は addShape() で対応づけておくこと)
+     */
+    void render(const Snapshot& frame)
+    {
+        begin(frame.projection, frame.lights.data());
+        for (const DrawPacket& packet : frame.draws)
+        {
+            const auto mesh(meshes.find(packet.shape));
+            if (mesh != meshes.end())
+                draw(mesh->second,
+                     packet.level,
+                     packet.material,
+                     packet.modelView,
+                     packet.normalMatrix);
+        }
+        finish();
+    }
+
+    /** 描いた RGBA の画素を返す (下の行から順に並ぶ) */
+    const unsigned char* getPixels() const
+    {
+        return pixels.data();
+    }
+
+    /** 描いた画像を PNG ファイルに書き出す */
+    bool write(const std::string& name) const
+    {
+        return Image::writePng(name, width, height, pixels.data());
+    }
+
+    /** 直前のフレームでラスタライズした三角形の数を返す */
+    std::size_t getTriangles() const
+    {
+        std::size_t count(0);
+        for (std::size_t i = 0; i < batchCount; ++i)
+        {
+            count += batches[i].triangles.size();
+        }
+        return count;
+    }
+
+private:
+    /** 視点の手前の面を表す w の最小値 */
+    static constexpr GLfloat nearW = 1.0e-5f;
+
+    /** 0 から 1 の色を RGBA8 の値にする */
+    static std::uint32_t pack(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+    {
+        const GLfloat c[] = {r, g, b, a};
+        std::uint32_t value(0);
+        for (int i = 0; i < 4; ++i)
+        {
+            const GLfloat v(std::min(std::max(c[i], 0.0f), 1.0f));
+            value |= static_cast<std::uint32_t>(v * 255.0f + 0.5f) << (i * 8);
+        }
+        return value;
+    }
+
+    /** 描画の単位の頂点をクリップ座標系と視点座標系に変換する (point.vert) */
+    void transform(const Draw& d)
+    {
+        const Matrix& mv(d.modelView);
+        const GLfloat* const nm(d.normalMatrix);
+        Varying* const out(&varyings[d.varying]);
+        for (GLuint i = 0; i < d.vertices; ++i)
+        {
+            const Object::Vertex& v(d.mesh->vertex[d.base + i]);
+            Varying& o(out[i]);
+            GLfloat p[4];
+            for (int r = 0; r < 4; ++r)
+            {
+                p[r] = mv[r] * v.position[0] + mv[4 + r] * v.position[1]
+                       + mv[8 + r] * v.position[2] + mv[12 + r];
+            }
+            for (int r = 0; r < 4; ++r)
+            {
+                o.clip[r] = projection[r] * p[0] + projection[4 + r] * p[1]
+                            + projection[8 + r] * p[2] + projection[12 + r] * p[3];
+            }
+
+            // 視点座標系の位置は同次座標を正規化しておく
+            const GLfloat iw(p[3] != 0.0f ? 1.0f / p[3] : 1.0f);
+            GLfloat length(0.0f);
+            for (int r = 0; r < 3; ++r)
+            {
+                o.p[r] = p[r] * iw;
+                o.n[r] = nm[r] * v.normal[0] + nm[3 + r] * v.normal[1] + nm[6 + r] * v.normal[2];
+                length += o.n[r] * o.n[r];
+            }
+            const GLfloat inv(length > 0.0f ? 1.0f / std::sqrt(length) : 0.0f);
+            for (int r = 0; r < 3; ++r)
+            {
+                o.n[r] *= inv;
+            }
+        }
+    }
+
+    /** 三角形を視点の手前の面で切り取り、画面上に変換してタイルに振り分ける */
+    void setup(Batch& batch)
+    {
+        // 前のフレームの三角形を容量ごと捨ててからアリーナを空にする
+        const FrameAllocator<GLuint> allocator(batch.arena);
+        batch.triangles = FrameVector<Triangle>(allocator);
+        batch.bins.clear();
+        batch.bins.assign(tilesX * tilesY, FrameVector<GLuint>(allocator));
+        batch.arena.reset();
+
+        // 切り取らなければ三角形は増えないので、伸ばしたときに残る領域を作らない
+        batch.triangles.reserve(batch.count / 3);
+
+        // 小さな描画の単位はまとめてあるので、描画の単位をまたいで進める
+        std::size_t draw(batch.draw);
+        GLsizei first(batch.first), remaining(batch.count);
+        while (remaining > 0)
+        {
+            const Draw& d(draws[draw]);
+            const GLuint* const index(d.mesh->index);
+            const Varying* const v(&varyings[d.varying]);
+            const GLsizei end(std::min(first + remaining, d.first + d.count / 3 * 3));
+            remaining -= end - first;
+            for (GLsizei i = first; i < end; i += 3)
+            {
+                const Varying* const corner[] = {&v[index[i] - d.base],
+                                                 &v[index[i + 1] - d.base],
+                                                 &v[index[i + 2] - d.base]};
+
+                // 全ての頂点が手前の面の内側にあればそのまま描く
+                int inside(0);
+                for (const Varying* c : corner)
+                {
+                    inside += c->clip[2] >= -c->clip[3];
+                }
+                if (inside == 3)
+                {
+                    emit(batch, d.material, *corner[0], *corner[1], *corner[2]);
+                    continue;
+                }
+                if (inside == 0)
+                    continue;
+
+                // 手前の面 z = -w で切り取った多角形を扇形に分ける
+                Varying polygon[4];
+                int n(0);
+                for (int k = 0; k < 3; ++k)
+                {
+                    const Varying& a(*corner[k]);
+                    const Varying& b(*corner[(k + 1) % 3]);
+                    const GLfloat da(a.clip[2] + a.clip[3]), db(b.clip[2] + b.clip[3]);
+                    if (da >= 0.0f)
+                        polygon[n++] = a;
+                    if ((da >= 0.0f) != (db >= 0.0f))
+                        polygon[n++] = lerp(a, b, da / (da - db));
+                }
+                for (int k = 1; k + 1 < n; ++k)
+                {
+                    emit(batch, d.material, polygon[0], polygon[k], polygon[k + 1]);
+                }
+            }
+            if (remaining > 0)
+                first = draws[++draw].first;
+        }
+    }
+
+    /** 二つの頂点の間を線形補間する */
+    static Varying lerp(const Varying& a, const Varying& b, GLfloat t)
+    {
+        Varying r;
+        for (int i = 0; i < 4; ++i)
+        {
+            r.clip[i] = a.clip[i] + (b.clip[i] - a.clip[i]) * t;
+        }
+        for (int i = 0; i < 3; ++i)
+        {
+            r.p[i] = a.p[i] + (b.p[i] - a.p[i]) * t;
+            r.n[i] = a.n[i] + (b.n[i] - a.n[i]) * t;
+        }
+        return r;
+    }
+
+    /** 手前の面の内側にある三角形を画面上に変換してタイルに振り分ける */
+    void emit(Batch& batch,
+              unsigned int material,
+              const Varying& v0,
+              const Varying& v1,
+              const Varying& v2) const
+    {
+        const Varying* const v[] = {&v0, &v1, &v2};
+        GLfloat x[3], y[3], z[3], w[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            const GLfloat cw(std::max(v[i]->clip[3], nearW));
+            w[i] = 1.0f / cw;
+            x[i] = (v[i]->clip[0] * w[i] * 0.5f + 0.5f) * static_cast<GLfloat>(width);
+            y[i] = (v[i]->clip[1] * w[i] * 0.5f + 0.5f) * static_cast<GLfloat>(height);
+            z[i] = v[i]->clip[2] * w[i] * 0.5f + 0.5f;
+        }
+
+        // 裏向きか面積のない三角形は描かない
+        const GLfloat area((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]));
+        if (!(area > 0.0f))
+            return;
+
+        Triangle t;
+        t.x0 = std::max(static_cast<int>(std::floor(std::min({x[0], x[1], x[2]}))), 0);
+        t.y0 = std::max(static_cast<int>(std::floor(std::min({y[0], y[1], y[2]}))), 0);
+        t.x1 = std::min(static_cast<int>(std::ceil(std::max({x[0], x[1], x[2]}))), width - 1);
+        t.y1 = std::min(static_cast<int>(std::ceil(std::max({y[0], y[1], y[2]}))), height - 1);
+        if (t.x0 > t.x1 || t.y0 > t.y1)
+            return;
+
+        // 辺 i は頂点 i から頂点 i + 1 へ向かう
+        for (int i = 0; i < 3; ++i)
+        {
+            const int j((i + 1) % 3);
+            t.a[i] = y[i] - y[j];
+            t.b[i] = x[j] - x[i];
+            t.c[i] = x[i] * y[j] - x[j] * y[i];
+        }
+
+        // 深度は画面上で線形に、属性は w で割ったものを線形に補間する
+        const GLfloat inv(1.0f / area);
+        t.ox = x[0];
+        t.oy = y[0];
+        plane(t, inv, z[0], z[1], z[2], t.z);
+        plane(t, inv, w[0], w[1], w[2], t.w);
+        for (int k = 0; k < 3; ++k)
+        {
+            plane(t, inv, v0.p[k] * w[0], v1.p[k] * w[1], v2.p[k] * w[2], t.attribute[k]);
+            plane(t, inv, v0.n[k] * w[0], v1.n[k] * w[1], v2.n[k] * w[2], t.attribute[3 + k]);
+        }
+        t.material = material;
+
+        const GLuint id(static_cast<GLuint>(batch.triangles.size()));
+        batch.triangles.push_back(t);
+        for (int ty = t.y0 / tileSize; ty <= t.y1 / tileSize; ++ty)
+        {
+            for (int tx = t.x0 / tileSize; tx <= t.x1 / tileSize; ++tx)
+            {
+                batch.bins[ty * tilesX + tx].push_back(id);
+            }
+        }
+    }
+
+    /**
+     * @brief 頂点の値を重心座標で補間する平面を求める (辺 i の向かいは頂点 i + 2)
+     *
+     * 定数項は頂点 0 の値にして、原点からの差で求めることで桁落ちを防ぐ
+     */
+    static void plane(
+        const Triangle& t, GLfloat inv, GLfloat f0, GLfloat f1, GLfloat f2, GLfloat* out)
+    {
+        out[0] = (t.a[1] * f0 + t.a[2] * f1 + t.a[0] * f2) * inv;
+        out[1] = (t.b[1] * f0 + t.b[2] * f1 + t.b[0] * f2) * inv;
+        out[2] = f0;
+    }
+
+    /** 一つのタイルを消去して振り分けた三角形を描画の順に描く */
+    void rasterizeTile(int tile)
+    {
+        const int tx0((tile % tilesX) * tileSize), ty0((tile / tilesX) * tileSize);
+        const int tx1(std::min(tx0 + tileSize, width) - 1);
+        const int ty1(std::min(ty0 + tileSize, height) - 1);
+        for (int y = ty0; y <= ty1; ++y)
+        {
+            std::fill(&color[y * stride + tx0], &color[y * stride + tx1] + 1, clearColor);
+            std::fill(&depth[y * stride + tx0], &depth[y * stride + tx1] + 1, 1.0f);
+        }
+
+        for (std::size_t b = 0; b < batchCount; ++b)
+        {
+            const Batch& batch(batches[b]);
+            for (GLuint id : batch.bins[tile])
+            {
+                const Triangle& t(batch.triangles[id]);
+
+                // タイルと三角形の範囲の重なり (横は 4 画素単位)
+                const int x0(std::max(t.x0, tx0) & ~3), x1(std::min(t.x1, tx1));
+                const int y0(std::max(t.y0, ty0)), y1(std::min(t.y1, ty1));
+                for (int y = y0; y <= y1; ++y)
+                {
+                    for (int x = x0; x <= x1; x += 4)
+                    {
+                        span(t, x, y, x1);
+                    }
+                }
+            }
+        }
+    }
+
+    /** (x, y) から横に並んだ 4 画素のうち x1 までを描く */
+    void span(const Triangle& t, int x, int y, int x1)
+    {
+        const GLfloat px(static_cast<GLfloat>(x) + 0.5f), py(static_cast<GLfloat>(y) + 0.5f);
+        GLfloat* const d(&depth[y * stride + x]);
+        GLfloat z[4];
+        int mask;
+#ifdef SOFTWARE_RENDERER_SSE2
+        const __m128 vx(_mm_add_ps(_mm_set1_ps(px), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f)));
+        const __m128 vy(_mm_set1_ps(py));
+        __m128 inside(_mm_castsi128_ps(_mm_set1_epi32(-1)));
+        for (int i = 0; i < 3; ++i)
+        {
+            const __m128 e(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.a[i]), vx),
+                                                 _mm_mul_ps(_mm_set1_ps(t.b[i]), vy)),
+                                      _mm_set1_ps(t.c[i])));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(e, _mm_setzero_ps()));
+        }
+        const __m128 dx(_mm_sub_ps(vx, _mm_set1_ps(t.ox)));
+        const __m128 dy(_mm_sub_ps(vy, _mm_set1_ps(t.oy)));
+        const __m128 vz(_mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.z[0]), dx), _mm_mul_ps(_mm_set1_ps(t.z[1]), dy)),
+            _mm_set1_ps(t.z[2])));
+        inside = _mm_and_ps(inside, _mm_cmplt_ps(vz, _mm_loadu_ps(d)));
+        _mm_storeu_ps(z, vz);
+        mask = _mm_movemask_ps(inside);
+#else
+        mask = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            const GLfloat sx(px + static_cast<GLfloat>(k));
+            z[k] = t.z[0] * (sx - t.ox) + t.z[1] * (py - t.oy) + t.z[2];
+            if (t.a[0] * sx + t.b[0] * py + t.c[0] >= 0.0f
+                && t.a[1] * sx + t.b[1] * py + t.c[1] >= 0.0f
+                && t.a[2] * sx + t.b[2] * py + t.c[2] >= 0.0f && z[k] < d[k])
+                mask |= 1 << k;
+        }
+#endif
+        // タイルの外の画素と遠くの面より遠い画素は描かない
+        mask &= (1 << std::min(x1 - x + 1, 4)) - 1;
+        if (mask == 0)
+            return;
+
+        std::uint32_t* const c(&color[y * stride + x]);
+        for (int k = 0; k < 4; ++k)
+        {
+            if ((mask >> k & 1) == 0 || z[k] > 1.0f)
+                continue;
+
+            d[k] = z[k];
+            c[k] = shade(t, px + static_cast<GLfloat>(k), py);
+        }
+    }
+
+    /** 画素の色を求める (point.frag) */
+    std::uint32_t shade(const Triangle& t, GLfloat x, GLfloat y) const
+    {
+        // 視点座標系の位置と補間した法線ベクトル
+        const GLfloat dx(x - t.ox), dy(y - t.oy);
+        const GLfloat w(1.0f / (t.w[0] * dx + t.w[1] * dy + t.w[2]));
+        GLfloat a[6];
+        for (int k = 0; k < 6; ++k)
+        {
+            a[k] = (t.attribute[k][0] * dx + t.attribute[k][1] * dy + t.attribute[k][2]) * w;
+        }
+        const GLfloat* const P(a);
+        const GLfloat* const N(a + 3);
+
+        const GLfloat vl(length(P));
+        const GLfloat V[] = {-P[0] / vl, -P[1] / vl, -P[2] / vl};
+        const GLfloat nl(length(N));
+        const GLfloat Nn[] = {N[0] / nl, N[1] / nl, N[2] / nl};
+
+        const Material& m(materials[t.material]);
+        GLfloat Idiff[3] = {0.0f, 0.0f, 0.0f}, Ispec[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < lightCount; ++i)
+        {
+            // 位置は同次座標を正規化してあるので P.w は 1
+            const GLfloat* const Lp(lightPosition[i]);
+            GLfloat L[] = {Lp[0] - P[0] * Lp[3], Lp[1] - P[1] * Lp[3], Lp[2] - P[2] * Lp[3]};
+            const GLfloat ll(length(L));
+            for (GLfloat& l : L)
+            {
+                l /= ll;
+            }
+            const GLfloat diffuse(std::max(dot(N, L), 0.0f));
+
+            GLfloat H[] = {L[0] + V[0], L[1] + V[1], L[2] + V[2]};
+            const GLfloat hl(length(H));
+            for (GLfloat& h : H)
+            {
+                h /= hl;
+            }
+            const GLfloat specular(std::pow(std::max(dot(Nn, H), 0.0f), m.shininess));
+
+            for (int k = 0; k < 3; ++k)
+            {
+                Idiff[k] += diffuse * m.diffuse[k] * lightDiffuse[i][k]
+                            + m.ambient[k] * lightAmbient[i][k];
+                Ispec[k] += specular * m.specular[k] * lightSpecular[i][k];
+            }
+        }
+        return pack(Idiff[0] + Ispec[0], Idiff[1] + Ispec[1], Idiff[2] + Ispec[2], 1.0f);
+    }
+
+    /** 内積 */
+    static GLfloat dot(const GLfloat* a, const GLfloat* b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    /** ベクトルの長さ */
+    static GLfloat length(const GLfloat* a)
+    {
+        return std::sqrt(dot(a, a));
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    SoftwareRenderer(const SoftwareRenderer& r);
+
+    /** 代入によるコピー禁止 */
+    SoftwareRenderer& operator=(const SoftwareRenderer& r);
+};
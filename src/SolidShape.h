@@ -13,9 +13,13 @@ public:
      * @param size 頂点の位置の次元
      * @param vertexcount 頂点の数
      * @param vertex 頂点属性を格納した配列
+     * @param regions 頂点バッファオブジェクトの領域の数 (2 以上なら動的に更新する)
      */
-    SolidShape(GLint size, GLsizei vertexcount, const Object::Vertex* vertex) :
-        Shape(size, vertexcount, vertex)
+    SolidShape(GLint size,
+               GLsizei vertexcount,
+               const Object::Vertex* vertex,
+               GLsizei regions = 1) :
+        Shape(size, vertexcount, vertex, 0, NULL, regions)
     {
     }
 
@@ -23,6 +27,6 @@ public:
     virtual void execute() const
     {
         // 三角形で描画する
-        glDrawArrays(GL_TRIANGLES, 0, vertexcount);
+        GlTrace::drawArrays(GL_TRIANGLES, 0, vertexcount);
     }
 };
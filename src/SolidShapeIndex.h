@@ -1,5 +1,6 @@
 #pragma once
 #include "ShapeIndex.h"
+#include "VertexWelder.h"
 
 /**
  * インデックスを使った三角形による描画
@@ -15,13 +16,32 @@ public:
      * @param vertex 頂点属性を格納した配列
      * @param indexcount 頂点のインデックスの要素数
      * @param index 頂点のインデックスを格納した配列
+     * @param regions 頂点バッファオブジェクトの領域の数 (2 以上なら動的に更新する)
      */
     SolidShapeIndex(GLint size,
                     GLsizei vertexcount,
                     const Object::Vertex* vertex,
                     GLsizei indexcount,
-                    const GLuint* index) :
-        ShapeIndex(size, vertexcount, vertex, indexcount, index)
+                    const GLuint* index,
+                    GLsizei regions = 1) :
+        ShapeIndex(size, vertexcount, vertex, indexcount, index, regions)
+    {
+    }
+
+    /**
+     * @brief 重複する頂点をまとめた図形を作成する
+     *
+     * @param size 頂点の位置の次元
+     * @param welded 重複する頂点をまとめた頂点属性とインデックス
+     * @param regions 頂点バッファオブジェクトの領域の数 (2 以上なら動的に更新する)
+     */
+    SolidShapeIndex(GLint size, const VertexWelder& welded, GLsizei regions = 1) :
+        ShapeIndex(size,
+                   welded.getVertexCount(),
+                   welded.getVertex(),
+                   welded.getIndexCount(),
+                   welded.getIndex(),
+                   regions)
     {
     }
 
@@ -29,6 +49,6 @@ public:
     virtual void execute() const
     {
         // 三角形で描画する
-        glDrawElements(GL_TRIANGLES, indexcount, GL_UNSIGNED_INT, 0);
+        GlTrace::drawElements(GL_TRIANGLES, indexcount, GL_UNSIGNED_INT, 0);
     }
 };
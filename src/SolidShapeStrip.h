@@ -0,0 +1,58 @@
+#pragma once
+#include "ShapeIndex.h"
+#include "Stripifier.h"
+
+/**
+ * プリミティブの再開で区切った三角形ストリップによる描画
+ */
+class SolidShapeStrip : public ShapeIndex
+{
+public:
+    /**
+     * @brief 三角形の頂点のインデックスをストリップに変換して図形を作成する
+     *
+     * @param size 頂点の位置の次元
+     * @param vertexcount 頂点の数
+     * @param vertex 頂点属性を格納した配列
+     * @param indexcount 三角形の頂点のインデックスの要素数
+     * @param index 三角形の頂点のインデックスを格納した配列
+     * @param regions 頂点バッファオブジェクトの領域の数 (2 以上なら動的に更新する)
+     */
+    SolidShapeStrip(GLint size,
+                    GLsizei vertexcount,
+                    const Object::Vertex* vertex,
+                    GLsizei indexcount,
+                    const GLuint* index,
+                    GLsizei regions = 1) :
+        SolidShapeStrip(size, vertexcount, vertex, Stripifier(indexcount, index), regions)
+    {
+    }
+
+    /**
+     * @brief Construct a new SolidShapeStrip object
+     *
+     * @param size 頂点の位置の次元
+     * @param vertexcount 頂点の数
+     * @param vertex 頂点属性を格納した配列
+     * @param strips 三角形ストリップに変換したインデックス
+     * @param regions 頂点バッファオブジェクトの領域の数 (2 以上なら動的に更新する)
+     */
+    SolidShapeStrip(GLint size,
+                    GLsizei vertexcount,
+                    const Object::Vertex* vertex,
+                    const Stripifier& strips,
+                    GLsizei regions = 1) :
+        ShapeIndex(size, vertexcount, vertex, strips.getIndexCount(), strips.getIndex(), regions)
+    {
+    }
+
+    /** 描画の実行 */
+    virtual void execute() const
+    {
+        // 再開のインデックスで区切った三角形ストリップで描画する
+        GlTrace::enable(GL_PRIMITIVE_RESTART);
+        GlTrace::primitiveRestartIndex(Stripifier::restart);
+        GlTrace::drawElements(GL_TRIANGLE_STRIP, indexcount, GL_UNSIGNED_INT, 0);
+        GlTrace::disable(GL_PRIMITIVE_RESTART);
+    }
+};
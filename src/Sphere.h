@@ -0,0 +1,131 @@
+#pragma once
+#include <GL/glew.h>
+#include <cmath>
+#include <vector>
+#include "LevelOfDetail.h"
+#include "Object.h"
+#include "VertexWelder.h"
+
+/**
+ * @brief 球の頂点属性とインデックスを作成する
+ *
+ * @param slices 経度方向の分割数
+ * @param stacks 緯度方向の分割数
+ * @param vertex 頂点属性の格納先
+ * @param index 三角形の頂点のインデックスの格納先
+ */
+inline void createSphere(int slices,
+                         int stacks,
+                         std::vector<Object::Vertex>& vertex,
+                         std::vector<GLuint>& index)
+{
+    // 頂点属性を作る
+    vertex.clear();
+    vertex.reserve((slices + 1) * (stacks + 1));
+    for (int j = 0; j <= stacks; j++)
+    {
+        const float t = static_cast<float>(j) / static_cast<float>(stacks);
+        const float y = std::cos(3.141593f * t), r = std::sin(3.141593f * t);
+        for (int i = 0; i <= slices; i++)
+        {
+            const float s = static_cast<float>(i) / static_cast<float>(slices);
+            const float z = r * std::cos(6.283185f * s), x = r * std::sin(6.283185f * s);
+
+            // 頂点属性
+            const Object::Vertex v = {x, y, z, x, y, x};
+            // 頂点属性を追加する
+            vertex.push_back(v);
+        }
+    }
+
+    // インデックスを作る
+    index.clear();
+    index.reserve(slices * stacks * 6);
+    for (int j = 0; j < stacks; j++)
+    {
+        const int k = (slices + 1) * j;
+        for (int i = 0; i < slices; ++i)
+        {
+            // 頂点のインデックス
+            const GLuint k0(k + i);
+            const GLuint k1(k0 + 1);
+            const GLuint k2(k1 + slices);
+            const GLuint k3(k2 + 1);
+            // 左下の三角形
+            index.push_back(k0);
+            index.push_back(k2);
+            index.push_back(k3);
+            // 右上の三角形
+            index.push_back(k0);
+            index.push_back(k3);
+            index.push_back(k1);
+        }
+    }
+}
+
+/**
+ * @brief 球を分割数で近似したときの幾何学的な誤差 (半径 1 に対する長さ)
+ *
+ * 四角形の中心が球面から最も離れるので、経度方向と緯度方向の弦の中点のずれを合わせる
+ *
+ * @param slices 経度方向の分割数
+ * @param stacks 緯度方向の分割数
+ */
+inline GLfloat getSphereError(int slices, int stacks)
+{
+    return 1.0f
+           - std::cos(3.141593f / static_cast<float>(slices))
+                 * std::cos(1.570796f / static_cast<float>(stacks));
+}
+
+/**
+ * @brief 分割数を半分ずつにした球を一つの頂点配列にまとめて作成する
+ *
+ * @param slices 最も細かい詳細度の経度方向の分割数
+ * @param stacks 最も細かい詳細度の緯度方向の分割数
+ * @param levels 詳細度の数
+ * @param vertex 全ての詳細度の頂点属性の格納先
+ * @param index 全ての詳細度の三角形の頂点のインデックスの格納先
+ * @param lod 詳細度ごとのインデックスの範囲の格納先
+ */
+inline void createSphereLod(int slices,
+                            int stacks,
+                            int levels,
+                            std::vector<Object::Vertex>& vertex,
+                            std::vector<GLuint>& index,
+                            LevelOfDetail& lod)
+{
+    vertex.clear();
+    index.clear();
+
+    std::vector<Object::Vertex> levelVertex;
+    std::vector<GLuint> levelIndex;
+    for (int level = 0; level < levels; ++level)
+    {
+        createSphere(slices, stacks, levelVertex, levelIndex);
+
+        // 経度 0 の継ぎ目と極で重複する頂点をまとめる
+        const VertexWelder welded(static_cast<GLsizei>(levelVertex.size()),
+                                  levelVertex.data(),
+                                  static_cast<GLsizei>(levelIndex.size()),
+                                  levelIndex.data(),
+                                  1.0e-5f);
+
+        // 前の詳細度の頂点の後ろに追加する
+        const GLuint base(static_cast<GLuint>(vertex.size()));
+        const GLsizei first(static_cast<GLsizei>(index.size()));
+        const Object::Vertex* const v(welded.getVertex());
+        vertex.insert(vertex.end(), v, v + welded.getVertexCount());
+        for (GLsizei i = 0; i < welded.getIndexCount(); ++i)
+        {
+            index.push_back(base + welded.getIndex()[i]);
+        }
+        lod.add(first, welded.getIndexCount(), getSphereError(slices, stacks));
+
+        // これ以上粗くすると球に見えない
+        if (slices <= 6 || stacks <= 3)
+            break;
+        slices /= 2;
+        stacks /= 2;
+    }
+}
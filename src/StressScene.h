@@ -0,0 +1,394 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "LevelOfDetail.h"
+#include "Material.h"
+#include "Matrix.h"
+#include "Shape.h"
+#include "Snapshot.h"
+#include "Vector.h"
+
+/**
+ * 描画の負荷を調べるために多数の物体を並べた場面
+ *
+ * 物体は XZ 平面の格子に並べ、指定した割合の物体だけが上下に揺れながら回転する。
+ * 動かない物体のモデルビュー変換行列は最初に一度だけ求めておき、
+ * update() では動く物体だけを求めなおすので、動く物体の割合で更新の負荷が変わる。
+ * 動く物体は配列の前に集めておき、法線ベクトルの変換行列は Matrix::getNormalMatrices() で
+ * まとめて求める。
+ * collect() は視錐台の外の物体を除いて詳細度を選び、フレームの描画を作る。
+ * 材質と光源も数だけを指定して作る。
+ */
+class StressScene
+{
+public:
+    /**
+     * 場面の設定
+     */
+    struct Settings
+    {
+        /** 物体の数 */
+        unsigned long objects;
+        /** 六面体の割合 (残りは球) */
+        GLfloat boxes;
+        /** 材質の数 */
+        unsigned int materials;
+        /** 光源の数 */
+        int lights;
+        /** 動く物体の割合 */
+        GLfloat motion;
+        /** 乱数の種 */
+        unsigned int seed;
+    };
+
+    /**
+     * 物体に使う図形
+     */
+    struct Model
+    {
+        /** 描画する図形 */
+        const Shape* shape;
+        /** 詳細度 (持たなければ NULL) */
+        const LevelOfDetail* lod;
+        /** 詳細度を持たないときのインデックスの要素数 */
+        GLsizei indexcount;
+        /** 原点を中心とする境界球の半径 */
+        GLfloat radius;
+    };
+
+private:
+    /**
+     * 一つの物体
+     */
+    struct Body
+    {
+        /** 格子の上の位置 */
+        GLfloat position[3];
+        /** 大きさ */
+        GLfloat scale;
+        /** 動きの位相 */
+        GLfloat phase;
+        /** 動きの速さ */
+        GLfloat speed;
+        /** 前のフレームで選んだ詳細度 */
+        GLsizei level;
+        /** 図形の番号 (0 なら六面体、1 なら球) */
+        unsigned char model;
+        /** 動くかどうか */
+        bool moving;
+    };
+
+    /** 図形 */
+    Model models[2];
+
+    /** 物体 */
+    std::vector<Body> bodies;
+
+    /** 物体ごとの描画 (動かない物体は作ったときのまま使う) */
+    std::vector<DrawPacket> packets;
+
+    /** 動く物体の数 (bodies と packets の前から並べる) */
+    std::size_t moving;
+
+    /** 材質 */
+    std::vector<Material> materials;
+
+    /** ワールド座標系における光源の位置 */
+    std::vector<Vector> lights;
+
+    /** 光源の環境光成分、拡散反射光成分、鏡面反射光成分 */
+    std::vector<GLfloat> ambient, diffuse, specular;
+
+    /** ビュー変換行列 */
+    Matrix view;
+
+    /** 透視投影変換行列 */
+    Matrix projection;
+
+    /** 視点座標系における視錐台の六つの平面 (ax + by + cz + d >= 0 が内側) */
+    GLfloat planes[6][4];
+
+    /** フレームバッファの高さ */
+    GLsizei height;
+
+    /** 直前の collect() で選んだ三角形の数 */
+    unsigned long triangles;
+
+public:
+    /** 光源の数の上限 (point.vert と point.frag に合わせる) */
+    static constexpr int maxLights = 8;
+
+    /**
+     * @brief Construct a new StressScene object
+     *
+     * @param settings 場面の設定
+     * @param box 六面体の図形
+     * @param sphere 球の図形
+     * @param width フレームバッファの幅
+     * @param height フレームバッファの高さ
+     */
+    StressScene(const Settings& settings,
+                const Model& box,
+                const Model& sphere,
+                GLsizei width,
+                GLsizei height) :
+        models {box, sphere}, moving(0), height(height), triangles(0)
+    {
+        std::mt19937 random(settings.seed);
+        std::uniform_real_distribution<GLfloat> uniform(0.0f, 1.0f);
+
+        // 間隔 3 の正方形の格子に並べる
+        const unsigned long count(settings.objects);
+        const unsigned long side(std::max(
+            static_cast<unsigned long>(std::ceil(std::sqrt(static_cast<double>(count)))), 1ul));
+        const GLfloat spacing(3.0f), extent(static_cast<GLfloat>(side) * spacing * 0.5f);
+
+        // 格子の全体が見えるように斜め上から見下ろす
+        view = Matrix::lookAt(
+            0.0f, extent * 1.5f + 4.0f, extent * 2.2f + 6.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+        const GLfloat aspect(static_cast<GLfloat>(width)
+                             / static_cast<GLfloat>(std::max(height, 1)));
+        projection = Matrix::perspective(0.8f, aspect, 1.0f, extent * 6.0f + 20.0f);
+        setPlanes();
+
+        // 材質は色相を少しずつ変えて作る (同じ値にならないので MaterialTable でも同じ番号になる)
+        const unsigned int materialCount(std::max(settings.materials, 1u));
+        const GLfloat hue(6.2831853f / static_cast<GLfloat>(materialCount));
+        for (unsigned int i = 0; i < materialCount; ++i)
+        {
+            const GLfloat h(static_cast<GLfloat>(i) * hue);
+            const GLfloat r(0.5f + 0.4f * std::cos(h)), g(0.5f + 0.4f * std::cos(h - 2.0943951f)),
+                b(0.5f + 0.4f * std::cos(h + 2.0943951f));
+            const GLfloat s(0.2f + 0.1f * static_cast<GLfloat>(i % 3));
+            const GLfloat shininess(10.0f + 20.0f * static_cast<GLfloat>(i % 4));
+            materials.push_back({r, g, b, r, g, b, s, s, s, shininess});
+        }
+
+        // 光源は格子の上に輪のように並べ、数が増えても明るくなりすぎないようにする
+        const int lightCount(std::min(std::max(settings.lights, 1), maxLights));
+        const GLfloat weight(1.0f / std::sqrt(static_cast<GLfloat>(lightCount)));
+        const GLfloat step(6.2831853f / static_cast<GLfloat>(lightCount));
+        for (int i = 0; i < lightCount; ++i)
+        {
+            const GLfloat a(static_cast<GLfloat>(i) * step);
+            lights.push_back(
+                {extent * std::cos(a), extent * 0.5f + 8.0f, extent * std::sin(a), 1.0f});
+            for (int k = 0; k < 3; ++k)
+            {
+                ambient.push_back(0.2f / static_cast<GLfloat>(lightCount));
+                diffuse.push_back(0.9f * weight);
+                specular.push_back(0.6f * weight);
+            }
+        }
+
+        // 物体を作る
+        bodies.resize(count);
+        packets.resize(count);
+        for (unsigned long i = 0; i < count; ++i)
+        {
+            Body& body(bodies[i]);
+            const GLfloat jitter(spacing * 0.2f);
+            body.position[0] = (static_cast<GLfloat>(i % side) + 0.5f) * spacing - extent
+                               + (uniform(random) - 0.5f) * jitter;
+            body.position[1] = 0.0f;
+            body.position[2] = (static_cast<GLfloat>(i / side) + 0.5f) * spacing - extent
+                               + (uniform(random) - 0.5f) * jitter;
+            body.scale  = 0.4f + 0.5f * uniform(random);
+            body.phase  = uniform(random) * 6.2831853f;
+            body.speed  = 0.5f + 1.5f * uniform(random);
+            body.level  = 0;
+            body.model  = uniform(random) < settings.boxes ? 0 : 1;
+            body.moving = uniform(random) < settings.motion;
+            if (body.moving)
+                ++moving;
+
+            DrawPacket& packet(packets[i]);
+            packet.shape    = models[body.model].shape;
+            packet.material = static_cast<unsigned int>(random() % materialCount);
+            packet.level    = 0;
+        }
+
+        // 動く物体を前に集める (どちらも作った順のまま並べる)
+        std::vector<DrawPacket> sorted(count);
+        unsigned long front(0), back(moving);
+        for (unsigned long i = 0; i < count; ++i)
+        {
+            sorted[bodies[i].moving ? front++ : back++] = packets[i];
+        }
+        std::stable_partition(bodies.begin(), bodies.end(), [](const Body& b) { return b.moving; });
+        packets.swap(sorted);
+
+        for (unsigned long i = 0; i < count; ++i)
+        {
+            transform(i, 0.0f);
+        }
+        setNormalMatrices(count);
+    }
+
+    /**
+     * @brief 動く物体のモデルビュー変換行列と法線ベクトルの変換行列を求めなおす
+     *
+     * @param t 時刻
+     */
+    void update(GLfloat t)
+    {
+        for (std::size_t i = 0; i < moving; ++i)
+        {
+            transform(i, t);
+        }
+        setNormalMatrices(moving);
+    }
+
+    /**
+     * @brief 視錐台の中の物体の詳細度を選んでフレームの描画を作る
+     *
+     * @param frame 描画を格納するフレーム (描画と投影と光源を書き換える)
+     */
+    void collect(Snapshot& frame)
+    {
+        frame.projection = projection;
+        frame.lights.resize(lights.size());
+        for (std::size_t i = 0; i < lights.size(); ++i)
+        {
+            frame.lights[i] = view * lights[i];
+        }
+
+        frame.draws.clear();
+        triangles = 0;
+        for (std::size_t i = 0; i < packets.size(); ++i)
+        {
+            Body& body(bodies[i]);
+            const Model& model(models[body.model]);
+            const DrawPacket& packet(packets[i]);
+            if (!isVisible(packet.modelView, model.radius * body.scale))
+                continue;
+
+            GLsizei count(model.indexcount);
+            if (model.lod != NULL)
+            {
+                body.level = model.lod->select(packet.modelView, projection, height, body.level);
+                count      = model.lod->getLevel(body.level).count;
+            }
+            frame.draws.push_back(packet);
+            frame.draws.back().level = body.level;
+            triangles += count / 3;
+        }
+    }
+
+    /** 物体の数を返す */
+    std::size_t getObjects() const
+    {
+        return bodies.size();
+    }
+
+    /** 動く物体の数を返す */
+    std::size_t getMoving() const
+    {
+        return moving;
+    }
+
+    /** 直前の collect() で選んだ三角形の数を返す */
+    unsigned long getTriangles() const
+    {
+        return triangles;
+    }
+
+    /** 材質を返す */
+    const std::vector<Material>& getMaterials() const
+    {
+        return materials;
+    }
+
+    /** 光源の数を返す */
+    int getLights() const
+    {
+        return static_cast<int>(lights.size());
+    }
+
+    /** 光源の環境光成分を返す */
+    const GLfloat* getAmbient() const
+    {
+        return ambient.data();
+    }
+
+    /** 光源の拡散反射光成分を返す */
+    const GLfloat* getDiffuse() const
+    {
+        return diffuse.data();
+    }
+
+    /** 光源の鏡面反射光成分を返す */
+    const GLfloat* getSpecular() const
+    {
+        return specular.data();
+    }
+
+private:
+    /** 物体のモデルビュー変換行列を求める */
+    void transform(unsigned long i, GLfloat t)
+    {
+        const Body& body(bodies[i]);
+        DrawPacket& packet(packets[i]);
+        const GLfloat a(body.moving ? body.speed * t + body.phase : body.phase);
+        const GLfloat y(body.moving ? body.position[1] + 0.5f * std::sin(a) : body.position[1]);
+        packet.modelView = view * Matrix::translate(body.position[0], y, body.position[2])
+                           * Matrix::rotate(a, 0.0f, 1.0f, 0.0f)
+                           * Matrix::scale(body.scale, body.scale, body.scale);
+    }
+
+    /** 前から count 個の物体の法線ベクトルの変換行列をまとめて求める */
+    void setNormalMatrices(std::size_t count)
+    {
+        if (count == 0)
+            return;
+        Matrix::getNormalMatrices(&packets[0].modelView,
+                                  count,
+                                  packets[0].normalMatrix,
+                                  sizeof(DrawPacket),
+                                  sizeof(DrawPacket));
+    }
+
+    /** 透視投影変換行列から視錐台の平面を求める */
+    void setPlanes()
+    {
+        // 行列の 4 行目に各行を足し引きしたものが平面になる
+        for (int p = 0; p < 6; ++p)
+        {
+            const int row(p / 2);
+            const GLfloat sign(p % 2 == 0 ? 1.0f : -1.0f);
+            GLfloat length(0.0f);
+            for (int c = 0; c < 4; ++c)
+            {
+                planes[p][c] = projection[c * 4 + 3] + sign * projection[c * 4 + row];
+                if (c < 3)
+                    length += planes[p][c] * planes[p][c];
+            }
+            length = std::sqrt(length);
+            for (GLfloat& x : planes[p])
+            {
+                x /= length;
+            }
+        }
+    }
+
+    /** 原点を中心とする境界球が視錐台と交わるかを調べる */
+    bool isVisible(const Matrix& modelView, GLfloat radius) const
+    {
+        for (const GLfloat* p : planes)
+        {
+            if (p[0] * modelView[12] + p[1] * modelView[13] + p[2] * modelView[14] + p[3]
+                < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    StressScene(const StressScene& s);
+
+    /** 代入によるコピー禁止 */
+    StressScene& operator=(const StressScene& s);
+};
@@ -0,0 +1,194 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * 三角形の頂点のインデックスを三角形ストリップに変換するクラス
+ *
+ * 辺を共有する三角形を貪欲にたどってストリップを伸ばし、
+ * ストリップの間にはプリミティブの再開のインデックスを挟んで一つの配列にする。
+ * 三角形の向きが揃っていれば表裏は元の三角形と同じになる。
+ */
+class Stripifier
+{
+    /** 三角形の頂点のインデックス */
+    const GLuint* const triangles;
+
+    /** 三角形の数 */
+    const GLuint count;
+
+    /** 辺 (小さい番号, 大きい番号) とそれを使う三角形 */
+    std::vector<std::pair<std::uint64_t, GLuint>> edges;
+
+    /** ストリップに使った三角形 */
+    std::vector<bool> used;
+
+    /** 伸ばしているストリップで使った三角形に付ける印 */
+    std::vector<GLuint> stamp;
+
+    /** 伸ばしているストリップの印 */
+    GLuint run;
+
+    /** ストリップの頂点のインデックス */
+    std::vector<GLuint> index;
+
+    /** ストリップの数 */
+    GLsizei strips;
+
+public:
+    /** プリミティブの再開を表すインデックス */
+    static constexpr GLuint restart = 0xffffffffu;
+
+    /**
+     * @brief Construct a new Stripifier object
+     *
+     * @param indexcount 三角形の頂点のインデックスの要素数
+     * @param index 三角形の頂点のインデックスを格納した配列
+     */
+    Stripifier(GLsizei indexcount, const GLuint* index) :
+        triangles(index), count(static_cast<GLuint>(indexcount / 3)), used(count, false),
+        stamp(count, 0), run(0), strips(0)
+    {
+        // 辺から三角形を探せるようにする
+        edges.reserve(count * 3);
+        for (GLuint t = 0; t < count; ++t)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                edges.emplace_back(key(triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3]), t);
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+
+        // 使っていない三角形から三通りの向きでストリップを伸ばし、最も長いものを採る
+        std::vector<GLuint> strip, best, faces, bestFaces;
+        this->index.reserve(count * 2);
+        for (GLuint t = 0; t < count; ++t)
+        {
+            if (used[t])
+                continue;
+
+            best.clear();
+            for (int k = 0; k < 3; ++k)
+            {
+                grow(t, k, strip, faces);
+                if (strip.size() > best.size())
+                {
+                    best.swap(strip);
+                    bestFaces.swap(faces);
+                }
+            }
+
+            // 採ったストリップの三角形に印を付けて追加する
+            for (GLuint f : bestFaces)
+            {
+                used[f] = true;
+            }
+            if (strips > 0)
+                this->index.push_back(restart);
+            this->index.insert(this->index.end(), best.begin(), best.end());
+            ++strips;
+        }
+    }
+
+    /** ストリップの頂点のインデックスを返す */
+    const GLuint* getIndex() const
+    {
+        return index.data();
+    }
+
+    /** ストリップの頂点のインデックスの要素数を返す (再開のインデックスを含む) */
+    GLsizei getIndexCount() const
+    {
+        return static_cast<GLsizei>(index.size());
+    }
+
+    /** ストリップの数を返す */
+    GLsizei getStrips() const
+    {
+        return strips;
+    }
+
+private:
+    /** 辺を向きによらない値にする */
+    static std::uint64_t key(GLuint a, GLuint b)
+    {
+        return static_cast<std::uint64_t>(std::min(a, b)) << 32 | std::max(a, b);
+    }
+
+    /** 三角形の k 番目の頂点 */
+    GLuint corner(GLuint t, int k) const
+    {
+        return triangles[t * 3 + k % 3];
+    }
+
+    /**
+     * @brief 辺 xy の向こう側にある使っていない三角形のうち、
+     *        ストリップの順に並べたときに元の三角形と同じ向きになるものを探す
+     *
+     * @param x ストリップの最後から二つ目の頂点
+     * @param y ストリップの最後の頂点
+     * @param odd ストリップの奇数番目の三角形になるか
+     * @param next 見つけた三角形の格納先
+     * @return true 見つかった
+     */
+    bool follow(GLuint x, GLuint y, bool odd, GLuint& next) const
+    {
+        const std::uint64_t k(key(x, y));
+        auto e(std::lower_bound(
+            edges.begin(), edges.end(), std::make_pair(k, static_cast<GLuint>(0))));
+        for (; e != edges.end() && e->first == k; ++e)
+        {
+            const GLuint t(e->second);
+            if (used[t] || stamp[t] == run)
+                continue;
+
+            // 奇数番目の三角形は y, x, d の順に描かれる
+            const GLuint first(odd ? y : x), second(odd ? x : y);
+            for (int r = 0; r < 3; ++r)
+            {
+                if (corner(t, r) == first && corner(t, r + 1) == second)
+                {
+                    next = t;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief 三角形 t の k 番目の頂点から始まるストリップを伸ばす
+     *
+     * @param t 最初の三角形
+     * @param k 最初の頂点
+     * @param strip ストリップの頂点のインデックスの格納先
+     * @param faces ストリップに使った三角形の格納先
+     */
+    void grow(GLuint t, int k, std::vector<GLuint>& strip, std::vector<GLuint>& faces)
+    {
+        strip.assign({corner(t, k), corner(t, k + 1), corner(t, k + 2)});
+        faces.assign(1, t);
+        stamp[t] = ++run;
+
+        GLuint next;
+        while (follow(strip[strip.size() - 2], strip.back(), strip.size() % 2 == 1, next))
+        {
+            // 共有する辺以外の頂点を追加する
+            const GLuint x(strip[strip.size() - 2]), y(strip.back());
+            for (int r = 0; r < 3; ++r)
+            {
+                const GLuint v(corner(next, r));
+                if (v != x && v != y)
+                {
+                    strip.push_back(v);
+                    break;
+                }
+            }
+            faces.push_back(next);
+            stamp[next] = run;
+        }
+    }
+};
@@ -0,0 +1,161 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 番号の付いた仕事を複数のスレッドで分担するクラス
+ *
+ * スレッドは作成したときに起動しておき、run() のたびに使い回す。
+ * run() を呼び出したスレッドも仕事を分担し、全ての仕事が終わるまで戻らない。
+ */
+class TaskPool
+{
+    /** 仕事を分担するスレッド (呼び出したスレッドは含まない) */
+    std::vector<std::thread> workers;
+
+    /** 以下の変数を保護する */
+    std::mutex mutex;
+
+    /** 仕事を始めるときと終了するときに通知する */
+    std::condition_variable wake;
+
+    /** 全てのスレッドが仕事を終えたときに通知する */
+    std::condition_variable done;
+
+    /** 実行する仕事 */
+    const std::function<void(int)>* task;
+
+    /** 仕事の数 */
+    int count;
+
+    /** 次に取り出す仕事の番号 */
+    std::atomic<int> next;
+
+    /** まだ仕事を終えていないスレッドの数 */
+    int pending;
+
+    /** run() を呼び出した回数 */
+    unsigned long generation;
+
+    /** 終了する */
+    bool stop;
+
+public:
+    /**
+     * @brief Construct a new TaskPool object
+     *
+     * @param threads 仕事を分担するスレッドの数 (呼び出したスレッドを含む、0 ならコアの数)
+     */
+    explicit TaskPool(unsigned int threads = 0) :
+        task(NULL), count(0), next(0), pending(0), generation(0), stop(false)
+    {
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        for (unsigned int i = 1; i < threads; ++i)
+        {
+            workers.emplace_back(&TaskPool::work, this);
+        }
+    }
+
+    virtual ~TaskPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    /** 仕事を分担するスレッドの数を返す (呼び出したスレッドを含む) */
+    unsigned int getThreads() const
+    {
+        return static_cast<unsigned int>(workers.size()) + 1;
+    }
+
+    /**
+     * @brief 0 から count - 1 までの番号の仕事を分担して実行する
+     *
+     * @param count 仕事の数
+     * @param f 番号を受け取って仕事を行う関数
+     */
+    void run(int count, const std::function<void(int)>& f)
+    {
+        if (workers.empty() || count <= 1)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                f(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task        = &f;
+            this->count = count;
+            next.store(0, std::memory_order_relaxed);
+            pending = static_cast<int>(workers.size());
+            ++generation;
+        }
+        wake.notify_all();
+
+        execute(f, count);
+
+        // 他のスレッドが仕事を終えるまで待つ
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+        task = NULL;
+    }
+
+private:
+    /** 仕事がなくなるまで取り出して実行する */
+    void execute(const std::function<void(int)>& f, int count)
+    {
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+        {
+            f(i);
+        }
+    }
+
+    /** 仕事を分担するスレッド */
+    void work()
+    {
+        unsigned long seen(0);
+        for (;;)
+        {
+            const std::function<void(int)>* f;
+            int n;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return stop || generation != seen; });
+                if (stop)
+                    return;
+                seen = generation;
+                f    = task;
+                n    = count;
+            }
+
+            execute(*f, n);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    TaskPool(const TaskPool& p);
+
+    /** 代入によるコピー禁止 */
+    TaskPool& operator=(const TaskPool& p);
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * 一つのスレッドが書き込み、別のスレッドが読み出す三重バッファ
+ *
+ * 書き込み中・受け渡し用・読み出し中の三つの領域を atomic な交換だけで入れ替えるので、
+ * どちらのスレッドも相手を待つことなく自分の領域を使い続けられる。
+ * 相手を待つときは waitAcquire() や waitConsumed() で条件変数を使って眠る。
+ * 眠っているスレッドがいないときは、入れ替えでロックを取らない
+ *
+ * @tparam T 領域の型
+ */
+template<typename T>
+class TripleBuffer
+{
+    /** 受け渡し用の領域に新しいデータがあることを示すビット */
+    static constexpr int fresh = 4;
+
+    /** 領域 */
+    T slots[3];
+
+    /** 書き込み中の領域 (書き込む側だけが使う) */
+    int back;
+
+    /** 読み出し中の領域 (読み出す側だけが使う) */
+    int front;
+
+    /** 受け渡し用の領域 */
+    alignas(64) std::atomic<int> middle;
+
+    /** close() したか */
+    std::atomic<bool> closed;
+
+    /** 条件変数で眠っている (眠ろうとしている) スレッドの数 */
+    std::atomic<int> waiting;
+
+    /** 待っているスレッドを起こすための排他制御 */
+    std::mutex mutex;
+
+    /** 受け渡し用の領域が入れ替わったことを知らせる条件変数 */
+    std::condition_variable changed;
+
+public:
+    TripleBuffer() : back(0), front(1), middle(2), closed(false), waiting(0) {}
+
+    /** 書き込み中の領域を返す (書き込む側のスレッドから呼ぶ) */
+    T& write()
+    {
+        return slots[back];
+    }
+
+    /** 書き込み中の領域を受け渡し用の領域と入れ替える (書き込む側のスレッドから呼ぶ) */
+    void publish()
+    {
+        back = middle.exchange(back | fresh) & 3;
+        notify();
+    }
+
+    /** 受け渡し用の領域がまだ読み出されていないか */
+    bool pending() const
+    {
+        return (middle.load() & fresh) != 0;
+    }
+
+    /**
+     * @brief 新しいデータがあれば読み出し中の領域と入れ替える (読み出す側のスレッドから呼ぶ)
+     *
+     * @return true 新しいデータを受け取った
+     * @return false 新しいデータはなかった
+     */
+    bool acquire()
+    {
+        if (!pending())
+            return false;
+
+        front = middle.exchange(front) & 3;
+        notify();
+        return true;
+    }
+
+    /**
+     * @brief 新しいデータができるまで待って読み出し中の領域と入れ替える (読み出す側のスレッドから呼ぶ)
+     *
+     * @param seconds 待つ時間の上限 (秒)
+     * @return true 新しいデータを受け取った
+     * @return false 時間切れか close() された
+     */
+    bool waitAcquire(double seconds)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            waiting.fetch_add(1);
+            changed.wait_for(lock, std::chrono::duration<double>(seconds), [this]
+                             { return pending() || closed.load(); });
+            waiting.fetch_sub(1);
+        }
+        return acquire();
+    }
+
+    /**
+     * @brief 受け渡し用の領域が読み出されるまで待つ (書き込む側のスレッドから呼ぶ)
+     *
+     * @param seconds 待つ時間の上限 (秒)
+     * @return true 読み出された
+     * @return false 時間切れか close() された
+     */
+    bool waitConsumed(double seconds)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        waiting.fetch_add(1);
+        changed.wait_for(lock, std::chrono::duration<double>(seconds), [this]
+                         { return !pending() || closed.load(); });
+        waiting.fetch_sub(1);
+        return !pending();
+    }
+
+    /** 待っているスレッドを全て起こし、以後は待たないようにする */
+    void close()
+    {
+        closed.store(true);
+        notify();
+    }
+
+    /** 読み出し中の領域を返す (読み出す側のスレッドから呼ぶ) */
+    const T& read() const
+    {
+        return slots[front];
+    }
+
+private:
+    /**
+     * @brief 待っているスレッドを起こす
+     *
+     * 待つ側は waiting を増やしてから条件を調べ、起こす側は条件を変えてから waiting を調べる。
+     * どちらも既定の順序一貫性のある atomic な操作なので、起こす側が waiting を 0 と読んだときは
+     * 待つ側が必ず変えた後の条件を読み、眠らずに戻る。
+     */
+    void notify()
+    {
+        if (waiting.load() == 0)
+            return;
+
+        // 相手が条件を調べてから眠るまでの間に起こしそこねないように一度ロックを通る
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        changed.notify_all();
+    }
+
+    /** コピーコンストラクタによるコピー禁止 */
+    TripleBuffer(const TripleBuffer& b);
+
+    /** 代入によるコピー禁止 */
+    TripleBuffer& operator=(const TripleBuffer& b);
+};
@@ -1,6 +1,8 @@
 #pragma once
 #include <GL/glew.h>
 #include <memory>
+#include "GlTrace.h"
+#include "MemoryStats.h"
 
 /**
  * ユニフォームバッファオブジェクト
@@ -16,30 +18,35 @@ class Uniform
         /** ユニフォームブロックのサイズ */
         GLsizeiptr blocksize;
 
+        /** 確保したユニフォームブロックの数 */
+        unsigned int count;
+
         /**
          * @brief Construct a new Uniform Buffer object
          *
          * @param data uniformブロックに格納するデータ
          * @param count 確保するuniformブロックの数
          */
-        UniformBuffer(const T* data, unsigned int count)
+        UniformBuffer(const T* data, unsigned int count) : count(count)
         {
             // ユニフォームブロックのサイズを求める
             GLint alignment;
             glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
             blocksize = (((sizeof(T) - 1) / alignment) + 1) * alignment;
-            glGenBuffers(1, &ubo);
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-            glBufferData(GL_UNIFORM_BUFFER, count * blocksize, NULL, GL_STATIC_DRAW);
+            GlTrace::genBuffers(1, &ubo);
+            GlTrace::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+            GlTrace::bufferData(GL_UNIFORM_BUFFER, count * blocksize, NULL, GL_STATIC_DRAW);
             for (unsigned int i = 0; i < count; ++i)
             {
-                glBufferSubData(GL_UNIFORM_BUFFER, i * blocksize, sizeof(T), data + i);
+                GlTrace::bufferSubData(GL_UNIFORM_BUFFER, i * blocksize, sizeof(T), data + i);
             }
+            MemoryStats::get().allocate(MemoryStats::Category::UniformBuffer, count * blocksize);
         }
 
         ~UniformBuffer()
         {
-            glDeleteBuffers(1, &ubo);
+            GlTrace::deleteBuffers(1, &ubo);
+            MemoryStats::get().release(MemoryStats::Category::UniformBuffer, count * blocksize);
         }
     };
 
@@ -61,13 +68,13 @@ public:
     /** ユニフォームバッファオブジェクトにデータを格納する */
     void set(const T* data, unsigned int start = 0, unsigned int count = 1) const
     {
-        glBindBuffer(GL_UNIFORM_BUFFER, buffer->ubo);
+        GlTrace::bindBuffer(GL_UNIFORM_BUFFER, buffer->ubo);
         for (unsigned int i = 0; i < count; ++i)
         {
-            glBufferSubData(GL_UNIFORM_BUFFER,
-                            (start + i) * buffer->blocksize,
-                            sizeof(T),
-                            data + i);
+            GlTrace::bufferSubData(GL_UNIFORM_BUFFER,
+                                   (start + i) * buffer->blocksize,
+                                   sizeof(T),
+                                   data + i);
         }
     }
 
@@ -75,6 +82,7 @@ public:
     void select(GLuint bp, unsigned int i = 0) const
     {
         // 材質に設定するユニフォームバッファオブジェクトを指定する
-        glBindBufferRange(GL_UNIFORM_BUFFER, bp, buffer->ubo, i * buffer->blocksize, sizeof(T));
+        GlTrace::bindBufferRange(
+            GL_UNIFORM_BUFFER, bp, buffer->ubo, i * buffer->blocksize, sizeof(T));
     }
 };
@@ -0,0 +1,174 @@
+#pragma once
+#include <GL/glew.h>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "Object.h"
+
+/**
+ * 同じ頂点属性を持つ頂点を一つにまとめるクラス
+ *
+ * 頂点属性をハッシュ表に登録して重複を取り除き、インデックスを付け替える。
+ * 頂点の数に比例する時間で終わる。まとめた結果で縮退した三角形は取り除く。
+ * epsilon を指定すると、その幅で量子化した値が等しい頂点をまとめる
+ * (量子化の境界をまたぐ値はまとめられないことがある)。
+ * 量子化すると 64 ビットの整数に収まらない値や、無限大と NaN は、ビット列が等しいときだけまとめる。
+ */
+class VertexWelder
+{
+    /** 量子化した頂点属性 */
+    using Key = std::array<std::int64_t, 6>;
+
+    /** 量子化した頂点属性のハッシュ関数 */
+    struct Hash
+    {
+        std::size_t operator()(const Key& key) const
+        {
+            std::uint64_t h(14695981039346656037ull);
+            for (std::int64_t k : key)
+            {
+                h = (h ^ static_cast<std::uint64_t>(k)) * 1099511628211ull;
+            }
+            return static_cast<std::size_t>(h ^ (h >> 32));
+        }
+    };
+
+    /** まとめた頂点属性 */
+    std::vector<Object::Vertex> vertex;
+
+    /** 付け替えた三角形の頂点のインデックス */
+    std::vector<GLuint> index;
+
+    /** 元の頂点の数 */
+    GLsizei original;
+
+public:
+    /**
+     * @brief Construct a new VertexWelder object
+     *
+     * @param vertexcount 頂点の数
+     * @param vertex 頂点属性を格納した配列
+     * @param indexcount 三角形の頂点のインデックスの要素数
+     * @param index 三角形の頂点のインデックスを格納した配列 (NULL なら頂点の順に三角形を作る)
+     * @param epsilon 量子化の幅 (0 ならビット列が等しい頂点だけをまとめる)
+     */
+    VertexWelder(GLsizei vertexcount,
+                 const Object::Vertex* vertex,
+                 GLsizei indexcount  = 0,
+                 const GLuint* index = NULL,
+                 GLfloat epsilon     = 0.0f) :
+        original(vertexcount)
+    {
+        // 元の頂点からまとめた頂点への対応
+        std::vector<GLuint> remap(vertexcount);
+        std::unordered_map<Key, GLuint, Hash> table;
+        table.reserve(vertexcount);
+        this->vertex.reserve(vertexcount);
+        for (GLsizei i = 0; i < vertexcount; ++i)
+        {
+            const auto result(table.emplace(quantize(vertex[i], epsilon),
+                                            static_cast<GLuint>(this->vertex.size())));
+            if (result.second)
+                this->vertex.push_back(vertex[i]);
+            remap[i] = result.first->second;
+        }
+
+        // インデックスを付け替え、縮退した三角形を取り除く
+        if (index == NULL)
+            indexcount = vertexcount;
+        this->index.reserve(indexcount);
+        for (GLsizei i = 0; i + 2 < indexcount; i += 3)
+        {
+            const GLuint a(remap[index != NULL ? index[i] : i]);
+            const GLuint b(remap[index != NULL ? index[i + 1] : i + 1]);
+            const GLuint c(remap[index != NULL ? index[i + 2] : i + 2]);
+            if (a == b || b == c || c == a)
+                continue;
+
+            this->index.push_back(a);
+            this->index.push_back(b);
+            this->index.push_back(c);
+        }
+    }
+
+    /** まとめた頂点属性を返す */
+    const Object::Vertex* getVertex() const
+    {
+        return vertex.data();
+    }
+
+    /** まとめた頂点の数を返す */
+    GLsizei getVertexCount() const
+    {
+        return static_cast<GLsizei>(vertex.size());
+    }
+
+    /** 付け替えたインデックスを返す */
+    const GLuint* getIndex() const
+    {
+        return index.data();
+    }
+
+    /** 付け替えたインデックスの要素数を返す */
+    GLsizei getIndexCount() const
+    {
+        return static_cast<GLsizei>(index.size());
+    }
+
+    /** 元の頂点の数を返す */
+    GLsizei getOriginalVertexCount() const
+    {
+        return original;
+    }
+
+    /** 取り除いた頂点の数を返す */
+    GLsizei getRemoved() const
+    {
+        return original - getVertexCount();
+    }
+
+private:
+    /** 頂点属性を量子化する */
+    static Key quantize(const Object::Vertex& v, GLfloat epsilon)
+    {
+        const GLfloat value[] = {v.position[0],
+                                 v.position[1],
+                                 v.position[2],
+                                 v.normal[0],
+                                 v.normal[1],
+                                 v.normal[2]};
+
+        // 量子化した値の絶対値がこれ (2 の 62 乗) 以上になるときはビット列で比べる
+        constexpr double limit(4611686018427387904.0);
+
+        Key key;
+        for (int i = 0; i < 6; ++i)
+        {
+            if (epsilon > 0.0f)
+            {
+                // NaN は比較が偽になるのでビット列で比べる
+                const double q(static_cast<double>(value[i]) / epsilon);
+                if (std::fabs(q) < limit)
+                {
+                    key[i] = std::llround(q);
+                    continue;
+                }
+            }
+
+            // -0 と 0 は同じ値として扱う
+            const GLfloat x(value[i] == 0.0f ? 0.0f : value[i]);
+            std::uint32_t bits;
+            std::memcpy(&bits, &x, sizeof x);
+
+            // 量子化するときは量子化した値と重ならないように負の端に寄せる
+            key[i] = static_cast<std::int64_t>(bits);
+            if (epsilon > 0.0f)
+                key[i] += std::numeric_limits<std::int64_t>::min();
+        }
+        return key;
+    }
+};
@@ -1,33 +1,82 @@
 #pragma once
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <chrono>
 #include <iostream>
 #include <string>
+#include <thread>
+#include "FrameStats.h"
+#include "InputEvent.h"
+#include "RingBuffer.h"
 
 /**
  * ウィンドウ関連の処理を扱うクラス
  */
 class Window
 {
+public:
+    /**
+     * 画面の表示の方法
+     */
+    enum class PresentMode
+    {
+        /** 垂直同期を待つ */
+        Vsync,
+        /** 制限しない */
+        Uncapped,
+        /** 指定したフレームレートに制限する */
+        Capped
+    };
+
+private:
     /** ウィンドウ */
     GLFWwindow* window;
 
     /** ウィンドウのサイズ */
     GLfloat size[2];
 
+    /** フレームバッファのサイズ */
+    GLsizei fbSize[2];
+
     /** ワールド座標系に対するデバイス座標系の拡大率 */
     GLfloat scale;
 
     /** 図形の正規化デバイス座標系上での位置 */
     GLfloat location[2];
 
-    /** キーボードの状態 */
-    int keyStatus;
+    /** 入力イベントのキュー (GLFW のコールバックが書き込み、update() が読み出す) */
+    RingBuffer<InputEvent, 1024> events;
+
+    /** キーボードの状態 (update() が更新する) */
+    bool keyStatus[GLFW_KEY_LAST + 1];
+
+    /** マウスの左ボタンの状態 (update() が更新する) */
+    bool buttonStatus;
+
+    /** 画面の表示の方法 */
+    PresentMode presentMode;
+
+    /** フレームレートを制限するときの表示の間隔 */
+    double interval;
+
+    /** 前回表示した時刻 */
+    double lastPresent;
+
+    /** まだシミュレーションに渡していない最初の入力の時刻 (なければ負) */
+    double inputTime;
+
+    /** 表示の間隔の統計 */
+    FrameStats frameTime;
+
+    /** 入力から表示までの遅延の統計 */
+    FrameStats latency;
 
 public:
     Window(int width = 640, int height = 480, std::string title = "Hello") :
         window(glfwCreateWindow(width, height, title.c_str(), NULL, NULL)),
-        scale(100.0f), location {0.0f, 0.0f}, keyStatus(GLFW_RELEASE)
+        scale(100.0f), location {0.0f, 0.0f}, keyStatus {}, buttonStatus(false),
+        presentMode(PresentMode::Vsync), interval(0.0), lastPresent(-1.0), inputTime(-1.0),
+        frameTime("frame time"), latency("input latency")
     {
         if (window == NULL)
         {
@@ -47,11 +96,15 @@ public:
 
         glfwSwapInterval(1);
 
+        glfwSetWindowUserPointer(window, this);
+
         glfwSetKeyCallback(window, keyboard);
 
         glfwSetScrollCallback(window, wheel);
 
-        glfwSetWindowUserPointer(window, this);
+        glfwSetMouseButtonCallback(window, mouse);
+
+        glfwSetCursorPosCallback(window, cursor);
 
         glfwSetWindowSizeCallback(window, resize);
 
@@ -65,54 +118,131 @@ public:
 
     explicit operator bool()
     {
+        // 発生したイベントはコールバックでキューに積まれる
         glfwPollEvents();
 
-        if (glfwGetKey(window, GLFW_KEY_LEFT) != GLFW_RELEASE)
+        return !glfwWindowShouldClose(window) && !glfwGetKey(window, GLFW_KEY_ESCAPE);
+    }
+
+    /**
+     * @brief キューに積まれた入力イベントを全て処理し、矢印キーによる移動を行う
+     *
+     * シミュレーションの一回の更新ごとに呼び出す。
+     * イベントはロックせずに取り出すので、描画とは別のスレッドから呼び出してもよい。
+     */
+    void update()
+    {
+        InputEvent event;
+        while (events.pop(event))
+        {
+            switch (event.type)
+            {
+                case InputEvent::Type::Key:
+                    if (event.key >= 0 && event.key <= GLFW_KEY_LAST)
+                        keyStatus[event.key] = event.action != GLFW_RELEASE;
+                    break;
+                case InputEvent::Type::MouseButton:
+                    if (event.key == GLFW_MOUSE_BUTTON_1)
+                        buttonStatus = event.action != GLFW_RELEASE;
+                    break;
+                case InputEvent::Type::CursorPos:
+                    // マウスの左ボタンが押されていたら...
+                    if (buttonStatus)
+                    {
+                        location[0] = static_cast<GLfloat>(event.x);
+                        location[1] = static_cast<GLfloat>(event.y);
+                    }
+                    break;
+                case InputEvent::Type::Scroll:
+                    scale += static_cast<GLfloat>(event.y);
+                    break;
+            }
+        }
+
+        if (keyStatus[GLFW_KEY_LEFT])
         {
             location[0] -= 2.0f / size[0];
         }
-        else if (glfwGetKey(window, GLFW_KEY_RIGHT) != GLFW_RELEASE)
+        else if (keyStatus[GLFW_KEY_RIGHT])
         {
             location[0] += 2.0f / size[0];
         }
 
-        if (glfwGetKey(window, GLFW_KEY_DOWN) != GLFW_RELEASE)
+        if (keyStatus[GLFW_KEY_DOWN])
         {
             location[1] -= 2.0f / size[1];
         }
-        else if (glfwGetKey(window, GLFW_KEY_UP) != GLFW_RELEASE)
+        else if (keyStatus[GLFW_KEY_UP])
         {
             location[1] += 2.0f / size[1];
         }
+    }
 
-        // マウスの左ボタンが押されていたら...
-        if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_1) != GLFW_RELEASE)
-        {
-            double x, y;
-            glfwGetCursorPos(window, &x, &y);
+    /**
+     * @brief 画面の表示の方法を設定する
+     *
+     * @param mode 画面の表示の方法
+     * @param fps PresentMode::Capped のときのフレームレートの上限
+     */
+    void setPresentMode(PresentMode mode, double fps = 60.0)
+    {
+        presentMode = mode;
+        interval    = mode == PresentMode::Capped && fps > 0.0 ? 1.0 / fps : 0.0;
+        glfwSwapInterval(mode == PresentMode::Vsync ? 1 : 0);
+    }
 
-            location[0] = static_cast<GLfloat>(x) * 2.0f / size[0] - 1.0f;
-            location[1] = 1.0f - static_cast<GLfloat>(y) * 2.0f / size[1];
-        }
+    /** このウィンドウの OpenGL のコンテキストを呼び出したスレッドで使う */
+    void makeContextCurrent() const
+    {
+        glfwMakeContextCurrent(window);
+    }
 
-        return !glfwWindowShouldClose(window) && !glfwGetKey(window, GLFW_KEY_ESCAPE);
+    /**
+     * @brief このウィンドウとオブジェクトを共有するコンテキストを持つ見えないウィンドウを作る
+     *
+     * GLFW の制約によりメインスレッドから呼び出す。
+     * 作ったウィンドウは呼び出した側が glfwDestroyWindow() で破棄する。
+     *
+     * @return GLFWwindow* 作ったウィンドウ (作れなければ NULL)
+     */
+    GLFWwindow* createSharedContext() const
+    {
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        GLFWwindow* const shared(glfwCreateWindow(1, 1, "loader", NULL, window));
+        glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+        return shared;
     }
 
-    void swapBuffers() const
+    /**
+     * @brief カラーバッファを入れ替える (描画のスレッドから呼んでもよい)
+     *
+     * @param inputTime このフレームに反映した最初の入力の時刻 (なければ負)
+     */
+    void swapBuffers(double inputTime = -1.0)
     {
+        // フレームレートを制限する
+        if (interval > 0.0)
+            limit();
+
         glfwSwapBuffers(window);
+
+        // 表示の間隔と入力から表示までの遅延を記録する
+        const double now(glfwGetTime());
+        if (lastPresent >= 0.0 && now >= lastPresent)
+            frameTime.add(now - lastPresent);
+        lastPresent = now;
+
+        if (inputTime >= 0.0)
+            latency.add(now - inputTime);
     }
 
     static void resize(GLFWwindow* window, int width, int height)
     {
-        int fbWidth, fbHeight;
-        glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
-
-        glViewport(0, 0, fbWidth, fbHeight);
-
+        // ビューポートは描画のスレッドがフレームバッファのサイズに合わせて設定する
         Window* instance(static_cast<Window*>(glfwGetWindowUserPointer(window)));
         if (instance != NULL)
         {
+            glfwGetFramebufferSize(window, &instance->fbSize[0], &instance->fbSize[1]);
             instance->size[0] = static_cast<GLfloat>(width);
             instance->size[1] = static_cast<GLfloat>(height);
         }
@@ -123,16 +253,42 @@ public:
         Window* instance(static_cast<Window*>(glfwGetWindowUserPointer(window)));
         if (instance != NULL)
         {
-            instance->scale += static_cast<GLfloat>(y);
+            instance->push({InputEvent::Type::Scroll, 0, 0, glfwGetTime(), x, y});
         }
     }
 
     static void keyboard(GLFWwindow* window, int key, int scancode, int action, int mode)
+    {
+        Window* instance(static_cast<Window*>(glfwGetWindowUserPointer(window)));
+        if (instance != NULL && action != GLFW_REPEAT)
+        {
+            instance->push({InputEvent::Type::Key, key, action, glfwGetTime(), 0.0, 0.0});
+        }
+    }
+
+    static void mouse(GLFWwindow* window, int button, int action, int /*mods*/)
+    {
+        Window* instance(static_cast<Window*>(glfwGetWindowUserPointer(window)));
+        if (instance != NULL)
+        {
+            // ボタンを押した位置にすぐ移動できるようにカーソルの位置も積む
+            double x, y;
+            glfwGetCursorPos(window, &x, &y);
+            instance->push(
+                {InputEvent::Type::MouseButton, button, action, glfwGetTime(), 0.0, 0.0});
+            cursor(window, x, y);
+        }
+    }
+
+    static void cursor(GLFWwindow* window, double x, double y)
     {
         Window* instance(static_cast<Window*>(glfwGetWindowUserPointer(window)));
         if (instance != NULL)
         {
-            instance->keyStatus = action;
+            // 正規化デバイス座標系に変換して積む
+            const double nx(x * 2.0 / instance->size[0] - 1.0);
+            const double ny(1.0 - y * 2.0 / instance->size[1]);
+            instance->push({InputEvent::Type::CursorPos, 0, 0, glfwGetTime(), nx, ny});
         }
     }
 
@@ -141,6 +297,11 @@ public:
         return size;
     }
 
+    const GLsizei* getFramebufferSize() const
+    {
+        return fbSize;
+    }
+
     GLfloat getScale() const
     {
         return scale;
@@ -150,4 +311,55 @@ public:
     {
         return location;
     }
+
+    /** 表示の間隔の統計を返す */
+    const FrameStats& getFrameStats() const
+    {
+        return frameTime;
+    }
+
+    /** 入力から表示までの遅延の統計を返す */
+    const FrameStats& getLatencyStats() const
+    {
+        return latency;
+    }
+
+    /** まだシミュレーションに渡していない最初の入力の時刻を取り出す (なければ負) */
+    double takeInputTime()
+    {
+        const double t(inputTime);
+        inputTime = -1.0;
+        return t;
+    }
+
+    /** 入力イベントのキューを返す */
+    const RingBuffer<InputEvent, 1024>& getEvents() const
+    {
+        return events;
+    }
+
+private:
+    /** 入力イベントをキューに積み、表示までの遅延を測るために時刻を記録する */
+    void push(const InputEvent& event)
+    {
+        events.push(event);
+        if (inputTime < 0.0)
+            inputTime = event.time;
+    }
+
+    /** 前回の表示から interval が経つまで待つ */
+    void limit() const
+    {
+        // 直前まで眠って、残りは空回りして待つ
+        static constexpr double spin(0.002);
+        const double target(lastPresent + interval);
+        const double remaining(target - glfwGetTime());
+        if (remaining > spin)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double>(remaining - spin));
+        }
+        while (glfwGetTime() < target)
+        {
+        }
+    }
 };
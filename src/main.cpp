@@ -1,23 +1,68 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
-#include <fstream>
 #include <iostream>
 #include <memory>
-#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
+#include "AssetLoader.h"
+#include "Box.h"
+#include "Capture.h"
+#include "FixedTimestep.h"
+#include "FrameArena.h"
+#include "FrameStats.h"
+#include "GlTrace.h"
+#include "Image.h"
+#include "LodShape.h"
 #include "Material.h"
+#include "MaterialTable.h"
 #include "Matrix.h"
+#include "MatrixExpression.h"
+#include "MemoryStats.h"
+#include "OcclusionCuller.h"
+#include "ParticleSystem.h"
+#include "Shader.h"
 #include "Shape.h"
 #include "ShapeIndex.h"
+#include "Snapshot.h"
+#include "SoftwareRenderer.h"
 #include "SolidShape.h"
 #include "SolidShapeIndex.h"
-#include "Uniform.h"
+#include "Sphere.h"
+#include "StressScene.h"
+#include "Transform.h"
+#include "TripleBuffer.h"
 #include "Vector.h"
 #include "Window.h"
 
+/** 光源の数 */
+constexpr int Lcount = 2;
+
+/** ビュー変換行列 (コンパイル時に求める) */
+constexpr Matrix view(Matrix::lookAt(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+
+/** 光源の位置 */
+constexpr Vector Lpos[] = {0.0f, 0.0f, 5.0f, 1.0f, 8.0f, 0.0f, 0.0f, 1.0f};
+
+/** 視点座標系における光源の位置 (コンパイル時に求める) */
+constexpr Vector LposView[] = {view * Lpos[0], view * Lpos[1]};
+
+/** 光源の環境光成分 */
+constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
+
+/** 光源の拡散反射光成分 */
+constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+
+/** 光源の鏡面反射光成分 */
+constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+
+/** uniform ブロックに収まらない材質のバッファテクスチャを結合するテクスチャユニット */
+constexpr GLuint materialUnit(0);
+
 /** 面ごとに法線を変えた六面体の頂点属性 */
 constexpr Object::Vertex solidCubeVertex[] = {
     // 左
@@ -75,152 +120,640 @@ constexpr GLuint solidCubeIndex[] = {
 };
 
 /**
- * @brief print the error log of shader compile
- *
- * @param shader
- * @param str
- * @return GLboolean
+ * 描画に使うプログラムオブジェクトの uniform 変数の場所
  */
-GLboolean printShaderInfoLog(GLuint shader, const char* str)
+struct Locations
 {
-    GLint status;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if (status == GL_FALSE)
-        std::cerr << "Compile Error in " << str << std::endl;
-
-    GLsizei bufSize;
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &bufSize);
-    if (bufSize > 1)
+    GLint projection, modelView, normalMatrix, Lcount, Lpos, Lamb, Ldiff, Lspec, materialIndex;
+
+    /**
+     * @brief uniform 変数の場所を取得する
+     *
+     * @param program プログラムオブジェクト
+     */
+    explicit Locations(GLuint program) :
+        projection(GlTrace::getUniformLocation(program, "projection")),
+        modelView(GlTrace::getUniformLocation(program, "modelView")),
+        normalMatrix(GlTrace::getUniformLocation(program, "normalMatrix")),
+        Lcount(GlTrace::getUniformLocation(program, "Lcount")),
+        Lpos(GlTrace::getUniformLocation(program, "Lpos")),
+        Lamb(GlTrace::getUniformLocation(program, "Lamb")),
+        Ldiff(GlTrace::getUniformLocation(program, "Ldiff")),
+        Lspec(GlTrace::getUniformLocation(program, "Lspec")),
+        materialIndex(GlTrace::getUniformLocation(program, "materialIndex"))
     {
-        std::vector<GLchar> infoLog(bufSize);
-        GLsizei length;
-        glGetShaderInfoLog(shader, bufSize, &length, &infoLog[0]);
-        std::cerr << &infoLog[0] << std::endl;
     }
-    return static_cast<GLboolean>(status);
-}
+};
 
 /**
- * @brief print the error log of shader compile
+ * @brief 描画に使うプログラムオブジェクトを作成して材質の読み出し先を結びつける
  *
- * @param program
- * @return GLboolean
+ * @param materialTexture 材質を uniform ブロックではなくバッファテクスチャから読む
+ * @return GLuint プログラムオブジェクト名 (作成できなければ 0)
  */
-GLboolean printProgramInfoLog(GLuint program)
+GLuint loadPointProgram(bool materialTexture)
 {
-    GLint status;
-    glGetProgramiv(program, GL_LINK_STATUS, &status);
-    if (status == GL_FALSE)
-        std::cerr << "Link Error." << std::endl;
-
-    GLsizei bufSize;
-    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &bufSize);
-    if (bufSize > 1)
+    const GLuint program(loadProgram("resources/point.vert",
+                                     "resources/point.frag",
+                                     materialTexture ? MaterialTable::textureDefine : ""));
+    if (program == 0)
+        return 0;
+
+    if (materialTexture)
+    {
+        // バッファテクスチャを materialUnit 番のテクスチャユニットから読む
+        GlTrace::useProgram(program);
+        GlTrace::uniform1i(GlTrace::getUniformLocation(program, "materialTexture"),
+                           static_cast<GLint>(materialUnit));
+    }
+    else
     {
-        std::vector<GLchar> infoLog(bufSize);
-        GLsizei length;
-        glGetProgramInfoLog(program, bufSize, &length, &infoLog[0]);
-        std::cerr << &infoLog[0] << std::endl;
+        // uniform blockの場所を取得して0番の結合ポイントに結びつける
+        const GLuint materialLocation(GlTrace::getUniformBlockIndex(program, "Material"));
+        GlTrace::uniformBlockBinding(program, materialLocation, 0);
     }
-    return static_cast<GLboolean>(status);
+    return program;
+}
+
+/**
+ * @brief 光源の色を設定する (プログラムオブジェクトを使用しておくこと)
+ *
+ * @param location uniform 変数の場所
+ * @param count 光源の数
+ * @param ambient 光源の環境光成分
+ * @param diffuse 光源の拡散反射光成分
+ * @param specular 光源の鏡面反射光成分
+ */
+void setLights(const Locations& location,
+               int count,
+               const GLfloat* ambient,
+               const GLfloat* diffuse,
+               const GLfloat* specular)
+{
+    GlTrace::uniform1i(location.Lcount, count);
+    GlTrace::uniform3fv(location.Lamb, count, ambient);
+    GlTrace::uniform3fv(location.Ldiff, count, diffuse);
+    GlTrace::uniform3fv(location.Lspec, count, specular);
 }
 
 /**
- * @brief Create a Program object
+ * @brief フレームを OpenGL で描画する
  *
- * @param vsrc
- * @param fsrc
- * @return GLuint
+ * @param frame 描画するフレーム
+ * @param program 描画に使うプログラムオブジェクト
+ * @param location uniform 変数の場所
+ * @param material 材質を並べたユニフォームバッファオブジェクト
  */
-GLuint createProgram(const std::string& vsrc, const std::string& fsrc)
+void drawFrame(const Snapshot& frame,
+               GLuint program,
+               const Locations& location,
+               MaterialTable& material)
 {
-    const GLuint program(glCreateProgram());
+    GlTrace::viewport(0, 0, frame.viewport[0], frame.viewport[1]);
+    GlTrace::clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
-    auto charVsrc = vsrc.c_str();
-    glShaderSource(vobj, 1, &charVsrc, NULL);
-    glCompileShader(vobj);
+    GlTrace::useProgram(program);
 
-    if (printShaderInfoLog(vobj, "vertex shader"))
+    // uniform 変数に値を設定する
+    GlTrace::uniformMatrix4fv(location.projection, 1, GL_FALSE, frame.projection.data());
+    for (int i = 0; i < static_cast<int>(frame.lights.size()); i++)
     {
-        glAttachShader(program, vobj);
+        GlTrace::uniform4fv(location.Lpos + i, 1, frame.lights[i].data());
     }
-    glDeleteShader(vobj);
 
-    const GLuint fobj(glCreateShader(GL_FRAGMENT_SHADER));
-    auto charFsrc = fsrc.c_str();
-    glShaderSource(fobj, 1, &charFsrc, NULL);
-    glCompileShader(fobj);
+    // 材質の表はフレームごとに一度だけ結合して、描画ごとには番号だけを変える
+    // (uniform ブロックに収まらなければバッファテクスチャとして結合する)
+    if (material.needsTexture())
+        material.bindTexture(materialUnit);
+    else
+        material.bind(0);
 
-    if (printShaderInfoLog(fobj, "fragment shader"))
+    // 図形を描画する
+    for (const DrawPacket& draw : frame.draws)
     {
-        glAttachShader(program, fobj);
+        GlTrace::uniformMatrix4fv(location.modelView, 1, GL_FALSE, draw.modelView.data());
+        GlTrace::uniformMatrix3fv(location.normalMatrix, 1, GL_FALSE, draw.normalMatrix);
+        GlTrace::uniform1i(location.materialIndex, static_cast<GLint>(draw.material));
+        draw.shape->draw(draw.level);
     }
-    glDeleteShader(fobj);
-
-    glBindAttribLocation(program, 0, "position");
-    glBindAttribLocation(program, 1, "normal");
-    glBindFragDataLocation(program, 0, "fragment");
-    glLinkProgram(program);
-
-    if (printProgramInfoLog(program))
-        return program;
+}
 
-    glDeleteProgram(program);
-    return 0;
+/**
+ * @brief 読み込みを終えた図形を奥に一列に並べて回しながら描画する
+ *
+ * drawFrame() の後に呼び出して、同じプログラムオブジェクトと光源を使う。
+ *
+ * @param assets 読み込みを終えた図形
+ * @param location uniform 変数の場所
+ * @param materials 材質の数
+ * @param t 時刻
+ */
+void drawAssets(const std::vector<std::shared_ptr<const Shape>>& assets,
+                const Locations& location,
+                GLsizei materials,
+                GLfloat t)
+{
+    const GLfloat first((1.0f - static_cast<GLfloat>(assets.size())) * 1.1f);
+    for (std::size_t i = 0; i < assets.size(); ++i)
+    {
+        const Matrix modelView(view
+                               * Matrix::translate(first + static_cast<GLfloat>(i) * 2.2f,
+                                                   0.0f,
+                                                   -2.5f)
+                               * Matrix::rotate(t, 0.0f, 1.0f, 0.0f));
+        GLfloat normalMatrix[9];
+        modelView.getNormalMatrix(normalMatrix);
+        GlTrace::uniformMatrix4fv(location.modelView, 1, GL_FALSE, modelView.data());
+        GlTrace::uniformMatrix3fv(location.normalMatrix, 1, GL_FALSE, normalMatrix);
+        GlTrace::uniform1i(location.materialIndex, static_cast<GLint>(i % materials));
+        assets[i]->draw();
+    }
 }
 
 /**
- * @brief read shader file
+ * @brief 描画のスレッドでシミュレーションのスレッドが作成したフレームを描画する
  *
- * @param name
- * @param result
- * @return true
- * @return false
+ * @param window OpenGL のコンテキストを持つウィンドウ
+ * @param snapshots シミュレーションのスレッドから受け取るフレーム
+ * @param running false になったら終了する
+ * @param program 描画に使うプログラムオブジェクト
+ * @param material 材質を並べたユニフォームバッファオブジェクト
+ * @param capture 空でなければ描画したフレームをこれを先頭に付けたファイル名で書き出す
+ * @param format 書き出すファイルの形式
+ * @param software NULL でなければ CPU で描画してウィンドウに転送する
+ * @param particles NULL でなければ噴水のように粒子を放出して描画する (OpenGL で描き、記録していないときだけ)
+ * @param loader NULL でなければ読み込みを終えた図形を受け取って描画する (OpenGL で描くときだけ)
  */
-bool readShaderSource(const std::string name, std::string& result)
+void render(Window& window,
+            TripleBuffer<Snapshot>& snapshots,
+            const std::atomic<bool>& running,
+            GLuint program,
+            MaterialTable& material,
+            const std::string& capture,
+            Capture::Format format,
+            SoftwareRenderer* software,
+            ParticleSystem* particles,
+            AssetLoader* loader)
 {
-    std::ifstream file(name);
-    std::stringstream ss;
+    window.makeContextCurrent();
+
+    // uniform変数の場所を取得して光源の色を設定する
+    const Locations location(program);
+    GlTrace::useProgram(program);
+    setLights(location, Lcount, Lamb, Ldiff, Lspec);
+
+    // フレームの書き出しは最初のフレームのサイズで準備する
+    std::unique_ptr<Capture> capturer;
+
+    // CPU で描画した画像を転送するテクスチャとフレームバッファオブジェクト
+    GLuint texture(0), framebuffer(0);
+    if (software)
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D,
+                     0,
+                     GL_RGBA8,
+                     software->getWidth(),
+                     software->getHeight(),
+                     0,
+                     GL_RGBA,
+                     GL_UNSIGNED_BYTE,
+                     NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(
+            GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+
+    // 球の下から吹き上げて床で跳ね返る粒子
+    ParticleSystem::Emitter fountain = {
+        {0.0f, -1.0f, 0.0f}, {0.0f, 3.0f, 0.0f}, 1.0f, 0.0f, 1.5f, 0.0f};
+    if (particles)
+    {
+        fountain.rate = static_cast<GLfloat>(particles->getCapacity()) / fountain.life;
+        particles->setGround(-1.5f, 0.4f);
+    }
+    double previousTime(glfwGetTime());
+
+    // 読み込みのスレッドから受け取った図形 (このコンテキストで破棄する)
+    std::vector<std::shared_ptr<const Shape>> assets;
+
+    while (running.load(std::memory_order_relaxed))
+    {
+        // 新しいフレームができるまで眠って待つ (時間切れなら running を調べなおす)
+        if (!snapshots.waitAcquire(0.1))
+            continue;
+        const Snapshot& frame(snapshots.read());
+
+        // 転送を終えた図形を待たずに受け取る
+        AssetLoader::Asset asset;
+        while (loader && loader->poll(asset))
+        {
+            std::cout << "loaded " << asset.name << " in " << asset.seconds * 1000.0 << "ms"
+                      << (asset.shape ? "" : " (failed)") << std::endl;
+            if (asset.shape)
+                assets.push_back(asset.shape);
+        }
 
-    if (!file.is_open())
+        if (software)
+        {
+            // CPU で描いた画像をウィンドウの大きさに合わせて転送する
+            software->render(frame);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexSubImage2D(GL_TEXTURE_2D,
+                            0,
+                            0,
+                            0,
+                            software->getWidth(),
+                            software->getHeight(),
+                            GL_RGBA,
+                            GL_UNSIGNED_BYTE,
+                            software->getPixels());
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+            glBlitFramebuffer(0,
+                              0,
+                              software->getWidth(),
+                              software->getHeight(),
+                              0,
+                              0,
+                              frame.viewport[0],
+                              frame.viewport[1],
+                              GL_COLOR_BUFFER_BIT,
+                              GL_LINEAR);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        }
+        else
+        {
+            drawFrame(frame, program, location, material);
+            drawAssets(assets, location, material.size(), static_cast<GLfloat>(glfwGetTime()));
+
+            // 粒子は前のフレームからの経過時間だけ GPU で進める
+            // (GlTrace を通さずに OpenGL の状態を変えるので、命令を記録している間は止める)
+            if (particles && !GlTrace::get().isRecording())
+            {
+                const double now(glfwGetTime());
+                const GLfloat dt(static_cast<GLfloat>(std::min(now - previousTime, 0.1)));
+                previousTime = now;
+                particles->emit(fountain, dt);
+                particles->update(dt);
+                particles->draw(frame.projection, view, frame.viewport[1], 0.02f);
+            }
+        }
+
+        // 描画したフレームを書き出す
+        if (!capture.empty())
+        {
+            if (!capturer)
+                capturer = std::make_unique<Capture>(
+                    frame.viewport[0], frame.viewport[1], capture, format);
+            capturer->resize(frame.viewport[0], frame.viewport[1]);
+            capturer->capture();
+        }
+
+        GlTrace::get().endFrame();
+        window.swapBuffers(frame.inputTime);
+
+        // このフレームで使った一時的なデータをまとめて捨てる
+        FrameArena::local().reset();
+    }
+
+    if (capturer)
     {
-        std::cerr << "Failed to open file: " << name << std::endl;
-        file.close();
-        return false;
+        const unsigned long frames(capturer->getFrames()), dropped(capturer->getDropped());
+        capturer.reset();
+        std::cout << "captured " << frames << " frames, dropped " << dropped << std::endl;
     }
 
-    std::string line;
-    while (std::getline(file, line))
+    if (software)
     {
-        ss << line << std::endl;
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &texture);
     }
 
-    result = ss.str();
-    file.close();
-    return true;
+    // 受け取った図形の頂点配列オブジェクトはこのコンテキストにある
+    assets.clear();
+
+    glfwMakeContextCurrent(NULL);
 }
 
 /**
- * @brief load shader program from file
+ * @brief 多数の物体を並べた場面を決まったフレーム数だけ描画して処理時間を表示する
+ *
+ * 見えないウィンドウのまま、フレームバッファオブジェクトか CPU に描画する。
+ * 動く物体の更新、視錐台カリングと詳細度の選択、描画命令の発行、GPU の完了待ちの
+ * 段階ごとに CPU の処理時間を計る。
  *
- * @param vert
- * @param frag
- * @return GLuint
+ * @param settings 場面の設定
+ * @param frames 計測するフレーム数
+ * @param width フレームバッファの幅
+ * @param height フレームバッファの高さ
+ * @param program 描画に使うプログラムオブジェクト (材質が uniform ブロックに収まらなければ作りなおす)
+ * @param sphere 球の図形
+ * @param sphereMesh CPU で描画するときに使う球の頂点属性とインデックスと詳細度
+ * @param softwareMode CPU で描画する
+ * @param capture 空でなければ最後のフレームをこれに .png を付けたファイル名で書き出す
+ * @return int 終了コード
  */
-GLuint loadProgram(std::string vert, std::string frag)
+int stress(StressScene::Settings settings,
+           int frames,
+           GLsizei width,
+           GLsizei height,
+           GLuint program,
+           const LodShape& sphere,
+           const SoftwareRenderer::Mesh& sphereMesh,
+           bool softwareMode,
+           const std::string& capture)
 {
-    std::string vsrc;
-    const bool vstat(readShaderSource(vert, vsrc));
+    // バッファテクスチャにも収まらない材質はシェーダから見えない
+    if (!softwareMode && settings.materials > MaterialTable::uniformCapacity)
+    {
+        const unsigned int capacity(MaterialTable::getTextureCapacity());
+        if (settings.materials > capacity)
+        {
+            std::cerr << "stress: using " << capacity << " of " << settings.materials
+                      << " materials" << std::endl;
+            settings.materials = capacity;
+        }
+    }
+
+    // 六面体と球を並べた場面を作る
+    std::vector<Object::Vertex> boxVertex;
+    std::vector<GLuint> boxIndex;
+    createBox(boxVertex, boxIndex);
+    const SoftwareRenderer::Mesh boxMesh = {static_cast<GLsizei>(boxVertex.size()),
+                                            boxVertex.data(),
+                                            static_cast<GLsizei>(boxIndex.size()),
+                                            boxIndex.data(),
+                                            NULL};
+    const SolidShapeIndex box(3, boxMesh.vertexcount, boxMesh.vertex, boxMesh.indexcount,
+                              boxMesh.index);
+    const double setup(glfwGetTime());
+    StressScene scene(settings,
+                      {&box, NULL, boxMesh.indexcount, std::sqrt(3.0f)},
+                      {&sphere, sphereMesh.lod, sphereMesh.indexcount, 1.0f},
+                      width,
+                      height);
+    std::cout << "stress: " << scene.getObjects() << " objects (" << settings.boxes * 100.0f
+              << "% boxes, " << scene.getMoving() << " moving), " << settings.materials
+              << " materials, " << scene.getLights() << " lights, " << width << "x" << height
+              << ", " << (softwareMode ? "software" : "OpenGL") << ", setup "
+              << (glfwGetTime() - setup) * 1000.0 << "ms" << std::endl;
+
+    MaterialTable material;
+    for (const Material& m : scene.getMaterials())
+    {
+        material.add(m);
+    }
+
+    // uniform ブロックに収まらない材質はバッファテクスチャから読むシェーダで描く
+    GLuint textureProgram(0);
+    if (!softwareMode && material.needsTexture())
+    {
+        textureProgram = loadPointProgram(true);
+        if (textureProgram == 0)
+            return 1;
+        program = textureProgram;
+    }
+
+    // 画面には表示しないのでフレームバッファオブジェクトに描く
+    GLuint framebuffer(0), renderbuffers[2] = {0, 0};
+    std::unique_ptr<SoftwareRenderer> software;
+    if (softwareMode)
+    {
+        software = std::make_unique<SoftwareRenderer>(width, height);
+        software->setClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+        software->setMaterials(material.data(), material.size());
+        software->setLights(
+            scene.getLights(), scene.getAmbient(), scene.getDiffuse(), scene.getSpecular());
+        software->addShape(&box, boxMesh);
+        software->addShape(&sphere, sphereMesh);
+    }
+    else
+    {
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    }
+
+    const Locations location(program);
+    GlTrace::useProgram(program);
+    setLights(location, scene.getLights(), scene.getAmbient(), scene.getDiffuse(),
+              scene.getSpecular());
+
+    Snapshot frame;
+    frame.viewport[0] = width;
+    frame.viewport[1] = height;
+    frame.inputTime   = -1.0;
+
+    // 段階ごとの処理時間
+    FrameStats updateTime("update"), cullTime("cull+lod"), submitTime("submit"),
+        finishTime("gpu wait"), frameTime("frame");
+    unsigned long long draws(0), triangles(0);
+
+    // 最初の二フレームは転送やアリーナの確保などを含むので計測しない
+    // (一フレーム目ではみ出したアリーナのブロックは二フレーム目の reset() でまとめなおす)
+    double start(0.0);
+    unsigned long mallocs(0);
+    for (int i = -2; i < frames; ++i)
+    {
+        if (i == 0)
+        {
+            start   = glfwGetTime();
+            mallocs = FrameArena::getTotalMallocs();
+        }
+
+        const double t0(glfwGetTime());
+        scene.update(static_cast<GLfloat>(std::max(i, 0)) / 60.0f);
+        const double t1(glfwGetTime());
+        scene.collect(frame);
+        const double t2(glfwGetTime());
+        if (software)
+            software->render(frame);
+        else
+            drawFrame(frame, program, location, material);
+        const double t3(glfwGetTime());
+        if (!software)
+            glFinish();
+        const double t4(glfwGetTime());
+        GlTrace::get().endFrame();
+        FrameArena::local().reset();
+
+        if (i < 0)
+            continue;
+
+        updateTime.add(t1 - t0);
+        cullTime.add(t2 - t1);
+        submitTime.add(t3 - t2);
+        finishTime.add(t4 - t3);
+        frameTime.add(t4 - t0);
+        draws += frame.draws.size();
+        triangles += scene.getTriangles();
+    }
+    const double elapsed(glfwGetTime() - start);
+    mallocs = FrameArena::getTotalMallocs() - mallocs;
+
+    std::cout << "frames=" << frames << " time=" << elapsed << "s fps=" << frames / elapsed
+              << " draws/frame=" << draws / frames << " triangles/frame=" << triangles / frames
+              << std::endl;
+    updateTime.print();
+    cullTime.print();
+    submitTime.print();
+    if (!software)
+        finishTime.print();
+    frameTime.print();
+    std::cout << "frame arena: " << mallocs << " mallocs in " << frames << " frames, peak "
+              << FrameArena::local().getPeak() << "B" << std::endl;
 
-    std::string fsrc;
-    const bool fstat(readShaderSource(frag, fsrc));
+    // 最後のフレームを書き出す
+    if (!capture.empty())
+    {
+        if (software)
+        {
+            software->write(capture + ".png");
+        }
+        else
+        {
+            std::vector<unsigned char> pixels(static_cast<std::size_t>(width) * height * 4);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            Image::writePng(capture + ".png", width, height, pixels.data());
+        }
+    }
 
-    return vstat && fstat ? createProgram(vsrc, fsrc) : 0;
+    if (framebuffer != 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(2, renderbuffers);
+    }
+    deleteProgram(textureProgram);
+
+    return 0;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    // 表示の方法とシミュレーションの更新頻度を引数から設定する
+    Window::PresentMode present(Window::PresentMode::Vsync);
+    double fps(60.0), tick(60.0);
+    std::string capture;
+    Capture::Format format(Capture::Format::Png);
+    bool softwareMode(false);
+    GLsizei particleCount(0);
+    std::vector<std::string> loads;
+    std::string trace;
+    unsigned long traceFirst(0), traceCount(60);
+    double budget(0.0);
+    StressScene::Settings settings = {0, 0.5f, 16, Lcount, 0.1f, 1};
+    int frames(100);
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg(argv[i]);
+        if (arg == "--vsync")
+        {
+            present = Window::PresentMode::Vsync;
+        }
+        else if (arg == "--uncapped")
+        {
+            present = Window::PresentMode::Uncapped;
+        }
+        else if (arg == "--fps" && i + 1 < argc)
+        {
+            present = Window::PresentMode::Capped;
+            fps     = std::atof(argv[++i]);
+        }
+        else if (arg == "--tick" && i + 1 < argc)
+        {
+            tick = std::atof(argv[++i]);
+        }
+        else if (arg == "--capture" && i + 1 < argc)
+        {
+            capture = argv[++i];
+        }
+        else if (arg == "--raw")
+        {
+            format = Capture::Format::Raw;
+        }
+        else if (arg == "--software")
+        {
+            softwareMode = true;
+        }
+        else if (arg == "--memory-budget" && i + 1 < argc)
+        {
+            budget = std::atof(argv[++i]);
+        }
+        else if (arg == "--particles" && i + 1 < argc)
+        {
+            particleCount = std::max(std::atoi(argv[++i]), 0);
+        }
+        else if (arg == "--load" && i + 1 < argc)
+        {
+            loads.push_back(argv[++i]);
+        }
+        else if (arg == "--trace" && i + 1 < argc)
+        {
+            trace = argv[++i];
+        }
+        else if (arg == "--trace-frames" && i + 2 < argc)
+        {
+            traceFirst = std::strtoul(argv[++i], NULL, 10);
+            traceCount = std::strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "--stress" && i + 1 < argc)
+        {
+            settings.objects = std::strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "--boxes" && i + 1 < argc)
+        {
+            settings.boxes = static_cast<GLfloat>(std::atof(argv[++i]));
+        }
+        else if (arg == "--materials" && i + 1 < argc)
+        {
+            settings.materials = static_cast<unsigned int>(std::max(std::atoi(argv[++i]), 1));
+        }
+        else if (arg == "--lights" && i + 1 < argc)
+        {
+            settings.lights = std::atoi(argv[++i]);
+        }
+        else if (arg == "--motion" && i + 1 < argc)
+        {
+            settings.motion = static_cast<GLfloat>(std::atof(argv[++i]));
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            frames = std::max(std::atoi(argv[++i]), 1);
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--vsync | --uncapped | --fps <rate>] [--tick <rate>]"
+                         " [--capture <prefix> [--raw]] [--software]"
+                         " [--memory-budget <MiB>] [--particles <count>]\n"
+                         "       [--load <file.obj>]... [--trace <file> [--trace-frames <first>"
+                         " <count>]]\n"
+                         "       [--stress <objects> [--boxes <fraction>] [--materials <count>]"
+                         " [--lights <count>] [--motion <fraction>] [--frames <count>]]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // OpenGL の命令を記録するときは資源を作る前に始める
+    if (!trace.empty() && !GlTrace::get().open(trace, traceFirst, traceCount))
+        return 1;
+
     // initialize GLFW
     if (glfwInit() == GL_FALSE)
     {
@@ -235,95 +768,83 @@ int main()
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
+    // 負荷試験ではウィンドウを表示しない
+    if (settings.objects > 0)
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
     // initialize window
     Window window;
+    window.setPresentMode(present, fps);
 
-    glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    GlTrace::clearColor(1.0f, 1.0f, 1.0f, 0.0f);
 
     // 背面カリングを有効にする
-    glFrontFace(GL_CCW);
-    glCullFace(GL_BACK);
-    glEnable(GL_CULL_FACE);
+    GlTrace::frontFace(GL_CCW);
+    GlTrace::cullFace(GL_BACK);
+    GlTrace::enable(GL_CULL_FACE);
 
     // デプスバッファを有効にする
-    glClearDepth(1.0);
-    glDepthFunc(GL_LESS);
-    glEnable(GL_DEPTH_TEST);
-
-    // uniform変数の場所を取得する
-    const GLuint program(loadProgram("resources/point.vert", "resources/point.frag"));
-    const GLint projectionLocation(glGetUniformLocation(program, "projection"));
-    const GLint modelViewLocation(glGetUniformLocation(program, "modelView"));
-    const GLint normalMatrixLocation(glGetUniformLocation(program, "normalMatrix"));
-    const GLint LposLocation(glGetUniformLocation(program, "Lpos"));
-    const GLint LambLocation(glGetUniformLocation(program, "Lamb"));
-    const GLint LdiffLocation(glGetUniformLocation(program, "Ldiff"));
-    const GLint LspecLocation(glGetUniformLocation(program, "Lspec"));
-
-    // uniform blockの場所を取得する
-    const GLint materialLocation(glGetUniformBlockIndex(program, "Material"));
-
-    // uniform blockの場所を0番の結合ポイントに結びつける
-    glUniformBlockBinding(program, materialLocation, 0);
-
-    // 球の分割数
-    const int slices = 16, stacks = 8;
-
-    // 頂点属性を作る
-    std::vector<Object::Vertex> solidSphereVertex;
-    for (int j = 0; j <= stacks; j++)
-    {
-        const float t = static_cast<float>(j) / static_cast<float>(stacks);
-        const float y = std::cos(3.141593f * t), r = std::sin(3.141593f * t);
-        for (int i = 0; i <= slices; i++)
-        {
-            const float s = static_cast<float>(i) / static_cast<float>(slices);
-            const float z = r * std::cos(6.283185f * s), x = r * std::sin(6.283185f * s);
+    GlTrace::clearDepth(1.0);
+    GlTrace::depthFunc(GL_LESS);
+    GlTrace::enable(GL_DEPTH_TEST);
 
-            // 頂点属性
-            const Object::Vertex v = {x, y, z, x, y, x};
-            // 頂点属性を追加する
-            solidSphereVertex.push_back(v);
-        }
-    }
+    // GPU のメモリの予算を設定する
+    MemoryStats& memory(MemoryStats::get());
+    memory.setBudget(static_cast<std::size_t>(budget * 1024.0 * 1024.0));
+
+    // プログラムオブジェクトを作成する
+    const GLuint program(loadPointProgram(false));
 
-    // インデックスを作る
+    // 詳細度を変えた球の頂点属性とインデックスを作る (予算に収まらなければ粗くする)
+    std::vector<Object::Vertex> solidSphereVertex;
     std::vector<GLuint> solidSphereIndex;
-    for (int j = 0; j < stacks; j++)
+    LevelOfDetail solidSphereLod;
+    for (int slices = 64;; slices /= 2)
     {
-        const int k = (slices + 1) * j;
-        for (int i = 0; i < slices; ++i)
-        {
-            // 頂点のインデックス
-            const GLuint k0(k + i);
-            const GLuint k1(k0 + 1);
-            const GLuint k2(k1 + slices);
-            const GLuint k3(k2 + 1);
-            // 左下の三角形
-            solidSphereIndex.push_back(k0);
-            solidSphereIndex.push_back(k2);
-            solidSphereIndex.push_back(k3);
-            // 右上の三角形
-            solidSphereIndex.push_back(k0);
-            solidSphereIndex.push_back(k3);
-            solidSphereIndex.push_back(k1);
-        }
+        solidSphereLod = LevelOfDetail();
+        createSphereLod(
+            slices, slices / 2, 4, solidSphereVertex, solidSphereIndex, solidSphereLod);
+        const std::size_t bytes(solidSphereVertex.size() * sizeof(Object::Vertex)
+                                + solidSphereIndex.size() * sizeof(GLuint));
+        if (memory.fits(bytes) || slices <= 8)
+            break;
+
+        std::cerr << "sphere " << slices << "x" << slices / 2 << " (" << bytes
+                  << " bytes) exceeds the memory budget, using a coarser mesh" << std::endl;
     }
+    const std::size_t meshBytes(solidSphereVertex.capacity() * sizeof(Object::Vertex)
+                                + solidSphereIndex.capacity() * sizeof(GLuint));
+    memory.allocate(MemoryStats::Category::Mesh, meshBytes);
 
     // 図形を作成する
-    std::unique_ptr<const Shape> shape =
-        std::make_unique<const SolidShapeIndex>(3,
-                                                static_cast<GLsizei>(solidSphereVertex.size()),
-                                                solidSphereVertex.data(),
-                                                static_cast<GLsizei>(solidSphereIndex.size()),
-                                                solidSphereIndex.data());
-
-    // 光源データ
-    static constexpr int Lcount      = 2;
-    static constexpr Vector Lpos[]   = {0.0f, 0.0f, 5.0f, 1.0f, 8.0f, 0.0f, 0.0f, 1.0f};
-    static constexpr GLfloat Lamb[]  = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
-    static constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
-    static constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+    std::unique_ptr<const LodShape> shape =
+        std::make_unique<const LodShape>(3,
+                                         static_cast<GLsizei>(solidSphereVertex.size()),
+                                         solidSphereVertex.data(),
+                                         static_cast<GLsizei>(solidSphereIndex.size()),
+                                         solidSphereIndex.data(),
+                                         solidSphereLod);
+
+    // 負荷試験なら多数の物体を描画して終了する
+    if (settings.objects > 0)
+    {
+        const int result(stress(settings,
+                                frames,
+                                window.getFramebufferSize()[0],
+                                window.getFramebufferSize()[1],
+                                program,
+                                *shape,
+                                {static_cast<GLsizei>(solidSphereVertex.size()),
+                                 solidSphereVertex.data(),
+                                 static_cast<GLsizei>(solidSphereIndex.size()),
+                                 solidSphereIndex.data(),
+                                 &solidSphereLod},
+                                softwareMode,
+                                capture));
+        memory.print();
+        memory.release(MemoryStats::Category::Mesh, meshBytes);
+        return result;
+    }
 
     // 色データ
     static constexpr Material color[] = {
@@ -331,72 +852,188 @@ int main()
         {0.6f, 0.6f, 0.2f, 0.6f, 0.6f, 0.2f, 0.3f, 0.3f, 0.3f, 30.0f},
         {0.1f, 0.1f, 0.5f, 0.1f, 0.1f, 0.5f, 0.4f, 0.4f, 0.4f, 60.0f}};
 
-    const Uniform<Material> material(color, 2);
+    // 同じ材質は一つにまとめて番号で引く
+    MaterialTable material;
+    const unsigned int materialIndex[] = {material.add(color[0]), material.add(color[1])};
+
+    // CPU で描画するときは同じ材質と光源と図形を設定する
+    std::unique_ptr<SoftwareRenderer> software;
+    if (softwareMode)
+    {
+        software = std::make_unique<SoftwareRenderer>(window.getFramebufferSize()[0],
+                                                      window.getFramebufferSize()[1]);
+        software->setClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+        software->setMaterials(material.data(), material.size());
+        software->setLights(Lcount, Lamb, Ldiff, Lspec);
+        software->addShape(shape.get(),
+                           {static_cast<GLsizei>(solidSphereVertex.size()),
+                            solidSphereVertex.data(),
+                            static_cast<GLsizei>(solidSphereIndex.size()),
+                            solidSphereIndex.data(),
+                            &solidSphereLod});
+    }
+
+    // 粒子の状態は GPU のバッファオブジェクトに置く
+    std::unique_ptr<ParticleSystem> particles;
+    if (particleCount > 0 && !softwareMode)
+    {
+        particles = std::make_unique<ParticleSystem>(particleCount);
+        if (!*particles)
+        {
+            std::cerr << "Can't create the particle programs" << std::endl;
+            particles.reset();
+        }
+    }
+
+    // OBJ 形式のファイルは共有したコンテキストを持つスレッドで読み込む
+    std::unique_ptr<AssetLoader> loader;
+    if (!loads.empty() && !softwareMode)
+    {
+        loader = std::make_unique<AssetLoader>(window.createSharedContext());
+        if (!*loader)
+            std::cerr << "Can't create a shared context for loading" << std::endl;
+        for (const std::string& name : loads)
+        {
+            loader->loadObj(name);
+        }
+    }
+
+    // シミュレーションは固定の時間刻みで進めて、描画のときに補間する
+    FixedTimestep timestep(tick > 0.0 ? 1.0 / tick : 1.0 / 60.0);
+    GLfloat angle(0.0f), previousAngle(0.0f);
+    GLfloat position[2] = {0.0f, 0.0f}, previousPosition[2] = {0.0f, 0.0f};
+
+    // OpenGL のコンテキストは描画のスレッドに渡す
+    glfwMakeContextCurrent(NULL);
+
+    // 描画のスレッドに渡すフレーム
+    TripleBuffer<Snapshot> snapshots;
+    std::atomic<bool> running(true);
 
     glfwSetTime(0.0);
+    timestep.reset(0.0);
+
+    std::thread renderer(render,
+                         std::ref(window),
+                         std::ref(snapshots),
+                         std::cref(running),
+                         program,
+                         std::ref(material),
+                         std::cref(capture),
+                         format,
+                         software.get(),
+                         particles.get(),
+                         loader.get());
+
+    // 物体ごとに前のフレームで選んだ詳細度
+    GLsizei levels[2] = {0, 0};
 
+    // 最も粗い詳細度の球を遮蔽物にして、隠れた物体の描画を省く
+    OcclusionCuller culler(256, 192, 1);
+    const LevelOfDetail::Level& occluder(solidSphereLod.getLevel(solidSphereLod.getLevels() - 1));
+
+    // このスレッドはイベントの処理とシミュレーションを行う
     while (window)
     {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // シミュレーションを進める
+        for (int steps = timestep.advance(glfwGetTime()); steps > 0; --steps)
+        {
+            previousAngle       = angle;
+            previousPosition[0] = position[0];
+            previousPosition[1] = position[1];
+
+            window.update();
+            angle += static_cast<GLfloat>(timestep.getStep());
+            position[0] = window.getLocation()[0];
+            position[1] = window.getLocation()[1];
+        }
+
+        // 直前の二つの状態を補間する
+        const GLfloat alpha(static_cast<GLfloat>(timestep.getAlpha()));
+        const GLfloat a(previousAngle + (angle - previousAngle) * alpha);
+        const GLfloat x(previousPosition[0] + (position[0] - previousPosition[0]) * alpha);
+        const GLfloat y(previousPosition[1] + (position[1] - previousPosition[1]) * alpha);
 
-        glUseProgram(program);
+        // 空いている領域にフレームを作成する
+        Snapshot& frame(snapshots.write());
+        frame.viewport[0] = window.getFramebufferSize()[0];
+        frame.viewport[1] = window.getFramebufferSize()[1];
+        frame.inputTime   = window.takeInputTime();
 
         // 透視投影変換行列を求める
         const GLfloat* size(window.getSize());
         const GLfloat fovy(window.getScale() * 0.01f);
         const GLfloat aspect(size[0] / size[1]);
-        const Matrix projection(Matrix::perspective(fovy, aspect, 1.0f, 10.0f));
+        frame.projection = Matrix::perspective(fovy, aspect, 1.0f, 10.0f);
 
-        // モデルの変換行列を求める
-        const GLfloat* location(window.getLocation());
-        const Matrix r(Matrix::rotate(static_cast<GLfloat>(glfwGetTime()), 0.0f, 1.0f, 0.0f));
-        const Matrix model(Matrix::translate(location[0], location[1], 0.0f) * r);
+        // モデルの変換を求める
+        const Transform r(Transform::rotate(a, 0.0f, 1.0f, 0.0f));
+        const Transform model(Transform::translate(x, y, 0.0f) * r);
 
-        // ビュー変換行列を求める
-        const Matrix view(Matrix::lookAt(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        // 視点座標系における光源の位置
+        frame.lights.assign(LposView, LposView + Lcount);
 
-        // 法線ベクトルの変換行列の格納先
-        GLfloat normalMatrix[9];
+        frame.draws.resize(2);
 
-        // モデルビュー変換行列を求める
-        const Matrix modelView(view * model);
+        // モデルビュー変換行列と法線ベクトルの変換行列を求める
+        DrawPacket& draw0(frame.draws[0]);
+        draw0.shape     = shape.get();
+        draw0.material  = materialIndex[0];
+        draw0.modelView = LazyMatrix::affine(view) * LazyMatrix::transform(model);
+        draw0.modelView.getNormalMatrix(draw0.normalMatrix);
+        draw0.level = levels[0] = shape->getLod().select(
+            draw0.modelView, frame.projection, frame.viewport[1], levels[0]);
 
-        // 法線ベクトルの変換行列を求める
-        modelView.getNormalMatrix(normalMatrix);
-
-        // uniform 変数に値を設定する
-        glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, projection.data());
-        glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE, modelView.data());
-        glUniformMatrix3fv(normalMatrixLocation, 1, GL_FALSE, normalMatrix);
-
-        // 図形を描画
-        material.select(0, 0);
-        shape->draw();
+        // 二つ目のモデルビュー変換行列と法線ベクトルの変換行列を求める
+        DrawPacket& draw1(frame.draws[1]);
+        draw1.shape     = shape.get();
+        draw1.material  = materialIndex[1];
+        draw1.modelView =
+            LazyMatrix::affine(draw0.modelView) * LazyMatrix::translate(0.0f, 0.0f, 3.0f);
+        draw1.modelView.getNormalMatrix(draw1.normalMatrix);
+        draw1.level = levels[1] = shape->getLod().select(
+            draw1.modelView, frame.projection, frame.viewport[1], levels[1]);
 
-        // 二つ目のモデルビュー変換行列を求める
-        const Matrix modelview1(modelView * Matrix::translate(0.0f, 0.0f, 3.0f));
-
-        // 二つ目の法線ベクトルの変換行列を求める
-        modelview1.getNormalMatrix(normalMatrix);
-
-        // uniform 変数に値を設定する
-        glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, projection.data());
-        glUniformMatrix4fv(modelViewLocation, 1, GL_FALSE, modelview1.data());
-        glUniformMatrix3fv(normalMatrixLocation, 1, GL_FALSE, normalMatrix);
-        for (int i = 0; i < Lcount; i++)
+        // 全ての物体を遮蔽物として描いてから、隠れた物体を取り除く
+        culler.clear();
+        for (const DrawPacket& draw : frame.draws)
         {
-            glUniform4fv(LposLocation + i, 1, (view * Lpos[i]).data());
+            culler.addOccluder(frame.projection * draw.modelView,
+                               static_cast<GLsizei>(solidSphereVertex.size()),
+                               solidSphereVertex.data(),
+                               occluder.count,
+                               solidSphereIndex.data() + occluder.first);
+        }
+        culler.rasterize();
+        static constexpr GLfloat boundsMin[] = {-1.0f, -1.0f, -1.0f};
+        static constexpr GLfloat boundsMax[] = {1.0f, 1.0f, 1.0f};
+        for (std::size_t i = frame.draws.size(); i-- > 0;)
+        {
+            if (!culler.isVisible(
+                    frame.projection * frame.draws[i].modelView, boundsMin, boundsMax))
+                frame.draws.erase(frame.draws.begin() + i);
         }
-        glUniform3fv(LambLocation, Lcount, Lamb);
-        glUniform3fv(LdiffLocation, Lcount, Ldiff);
-        glUniform3fv(LspecLocation, Lcount, Lspec);
-
-        // 二つ目の図形を描画する
-        material.select(0, 1);
-        shape->draw();
 
-        window.swapBuffers();
+        // 描画のスレッドが前のフレームを受け取るまで待ってから渡す
+        // (眠っている間もウィンドウを閉じる操作を見逃さないように時間を区切ってイベントを調べる)
+        while (snapshots.pending() && window)
+            snapshots.waitConsumed(0.05);
+        snapshots.publish();
     }
 
+    running.store(false, std::memory_order_relaxed);
+    snapshots.close();
+    renderer.join();
+
+    // 後始末のために OpenGL のコンテキストを取り戻す
+    window.makeContextCurrent();
+
+    window.getFrameStats().print();
+    window.getLatencyStats().print();
+    std::cout << "occlusion culled " << culler.getCulled() << " of " << culler.getTested()
+              << " draws" << std::endl;
+    memory.print();
+    memory.release(MemoryStats::Category::Mesh, meshBytes);
+
     return 0;
 }